@@ -28,21 +28,49 @@
  */
 
 #include "Base.h"
-#include "GD.h"
+#include "Host.h"
+#include "SharedObjects.h"
+#include "RPCMethods.h"
 
 namespace HgAddonLib
 {
 Base::Base(int32_t homegearPort, uint64_t myPeerId, int32_t debugLevel)
 {
 	_myPeerId = myPeerId;
-	GD::debugLevel = debugLevel;
-	GD::rpcClient.setPort(homegearPort);
-	GD::rpcServer.start(this, myPeerId);
+	_bl.reset(new SharedObjects());
+	_bl->debugLevel = debugLevel;
+	_bl->rpcClient.setPort(homegearPort);
+	_bl->rpcServer.addBase(this);
+	if(myPeerId == 0)
+	{
+		_bl->out.printCritical("Critical: Could not start. myPeerId is \"0\".");
+		return;
+	}
+	std::vector<uint64_t> peerIds{ myPeerId };
+	_bl->rpcServer.addPeers(this, peerIds);
+	_bl->rpcServer.start();
+}
+
+Base::Base(std::shared_ptr<AddonHost> host, uint64_t myPeerId)
+{
+	_myPeerId = myPeerId;
+	if(!host)
+	{
+		_bl.reset(new SharedObjects());
+		_bl->out.printCritical("Critical: Could not start. host is \"nullptr\".");
+		return;
+	}
+	_bl = host->_bl;
+	_bl->rpcServer.addBase(this);
+	if(myPeerId == 0) return;
+	std::vector<uint64_t> peerIds{ myPeerId };
+	_bl->rpcServer.addPeers(this, peerIds);
 }
 
 Base::~Base()
 {
-	GD::rpcServer.stop();
+	//The connection to Homegear is closed when the last owner of the context is gone.
+	_bl->rpcServer.removeBase(this);
 }
 
 void Base::addPeer(uint64_t peerId)
@@ -50,19 +78,19 @@ void Base::addPeer(uint64_t peerId)
 	try
 	{
 		std::vector<uint64_t> peerIds{ peerId };
-		GD::rpcServer.addPeers(peerIds);
+		_bl->rpcServer.addPeers(this, peerIds);
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
 }
 
@@ -70,19 +98,19 @@ void Base::addPeers(std::vector<uint64_t> peerIds)
 {
 	try
 	{
-		GD::rpcServer.addPeers(peerIds);
+		_bl->rpcServer.addPeers(this, peerIds);
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
 }
 
@@ -91,19 +119,19 @@ void Base::removePeer(uint64_t peerId)
 	try
 	{
 		std::vector<uint64_t> peerIds{ peerId };
-		GD::rpcServer.removePeers(peerIds);
+		_bl->rpcServer.removePeers(this, peerIds);
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
 }
 
@@ -111,24 +139,367 @@ void Base::removePeers(std::vector<uint64_t> peerIds)
 {
 	try
 	{
-		GD::rpcServer.removePeers(peerIds);
+		_bl->rpcServer.removePeers(this, peerIds);
+	}
+	catch(const std::exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+}
+
+bool Base::registerMethod(std::string methodName, std::function<PVariable(PRPCArray parameters)> method)
+{
+	try
+	{
+		if(!method) return false;
+		return _bl->rpcServer.registerMethod(methodName, std::shared_ptr<RPCMethod>(new RPCUserFunction(_bl.get(), method)));
+	}
+	catch(const std::exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+    return false;
+}
+
+bool Base::registerMethod(std::string methodName, std::shared_ptr<RPCMethod> method)
+{
+	try
+	{
+		return _bl->rpcServer.registerMethod(methodName, method);
+	}
+	catch(const std::exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+    return false;
+}
+
+bool Base::unregisterMethod(std::string methodName)
+{
+	try
+	{
+		return _bl->rpcServer.unregisterMethod(methodName);
+	}
+	catch(const std::exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+    return false;
+}
+
+void Base::setMulticallMode(MulticallMode mode, uint32_t threadCount)
+{
+	try
+	{
+		_bl->rpcServer.setMulticallMode(mode, threadCount);
+	}
+	catch(const std::exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+}
+
+void Base::setMulticallMode(MulticallMode mode, std::shared_ptr<ThreadPool> threadPool)
+{
+	try
+	{
+		_bl->rpcServer.setMulticallMode(mode, threadPool);
+	}
+	catch(const std::exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+}
+
+void Base::setRpcProtocol(RPCProtocol protocol)
+{
+	try
+	{
+		_bl->rpcClient.setProtocol(protocol);
+	}
+	catch(const std::exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+}
+
+uint64_t Base::addTimer(uint32_t delay, std::function<void()> callback, uint32_t interval)
+{
+	try
+	{
+		return _bl->timers.add(delay, callback, interval);
+	}
+	catch(const std::exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+    return 0;
+}
+
+bool Base::removeTimer(uint64_t timerId)
+{
+	try
+	{
+		return _bl->timers.remove(timerId);
+	}
+	catch(const std::exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+    return false;
+}
+
+void Base::setLogSinks(std::vector<std::shared_ptr<LogSink>> sinks)
+{
+	try
+	{
+		_bl->logWriter.setSinks(sinks);
+	}
+	catch(const std::exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+}
+
+void Base::setLogDropPolicy(LogDropPolicy policy)
+{
+	_bl->logWriter.setDropPolicy(policy);
+}
+
+void Base::setLogTimeMode(LogTimeMode mode)
+{
+	_bl->logTimeMode.store(mode);
+}
+
+bool Base::startFlightRecorder(uint32_t capacity, std::string filename)
+{
+	try
+	{
+		return _bl->flightRecorder.start(capacity, filename);
+	}
+	catch(const std::exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+    return false;
+}
+
+void Base::stopFlightRecorder()
+{
+	try
+	{
+		_bl->flightRecorder.stop();
+	}
+	catch(const std::exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+}
+
+bool Base::dumpFlightRecorder(std::string filename)
+{
+	try
+	{
+		return _bl->flightRecorder.dump(filename);
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
+    return false;
+}
+
+void Base::setFlightRecorderErrorDump(std::string filename)
+{
+	try
+	{
+		_bl->flightRecorder.setErrorDumpFile(filename);
+	}
+	catch(const std::exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+}
+
+PVariable Base::getMetrics()
+{
+	return _bl->metrics.getSnapshot();
+}
+
+Metrics& Base::getMetricsRegistry()
+{
+	return _bl->metrics;
+}
+
+void Base::startTracing(uint32_t eventsPerThread)
+{
+	_bl->tracer.start(eventsPerThread);
+}
+
+void Base::stopTracing()
+{
+	_bl->tracer.stop();
+}
+
+bool Base::exportTrace(std::string filename)
+{
+	return _bl->tracer.exportChromeTrace(filename);
+}
+
+Tracer& Base::getTracer()
+{
+	return _bl->tracer;
+}
+
+void Base::setSlowCallbackThreshold(uint32_t threshold, bool watchdog)
+{
+	_bl->callbackMonitor.setThreshold(threshold, watchdog);
+}
+
+bool Base::isConnected()
+{
+	return _bl->rpcServer.isConnected();
+}
+
+bool Base::waitForConnection(uint32_t timeout)
+{
+	return _bl->rpcServer.waitForConnection(timeout);
 }
 
 PVariable Base::invoke(std::string methodName, PRPCList parameters)
 {
-	return GD::rpcClient.invoke(methodName, parameters);
+	try
+	{
+		if(!_bl->rpcServer.isConnected() && (_connectionTimeout == 0 || !_bl->rpcServer.waitForConnection(_connectionTimeout)))
+		{
+			return Variable::createError(-32300, "Not connected to Homegear.");
+		}
+		return _bl->rpcClient.invoke(methodName, parameters);
+	}
+	catch(const std::exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+    return Variable::createError(-32500, "Unknown application error.");
 }
 }
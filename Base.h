@@ -32,11 +32,20 @@
 
 #include <memory>
 #include <list>
+#include <functional>
 
 #include "Variable.h"
+#include "LogWriter.h"
+#include "Output.h"
+#include "Metrics.h"
+#include "Tracer.h"
 
 namespace HgAddonLib
 {
+class RPCMethod;
+class SharedObjects;
+class ThreadPool;
+class AddonHost;
 
 #define GETRPCCLIENTPARAMETERS(_1,_2,_3,_4,_5,_6,_7,NAME,...) NAME
 #define RPCCLIENTPARAMETERS(...) GETRPCCLIENTPARAMETERS(__VA_ARGS__, RPCCLIENTPARAMETERS7, RPCCLIENTPARAMETERS6, RPCCLIENTPARAMETERS5, RPCCLIENTPARAMETERS4, RPCCLIENTPARAMETERS3, RPCCLIENTPARAMETERS2, RPCCLIENTPARAMETERS1)(__VA_ARGS__)
@@ -48,6 +57,43 @@ namespace HgAddonLib
 #define RPCCLIENTPARAMETERS6(p1, p2, p3, p4, p5, p6) HgAddonLib::PRPCList(new HgAddonLib::RPCList { HgAddonLib::PVariable(new HgAddonLib::Variable(p1)), HgAddonLib::PVariable(new HgAddonLib::Variable(p2)), HgAddonLib::PVariable(new HgAddonLib::Variable(p3)), HgAddonLib::PVariable(new HgAddonLib::Variable(p4)), HgAddonLib::PVariable(new HgAddonLib::Variable(p5)), HgAddonLib::PVariable(new HgAddonLib::Variable(p6)) })
 #define RPCCLIENTPARAMETERS7(p1, p2, p3, p4, p5, p6, p7) HgAddonLib::PRPCList(new HgAddonLib::RPCList { HgAddonLib::PVariable(new HgAddonLib::Variable(p1)), HgAddonLib::PVariable(new HgAddonLib::Variable(p2)), HgAddonLib::PVariable(new HgAddonLib::Variable(p3)), HgAddonLib::PVariable(new HgAddonLib::Variable(p4)), HgAddonLib::PVariable(new HgAddonLib::Variable(p5)), HgAddonLib::PVariable(new HgAddonLib::Variable(p6)), HgAddonLib::PVariable(new HgAddonLib::Variable(p7)) })
 
+/**
+ * Execution modes for "system.multicall" requests received from Homegear.
+ */
+enum class MulticallMode
+{
+	/**
+	 * All entries are executed one after another on the RPC server thread (default).
+	 */
+	sequential,
+
+	/**
+	 * Entries are executed on a thread pool. Entries for the same peer are still executed in the order they were received.
+	 */
+	peerOrdered,
+
+	/**
+	 * All entries are executed on a thread pool without any ordering guarantees.
+	 */
+	unordered
+};
+
+/**
+ * Protocols the RPC client can use to call Homegear.
+ */
+enum class RPCProtocol
+{
+	/**
+	 * Homegear's binary RPC (default).
+	 */
+	binary,
+
+	/**
+	 * XML-RPC over HTTP.
+	 */
+	xmlRpc
+};
+
 /**
  * Base class of the library. To use the library you need to implement a class inheriting from Base.
  */
@@ -64,7 +110,17 @@ public:
 	Base(int32_t homegearPort, uint64_t myPeerId, int32_t debugLevel);
 
 	/**
-	 * Destructor
+	 * Constructor for host mode. The instance doesn't open its own connection to Homegear, but shares the one of the host with all other
+	 * instances of the host. Only the events of the peers subscribed by this instance are passed to it.
+	 *
+	 * @param host The host to use.
+	 * @param myPeerId The peer id of the addon. Can be "0".
+	 */
+	Base(std::shared_ptr<AddonHost> host, uint64_t myPeerId);
+
+	/**
+	 * Destructor. Waits for callbacks of this instance executing on other threads. Callbacks of other instances are not waited for, so
+	 * in host mode an instance can be destroyed from a callback of another one.
 	 */
 	virtual ~Base();
 
@@ -96,16 +152,230 @@ public:
 	 */
 	virtual void removePeers(std::vector<uint64_t> peerIds);
 
+	/**
+	 * Returns true when the connection to Homegear is initialized. The library connects to Homegear in the background after the
+	 * constructor returned and reconnects automatically.
+	 */
+	virtual bool isConnected();
+
+	/**
+	 * Waits until the connection to Homegear is initialized.
+	 *
+	 * @param timeout The maximum time to wait in milliseconds.
+	 * @return Returns true when the connection is initialized and false on timeout.
+	 */
+	virtual bool waitForConnection(uint32_t timeout);
+
+	/**
+	 * Sets how long "invoke" waits for the connection to Homegear, when it is not initialized yet. The default is "0", so "invoke"
+	 * fails immediately with error "-32300".
+	 *
+	 * @param timeout The maximum time to wait in milliseconds.
+	 */
+	virtual void setConnectionTimeout(uint32_t timeout) { _connectionTimeout = timeout; }
+
 	/**
 	 * With this method you can call RPC functions in Homegear.
 	 *
 	 * @see <a href="https://www.homegear.eu/index.php/Homegear_Reference">Homegear Reference</a>
 	 * @param methodName The name of the RPC method. See the Homegear reference for more information.
 	 * @param parameters List with the parameters to pass to the RPC function. You can use the macro RPCCLIENTPARAMETERS(parameter1, parameter2, ...) for easier usage. E. g.: invoke("getValue", RPCCLIENTPARAMETERS(4, 1, std::string("STATE")));
-	 * @return Returns the result of the RPC call received from Homegear.
+	 * @return Returns the result of the RPC call received from Homegear or error "-32300" when not connected to Homegear.
 	 */
 	virtual PVariable invoke(std::string methodName, PRPCList parameters = PRPCList());
 
+	/**
+	 * Makes a method callable by Homegear (or any other RPC client connecting to the addon). Registering a method with the name of an
+	 * already registered method replaces it.
+	 *
+	 * @param methodName The name of the RPC method. Names starting with "system." and names of the methods provided by the library (e. g. "event") can't be used.
+	 * @param method The function to call. It is executed on the RPC server thread. The returned value is sent back to the caller.
+	 * @return Returns true when the method was registered successfully.
+	 */
+	virtual bool registerMethod(std::string methodName, std::function<PVariable(PRPCArray parameters)> method);
+
+	/**
+	 * Makes a method callable by Homegear (or any other RPC client connecting to the addon). Use this overload to provide a signature
+	 * and help text for "system.methodSignature" and "system.methodHelp".
+	 *
+	 * @param methodName The name of the RPC method.
+	 * @param method The object implementing the method.
+	 * @return Returns true when the method was registered successfully.
+	 */
+	virtual bool registerMethod(std::string methodName, std::shared_ptr<RPCMethod> method);
+
+	/**
+	 * Removes a method previously registered with "registerMethod".
+	 *
+	 * @param methodName The name of the RPC method.
+	 * @return Returns true when the method was found and removed.
+	 */
+	virtual bool unregisterMethod(std::string methodName);
+
+	/**
+	 * Sets how the entries of "system.multicall" requests from Homegear are executed. When a mode other than "sequential" is set, the
+	 * overloaded callback methods (e. g. "event") might be called from multiple threads at the same time. In host mode the setting
+	 * applies to all instances of the host.
+	 *
+	 * @param mode The execution mode.
+	 * @param threadCount The number of threads executing the entries. Ignored when mode is "sequential".
+	 */
+	virtual void setMulticallMode(MulticallMode mode, uint32_t threadCount = 4);
+
+	/**
+	 * Same as above, but executes the entries on an existing thread pool. Use this to let multiple Base instances in one process share
+	 * their threads.
+	 *
+	 * @param mode The execution mode.
+	 * @param threadPool The thread pool executing the entries. Ignored when mode is "sequential".
+	 */
+	virtual void setMulticallMode(MulticallMode mode, std::shared_ptr<ThreadPool> threadPool);
+
+	/**
+	 * Sets the protocol "invoke" uses to call Homegear. Responses are decoded according to their format independent of this setting. The
+	 * library's own calls (e. g. "init") are affected, too. In host mode the setting applies to all instances of the host.
+	 *
+	 * @param protocol The protocol to use.
+	 */
+	virtual void setRpcProtocol(RPCProtocol protocol);
+
+	/**
+	 * Executes a function after a delay. All timers are executed on one library thread using a monotonic clock, so the callback should
+	 * return quickly.
+	 *
+	 * @param delay The time in milliseconds until the function is executed.
+	 * @param callback The function to execute.
+	 * @param interval When not "0" the function is executed again every "interval" milliseconds until the timer is removed.
+	 * @return Returns the id of the timer. Pass it to "removeTimer" to cancel the timer.
+	 */
+	virtual uint64_t addTimer(uint32_t delay, std::function<void()> callback, uint32_t interval = 0);
+
+	/**
+	 * Cancels a timer added with "addTimer". When the callback is currently executing, the method waits until it has returned (unless it
+	 * is called from the callback itself).
+	 *
+	 * @param timerId The id returned by "addTimer".
+	 * @return Returns true when the timer was still pending.
+	 */
+	virtual bool removeTimer(uint64_t timerId);
+
+	/**
+	 * Sets where the library's log output is written to. Output is written asynchronously by a library thread. By default it goes to the
+	 * standard output (and to the error output for warnings and errors). In host mode the setting applies to all instances of the host.
+	 *
+	 * @param sinks The log destinations, e. g. StdoutLogSink, FileLogSink or SyslogLogSink from LogSinks.h or your own implementation of
+	 * LogSink.
+	 */
+	virtual void setLogSinks(std::vector<std::shared_ptr<LogSink>> sinks);
+
+	/**
+	 * Sets what happens with log messages, when they are produced faster than they can be written. The default is to drop info and
+	 * debug messages.
+	 *
+	 * @param policy The drop policy.
+	 */
+	virtual void setLogDropPolicy(LogDropPolicy policy);
+
+	/**
+	 * Sets the clock used for the time prefix of log messages. The default is the local date and time. In host mode the setting applies
+	 * to all instances of the host.
+	 *
+	 * @param mode The time mode.
+	 */
+	virtual void setLogTimeMode(LogTimeMode mode);
+
+	/**
+	 * Starts capturing the raw RPC traffic with Homegear in an in-memory ring. This is much cheaper than debug level 5 and can be left
+	 * enabled in production. In host mode the capture covers all instances of the host.
+	 *
+	 * @see FlightRecorder
+	 * @param capacity The size of the ring in bytes. When it is full, the oldest frames are overwritten.
+	 * @param filename When set, the ring is placed in this memory mapped file, so the capture survives a crash.
+	 * @return Returns true on success.
+	 */
+	virtual bool startFlightRecorder(uint32_t capacity = 4194304, std::string filename = "");
+
+	/**
+	 * Stops the capture started with "startFlightRecorder".
+	 */
+	virtual void stopFlightRecorder();
+
+	/**
+	 * Writes the captured frames to a file.
+	 *
+	 * @param filename The file to write.
+	 * @return Returns true on success.
+	 */
+	virtual bool dumpFlightRecorder(std::string filename);
+
+	/**
+	 * Sets a file the captured frames are written to, when an error is logged.
+	 *
+	 * @param filename The file to write or an empty string to disable dumps on errors.
+	 */
+	virtual void setFlightRecorderErrorDump(std::string filename);
+
+	/**
+	 * Returns the current values of the library's metrics (call counts, latencies, connection state, ...) and of the metrics added to the
+	 * registry. Homegear and other RPC clients can read the same values with the RPC method "system.getMetrics". In host mode the metrics
+	 * cover all instances of the host.
+	 *
+	 * @see Metrics::getSnapshot()
+	 */
+	virtual PVariable getMetrics();
+
+	/**
+	 * Returns the metrics registry, e. g. to add metrics of the addon, which are then reported together with the library's.
+	 */
+	virtual Metrics& getMetricsRegistry();
+
+	/**
+	 * Starts recording timed spans of the RPC client and server (receive, decode, method call, callback, encode, write and the stages
+	 * of "invoke"). The spans of the library are only recorded, when it was built with HGADDON_TRACING set to 1. Spans of the addon can be
+	 * recorded in any case with a TraceSpan on "getTracer". The HGADDON_TRACE macros only record them, when the addon itself is compiled
+	 * with HGADDON_TRACING set to 1.
+	 *
+	 * @see Tracer
+	 * @param eventsPerThread The number of spans kept per thread. When more spans are recorded, the oldest are overwritten.
+	 */
+	virtual void startTracing(uint32_t eventsPerThread = 16384);
+
+	/**
+	 * Stops the recording started with "startTracing". The spans are kept and can still be exported.
+	 */
+	virtual void stopTracing();
+
+	/**
+	 * Writes the recorded spans as Chrome trace event JSON. The file can be opened with Perfetto (https://ui.perfetto.dev).
+	 *
+	 * @param filename The file to write.
+	 * @return Returns true on success.
+	 */
+	virtual bool exportTrace(std::string filename);
+
+	/**
+	 * Returns the tracer, e. g. to record spans of the addon with TraceSpan span(getTracer(), "name");
+	 */
+	virtual Tracer& getTracer();
+
+	/**
+	 * Sets the time after which a callback like "event" or "updateDevice" is logged as slow. While a callback is executed, no further
+	 * requests from Homegear are processed, so slow callbacks cause event backlogs. The latency of every callback type is also available
+	 * in "getMetrics" as "server.callbacks.<type>.time". The default threshold is 1000 ms.
+	 *
+	 * @see CallbackMonitor
+	 * @param threshold The threshold in milliseconds. "0" disables the warnings.
+	 * @param watchdog When true, callbacks are also reported while they are still running, e. g. when they never return.
+	 */
+	virtual void setSlowCallbackThreshold(uint32_t threshold, bool watchdog = false);
+
+	/**
+	 * The library calls this method when the connection to Homegear is initialized or lost. Overload it when needed.
+	 *
+	 * @param connected True when the connection was initialized, false when it was lost.
+	 */
+	virtual void connectionStateChanged(bool connected) {}
+
 	/**
 	 * Homegear calls this method when a device is deleted. Overload it when needed.
 	 *
@@ -147,7 +417,13 @@ public:
 	 */
 	virtual void updateDevice(uint64_t peerId, int32_t channel, int32_t flags) {}
 protected:
+	/**
+	 * The library context of this instance. Every Base instance has its own RPC server, RPC client, timers and output, so multiple
+	 * instances can be used in one process. In host mode the context is shared with the host and all of its instances.
+	 */
+	std::shared_ptr<SharedObjects> _bl;
 	uint64_t _myPeerId = 0;
+	uint32_t _connectionTimeout = 0;
 };
 
 }
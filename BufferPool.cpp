@@ -0,0 +1,116 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "BufferPool.h"
+
+#include <thread>
+#include <functional>
+
+namespace HgAddonLib
+{
+BufferPool::BufferPool(uint32_t maxCachedBytes) : _cachedBytes(0)
+{
+	_maxCachedBytes = maxCachedBytes;
+	for(uint32_t i = 0; i < _shardCount; ++i)
+	{
+		//Reserving the free lists up front keeps "put" from allocating once the pool is warm.
+		for(uint32_t j = 0; j < _classCount; ++j) _shards[i].freeBuffers[j].reserve(4);
+	}
+}
+
+uint32_t BufferPool::getShardIndex()
+{
+	return std::hash<std::thread::id>()(std::this_thread::get_id()) % _shardCount;
+}
+
+bool BufferPool::pop(Shard& shard, uint32_t sizeClass, std::vector<char>& buffer)
+{
+	std::lock_guard<std::mutex> shardGuard(shard.mutex);
+	//Encoders grow their buffer, so buffers requested small often come back in a larger class. Using the smallest larger buffer
+	//available keeps them in use instead of allocating a new small one. Much larger buffers are left for larger requests.
+	uint32_t maxSizeClass = sizeClass + _maxClassOvershoot + 1;
+	if(maxSizeClass > _classCount) maxSizeClass = _classCount;
+	for(uint32_t i = sizeClass; i < maxSizeClass; ++i)
+	{
+		std::vector<std::vector<char>>& freeBuffers = shard.freeBuffers[i];
+		if(freeBuffers.empty()) continue;
+		buffer.swap(freeBuffers.back());
+		freeBuffers.pop_back();
+		_cachedBytes -= buffer.capacity();
+		return true;
+	}
+	return false;
+}
+
+std::vector<char> BufferPool::get(uint32_t size)
+{
+	std::vector<char> buffer;
+	uint32_t classBits = _minClassBits;
+	while(classBits < _minClassBits + _classCount - 1 && (1u << classBits) < size) classBits++;
+	if((1u << classBits) < size || (1u << classBits) > _maxCachedBytes)
+	{
+		//Larger than the largest class or than the pool can hold. "put" releases such buffers, so they don't get the class size.
+		buffer.reserve(size);
+		return buffer;
+	}
+	uint32_t sizeClass = classBits - _minClassBits;
+	uint32_t shardIndex = getShardIndex();
+	if(pop(_shards[shardIndex], sizeClass, buffer)) return buffer;
+	if(_cachedBytes > 0)
+	{
+		//Buffers are returned to the shard of the returning thread, so look into the other shards before allocating.
+		for(uint32_t i = 1; i < _shardCount; ++i)
+		{
+			if(pop(_shards[(shardIndex + i) % _shardCount], sizeClass, buffer)) return buffer;
+		}
+	}
+	//Allocate the full class size, so the buffer can be reused for all sizes of its class.
+	buffer.reserve(1u << classBits);
+	return buffer;
+}
+
+void BufferPool::put(std::vector<char>& buffer)
+{
+	uint32_t capacity = buffer.capacity();
+	if(capacity < (1u << _minClassBits) || capacity >= (1u << (_minClassBits + _classCount)) || _cachedBytes + capacity > _maxCachedBytes)
+	{
+		std::vector<char>().swap(buffer);
+		return;
+	}
+	uint32_t classBits = _minClassBits;
+	while(classBits < _minClassBits + _classCount - 1 && (1u << (classBits + 1)) <= capacity) classBits++;
+	buffer.clear();
+	Shard& shard = _shards[getShardIndex()];
+	std::lock_guard<std::mutex> shardGuard(shard.mutex);
+	shard.freeBuffers[classBits - _minClassBits].push_back(std::vector<char>());
+	shard.freeBuffers[classBits - _minClassBits].back().swap(buffer);
+	_cachedBytes += capacity;
+}
+
+}
@@ -0,0 +1,104 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef BUFFERPOOL_H_
+#define BUFFERPOOL_H_
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace HgAddonLib
+{
+/**
+ * Pool of reusable byte buffers for the receive and encode paths. Buffers are kept in power of two size classes from 1 KiB to 16 MiB.
+ * The pool is split into shards selected by the calling thread, so threads returning and requesting buffers rarely compete for the same
+ * mutex. The total memory kept in the pool is limited; buffers exceeding the limit are released to the heap.
+ */
+class BufferPool
+{
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param maxCachedBytes The maximum number of bytes kept in the pool.
+	 */
+	BufferPool(uint32_t maxCachedBytes = 4194304);
+	virtual ~BufferPool() {}
+
+	/**
+	 * Returns an empty buffer with a capacity of at least "size" bytes. When no buffer of the matching class is cached, the smallest larger
+	 * one up to four times the class size is returned. Sizes whose class doesn't fit into the pool get exactly "size" bytes. Return the
+	 * buffer with "put" when it is not needed anymore.
+	 *
+	 * @param size The minimum capacity of the buffer.
+	 */
+	std::vector<char> get(uint32_t size);
+
+	/**
+	 * Returns a buffer to the pool. "buffer" is empty afterwards and can still be used.
+	 *
+	 * @param buffer The buffer to return. Buffers not obtained by "get" can be returned, too.
+	 */
+	void put(std::vector<char>& buffer);
+
+	/**
+	 * Returns the number of bytes currently kept in the pool.
+	 */
+	uint32_t getCachedBytes() { return _cachedBytes; }
+private:
+	static const uint32_t _minClassBits = 10;
+	static const uint32_t _classCount = 15;
+	static const uint32_t _shardCount = 8;
+
+	/**
+	 * The number of classes above the requested one "get" may return a cached buffer from.
+	 */
+	static const uint32_t _maxClassOvershoot = 2;
+
+	struct Shard
+	{
+		std::mutex mutex;
+		std::vector<std::vector<char>> freeBuffers[_classCount];
+	};
+
+	uint32_t _maxCachedBytes = 4194304;
+	std::atomic<uint32_t> _cachedBytes;
+	Shard _shards[_shardCount];
+
+	uint32_t getShardIndex();
+	bool pop(Shard& shard, uint32_t sizeClass, std::vector<char>& buffer);
+
+	BufferPool(const BufferPool&);
+	BufferPool& operator=(const BufferPool&);
+};
+
+}
+#endif
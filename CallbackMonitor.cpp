@@ -0,0 +1,151 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "CallbackMonitor.h"
+#include "SharedObjects.h"
+
+#include <algorithm>
+
+namespace HgAddonLib
+{
+CallbackMonitor::Scope::Scope(CallbackMonitor& monitor, CallbackType type, uint64_t peerId) : _monitor(monitor), _type(type), _peerId(peerId)
+{
+	_startTime = MetricHistogram::now();
+	if(_monitor._watchdogEnabled.load(std::memory_order_relaxed))
+	{
+		std::lock_guard<std::mutex> runningGuard(_monitor._runningMutex);
+		_runningEntry = _monitor._running.insert(_monitor._running.end(), this);
+		_watched = true;
+	}
+}
+
+CallbackMonitor::Scope::~Scope()
+{
+	int64_t duration = MetricHistogram::now() - _startTime;
+	bool reported = false;
+	if(_watched)
+	{
+		std::lock_guard<std::mutex> runningGuard(_monitor._runningMutex);
+		_monitor._running.erase(_runningEntry);
+		reported = _reported;
+	}
+	_monitor._times[(int32_t)_type]->record(duration);
+	uint32_t threshold = _monitor.getThreshold();
+	if(threshold == 0 || duration < (int64_t)threshold * 1000000) return;
+	_monitor._slowCallbacks->increment();
+	std::string peer = _peerId == 0 ? "" : " for peer " + std::to_string(_peerId);
+	if(reported) _monitor._bl->out.printWarning("Warning: Slow callback \"" + std::string(getName(_type)) + "\"" + peer + " finished after " + std::to_string(duration / 1000000) + " ms.");
+	else _monitor._bl->out.printWarning("Warning: Slow callback \"" + std::string(getName(_type)) + "\"" + peer + " took " + std::to_string(duration / 1000000) + " ms. Callbacks block the processing of further requests from Homegear.");
+}
+
+CallbackMonitor::CallbackMonitor(SharedObjects* bl) : _threshold(1000), _watchdogEnabled(false)
+{
+	_bl = bl;
+	for(int32_t i = 0; i < _typeCount; i++)
+	{
+		_times[i] = _bl->metrics.getHistogram("server.callbacks." + std::string(getName((CallbackType)i)) + ".time");
+	}
+	_slowCallbacks = _bl->metrics.getCounter("server.callbacks.slow");
+}
+
+CallbackMonitor::~CallbackMonitor()
+{
+	setThreshold(0, false);
+}
+
+const char* CallbackMonitor::getName(CallbackType type)
+{
+	switch(type)
+	{
+	case CallbackType::event:
+		return "event";
+	case CallbackType::newDevice:
+		return "newDevice";
+	case CallbackType::deleteDevice:
+		return "deleteDevice";
+	case CallbackType::updateDevice:
+		return "updateDevice";
+	case CallbackType::error:
+		return "error";
+	case CallbackType::connectionStateChanged:
+		return "connectionStateChanged";
+	}
+	return "unknown";
+}
+
+void CallbackMonitor::setThreshold(uint32_t threshold, bool watchdog)
+{
+	_threshold = threshold;
+	if(threshold == 0) watchdog = false;
+	//Running callbacks are checked ten times per threshold, so they are reported at most 10 % late.
+	uint32_t interval = watchdog ? std::max(threshold / 10, (uint32_t)10) : 0;
+	std::lock_guard<std::mutex> watchdogGuard(_watchdogMutex);
+	_watchdogEnabled = watchdog;
+	if(interval == _watchdogInterval) return;
+	//The interval depends on the threshold, so the timer is replaced when the threshold changes.
+	if(_watchdogTimer != 0)
+	{
+		_bl->timers.remove(_watchdogTimer);
+		_watchdogTimer = 0;
+	}
+	_watchdogInterval = interval;
+	if(watchdog) _watchdogTimer = _bl->timers.add(interval, [this] { checkRunning(); }, interval);
+}
+
+void CallbackMonitor::checkRunning()
+{
+	try
+	{
+		int64_t threshold = (int64_t)getThreshold() * 1000000;
+		if(threshold == 0) return;
+		int64_t now = MetricHistogram::now();
+		std::lock_guard<std::mutex> runningGuard(_runningMutex);
+		for(std::list<Scope*>::iterator i = _running.begin(); i != _running.end(); ++i)
+		{
+			if((*i)->_reported || now - (*i)->_startTime < threshold) continue;
+			(*i)->_reported = true;
+			std::string peer = (*i)->_peerId == 0 ? "" : " for peer " + std::to_string((*i)->_peerId);
+			_bl->out.printWarning("Warning: Callback \"" + std::string(getName((*i)->_type)) + "\"" + peer + " is still running after " + std::to_string((now - (*i)->_startTime) / 1000000) + " ms. No further requests from Homegear are processed until it returns.");
+		}
+	}
+	catch(const std::exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+}
+
+}
@@ -0,0 +1,130 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef CALLBACKMONITOR_H_
+#define CALLBACKMONITOR_H_
+
+#include "Metrics.h"
+
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+namespace HgAddonLib
+{
+class SharedObjects;
+
+/**
+ * Times the callbacks of the Base instances. Callbacks are executed on the thread reading from Homegear, so a callback blocking e. g. on
+ * a synchronous "invoke" stalls all further requests. The monitor keeps a latency histogram per callback type in the metrics registry
+ * ("server.callbacks.<type>.time") and logs every callback taking longer than the threshold. Optionally a watchdog on the timer thread of
+ * the context reports callbacks, which are still running after the threshold.
+ */
+class CallbackMonitor
+{
+public:
+	enum class CallbackType : int32_t
+	{
+		event = 0,
+		newDevice = 1,
+		deleteDevice = 2,
+		updateDevice = 3,
+		error = 4,
+		connectionStateChanged = 5
+	};
+
+	/**
+	 * Times one callback from its construction to its destruction.
+	 */
+	class Scope
+	{
+	public:
+		/**
+		 * @param peerId The peer the callback is executed for or "0".
+		 */
+		Scope(CallbackMonitor& monitor, CallbackType type, uint64_t peerId);
+		~Scope();
+	private:
+		friend class CallbackMonitor;
+
+		CallbackMonitor& _monitor;
+		CallbackType _type;
+		uint64_t _peerId = 0;
+		int64_t _startTime = 0;
+		bool _watched = false;
+		bool _reported = false;
+		std::list<Scope*>::iterator _runningEntry;
+
+		Scope(const Scope&);
+		Scope& operator=(const Scope&);
+	};
+
+	CallbackMonitor(SharedObjects* bl);
+	virtual ~CallbackMonitor();
+
+	static const char* getName(CallbackType type);
+
+	/**
+	 * Sets the time after which a callback is considered slow.
+	 *
+	 * @param threshold The threshold in milliseconds. "0" disables the warnings, the histograms are updated in any case.
+	 * @param watchdog When true, callbacks are also reported while they are still running. The watchdog checks them ten times per
+	 * threshold, so it is rescheduled when the threshold changes.
+	 */
+	void setThreshold(uint32_t threshold, bool watchdog);
+	uint32_t getThreshold() { return _threshold.load(std::memory_order_relaxed); }
+private:
+	static const int32_t _typeCount = 6;
+
+	SharedObjects* _bl = nullptr;
+	std::atomic<uint32_t> _threshold;
+	std::atomic_bool _watchdogEnabled;
+	std::shared_ptr<MetricHistogram> _times[_typeCount];
+	std::shared_ptr<MetricCounter> _slowCallbacks;
+
+	std::mutex _watchdogMutex;
+	uint64_t _watchdogTimer = 0;
+	uint32_t _watchdogInterval = 0;
+
+	/**
+	 * The callbacks currently executed. Only maintained while the watchdog is enabled.
+	 */
+	std::list<Scope*> _running;
+	std::mutex _runningMutex;
+
+	void checkRunning();
+
+	CallbackMonitor(const CallbackMonitor&);
+	CallbackMonitor& operator=(const CallbackMonitor&);
+};
+
+}
+#endif
@@ -28,13 +28,15 @@
  */
 
 #include "BinaryDecoder.h"
-#include "../GD.h"
+#include "FloatCodec.h"
+#include "../SharedObjects.h"
 
 namespace HgAddonLib
 {
 
-BinaryDecoder::BinaryDecoder()
+BinaryDecoder::BinaryDecoder(SharedObjects* bl)
 {
+	_bl = bl;
 }
 
 int32_t BinaryDecoder::decodeInteger(std::vector<char>& encodedData, uint32_t& position)
@@ -51,20 +53,20 @@ int32_t BinaryDecoder::decodeInteger(std::vector<char>& encodedData, uint32_t& p
 			integer = Math::getNumber(string);
 			return integer;
 		}
-		GD::hf.memcpyBigEndian((char*)&integer, &encodedData.at(position), 4);
+		_bl->hf.memcpyBigEndian((char*)&integer, &encodedData.at(position), 4);
 		position += 4;
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
 	return integer;
 }
@@ -83,20 +85,20 @@ int32_t BinaryDecoder::decodeInteger(std::vector<uint8_t>& encodedData, uint32_t
 			integer = Math::getNumber(string);
 			return integer;
 		}
-		GD::hf.memcpyBigEndian((char*)&integer, (char*)&encodedData.at(position), 4);
+		_bl->hf.memcpyBigEndian((char*)&integer, (char*)&encodedData.at(position), 4);
 		position += 4;
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
 	return integer;
 }
@@ -112,15 +114,15 @@ uint8_t BinaryDecoder::decodeByte(std::vector<char>& encodedData, uint32_t& posi
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
 	return byte;
 }
@@ -136,15 +138,15 @@ uint8_t BinaryDecoder::decodeByte(std::vector<uint8_t>& encodedData, uint32_t& p
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
 	return byte;
 }
@@ -161,15 +163,15 @@ std::string BinaryDecoder::decodeString(std::vector<char>& encodedData, uint32_t
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
     return "";
 }
@@ -186,15 +188,15 @@ std::string BinaryDecoder::decodeString(std::vector<uint8_t>& encodedData, uint3
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
     return "";
 }
@@ -203,35 +205,22 @@ double BinaryDecoder::decodeFloat(std::vector<char>& encodedData, uint32_t& posi
 {
 	try
 	{
-		if(position + 8 > encodedData.size()) return 0;
-		int32_t mantissa = 0;
-		int32_t exponent = 0;
-		GD::hf.memcpyBigEndian((char*)&mantissa, &encodedData.at(position), 4);
-		position += 4;
-		GD::hf.memcpyBigEndian((char*)&exponent, &encodedData.at(position), 4);
-		position += 4;
-		double floatValue = (double)mantissa / 0x40000000;
-		floatValue *= std::pow(2, exponent);
-		if(floatValue != 0)
-		{
-			int32_t digits = std::lround(std::floor(std::log10(floatValue) + 1));
-			double factor = std::pow(10, 9 - digits);
-			//Round to 9 digits
-			floatValue = std::floor(floatValue * factor + 0.5) / factor;
-		}
+		if(position + FloatCodec::encodedSize > encodedData.size()) return 0;
+		double floatValue = FloatCodec::decode(encodedData.data() + position);
+		position += FloatCodec::encodedSize;
 		return floatValue;
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
     return 0;
 }
@@ -240,36 +229,22 @@ double BinaryDecoder::decodeFloat(std::vector<uint8_t>& encodedData, uint32_t& p
 {
 	try
 	{
-		if(position + 8 > encodedData.size()) return 0;
-		int32_t mantissa = 0;
-		int32_t exponent = 0;
-		GD::hf.memcpyBigEndian((char*)&mantissa, (char*)&encodedData.at(position), 4);
-		position += 4;
-		GD::hf.memcpyBigEndian((char*)&exponent, (char*)&encodedData.at(position), 4);
-		position += 4;
-		double floatValue = (double)mantissa / 0x40000000;
-		if(exponent >= 0) floatValue *= (1 << exponent);
-		else floatValue /= (1 << (exponent * -1));
-		if(floatValue != 0)
-		{
-			int32_t digits = std::lround(std::floor(std::log10(floatValue) + 1));
-			double factor = std::pow(10, 9 - digits);
-			//Round to 9 digits
-			floatValue = std::floor(floatValue * factor + 0.5) / factor;
-		}
+		if(position + FloatCodec::encodedSize > encodedData.size()) return 0;
+		double floatValue = FloatCodec::decode((char*)encodedData.data() + position);
+		position += FloatCodec::encodedSize;
 		return floatValue;
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
     return 0;
 }
@@ -285,15 +260,15 @@ bool BinaryDecoder::decodeBoolean(std::vector<char>& encodedData, uint32_t& posi
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
     return false;
 }
@@ -309,15 +284,15 @@ bool BinaryDecoder::decodeBoolean(std::vector<uint8_t>& encodedData, uint32_t& p
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
     return false;
 }
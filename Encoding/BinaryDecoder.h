@@ -38,11 +38,12 @@
 
 namespace HgAddonLib
 {
+class SharedObjects;
 
 class BinaryDecoder
 {
 public:
-	BinaryDecoder();
+	BinaryDecoder(SharedObjects* bl);
 	virtual ~BinaryDecoder() {}
 
 	virtual int32_t decodeInteger(std::vector<char>& encodedData, uint32_t& position);
@@ -56,7 +57,7 @@ public:
 	virtual double decodeFloat(std::vector<char>& encodedData, uint32_t& position);
 	virtual double decodeFloat(std::vector<uint8_t>& encodedData, uint32_t& position);
 protected:
-
+	SharedObjects* _bl = nullptr;
 };
 }
 #endif
@@ -28,14 +28,15 @@
  */
 
 #include "BinaryEncoder.h"
-#include "../GD.h"
+#include "FloatCodec.h"
+#include "../SharedObjects.h"
 
 namespace HgAddonLib
 {
 
-BinaryEncoder::BinaryEncoder()
+BinaryEncoder::BinaryEncoder(SharedObjects* bl)
 {
-
+	_bl = bl;
 }
 
 void BinaryEncoder::encodeInteger(std::vector<char>& encodedData, int32_t integer)
@@ -43,20 +44,20 @@ void BinaryEncoder::encodeInteger(std::vector<char>& encodedData, int32_t intege
 	try
 	{
 		char result[4];
-		GD::hf.memcpyBigEndian(result, (char*)&integer, 4);
+		_bl->hf.memcpyBigEndian(result, (char*)&integer, 4);
 		encodedData.insert(encodedData.end(), result, result + 4);
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
 }
 
@@ -65,20 +66,20 @@ void BinaryEncoder::encodeInteger(std::vector<uint8_t>& encodedData, int32_t int
 	try
 	{
 		uint8_t result[4];
-		GD::hf.memcpyBigEndian(result, (uint8_t*)&integer, 4);
+		_bl->hf.memcpyBigEndian(result, (uint8_t*)&integer, 4);
 		encodedData.insert(encodedData.end(), result, result + 4);
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
 }
 
@@ -90,15 +91,15 @@ void BinaryEncoder::encodeByte(std::vector<char>& encodedData, uint8_t byte)
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
 }
 
@@ -110,15 +111,15 @@ void BinaryEncoder::encodeByte(std::vector<uint8_t>& encodedData, uint8_t byte)
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
 }
 
@@ -131,15 +132,15 @@ void BinaryEncoder::encodeString(std::vector<char>& encodedData, std::string& st
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
 }
 
@@ -152,15 +153,15 @@ void BinaryEncoder::encodeString(std::vector<uint8_t>& encodedData, std::string&
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
 }
 
@@ -172,15 +173,15 @@ void BinaryEncoder::encodeBoolean(std::vector<char>& encodedData, bool boolean)
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
 }
 
@@ -192,15 +193,15 @@ void BinaryEncoder::encodeBoolean(std::vector<uint8_t>& encodedData, bool boolea
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
 }
 
@@ -208,39 +209,21 @@ void BinaryEncoder::encodeFloat(std::vector<char>& encodedData, double floatValu
 {
 	try
 	{
-		double temp = std::abs(floatValue);
-		int32_t exponent = 0;
-		if(temp != 0 && temp < 0.5)
-		{
-			while(temp < 0.5)
-			{
-				temp *= 2;
-				exponent--;
-			}
-		}
-		else while(temp >= 1)
-		{
-			temp /= 2;
-			exponent++;
-		}
-		if(floatValue < 0) temp *= -1;
-		int32_t mantissa = std::lround(temp * 0x40000000);
-		char data[8];
-		GD::hf.memcpyBigEndian(data, (char*)&mantissa, 4);
-		GD::hf.memcpyBigEndian(data + 4, (char*)&exponent, 4);
-		encodedData.insert(encodedData.end(), data, data + 8);
+		char data[FloatCodec::encodedSize];
+		FloatCodec::encode(floatValue, data);
+		encodedData.insert(encodedData.end(), data, data + FloatCodec::encodedSize);
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
 }
 
@@ -248,39 +231,21 @@ void BinaryEncoder::encodeFloat(std::vector<uint8_t>& encodedData, double floatV
 {
 	try
 	{
-		double temp = std::abs(floatValue);
-		int32_t exponent = 0;
-		if(temp != 0 && temp < 0.5)
-		{
-			while(temp < 0.5)
-			{
-				temp *= 2;
-				exponent--;
-			}
-		}
-		else while(temp >= 1)
-		{
-			temp /= 2;
-			exponent++;
-		}
-		if(floatValue < 0) temp *= -1;
-		int32_t mantissa = std::lround(temp * 0x40000000);
-		char data[8];
-		GD::hf.memcpyBigEndian(data, (char*)&mantissa, 4);
-		GD::hf.memcpyBigEndian(data + 4, (char*)&exponent, 4);
-		encodedData.insert(encodedData.end(), data, data + 8);
+		char data[FloatCodec::encodedSize];
+		FloatCodec::encode(floatValue, data);
+		encodedData.insert(encodedData.end(), data, data + FloatCodec::encodedSize);
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
 }
 
@@ -38,11 +38,12 @@
 
 namespace HgAddonLib
 {
+class SharedObjects;
 
 class BinaryEncoder
 {
 public:
-	BinaryEncoder();
+	BinaryEncoder(SharedObjects* bl);
 	virtual ~BinaryEncoder() {}
 
 	virtual void encodeInteger(std::vector<char>& encodedData, int32_t integer);
@@ -56,7 +57,7 @@ public:
 	virtual void encodeFloat(std::vector<char>& encodedData, double floatValue);
 	virtual void encodeFloat(std::vector<uint8_t>& encodedData, double floatValue);
 protected:
-
+	SharedObjects* _bl = nullptr;
 };
 }
 #endif
@@ -0,0 +1,206 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "FloatCodec.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace HgAddonLib
+{
+
+FloatCodec::PowersOfTen::PowersOfTen()
+{
+	for(int32_t i = _minPowerOfTen; i <= _maxPowerOfTen; i++)
+	{
+		double value = std::pow(10, i);
+		values[i - _minPowerOfTen] = value;
+		digits[i - _minPowerOfTen] = (value > 0 && value <= std::numeric_limits<double>::max()) ? referenceDigits(value) : 0;
+	}
+}
+
+const FloatCodec::PowersOfTen& FloatCodec::powersOfTen()
+{
+	static const PowersOfTen powers;
+	return powers;
+}
+
+double FloatCodec::powerOfTen(int32_t exponent)
+{
+	if(exponent < _minPowerOfTen) return 0;
+	if(exponent > _maxPowerOfTen) return std::numeric_limits<double>::infinity();
+	return powersOfTen().values[exponent - _minPowerOfTen];
+}
+
+double FloatCodec::powerOfTwo(int32_t exponent)
+{
+	uint64_t bits = 0;
+	if(exponent > 1023) return std::numeric_limits<double>::infinity();
+	else if(exponent >= -1022) bits = (uint64_t)(exponent + 1023) << 52;
+	else if(exponent >= -1074) bits = 1ull << (exponent + 1074); //Subnormal
+	else return 0;
+	double value;
+	std::memcpy(&value, &bits, 8);
+	return value;
+}
+
+int32_t FloatCodec::referenceDigits(double value)
+{
+	return std::lround(std::floor(std::log10(value) + 1));
+}
+
+int32_t FloatCodec::countDigits(double value)
+{
+	uint64_t bits;
+	std::memcpy(&bits, &value, 8);
+	int32_t binaryExponent = (int32_t)((bits >> 52) & 0x7FF) - 1023;
+	if(binaryExponent == -1023) return referenceDigits(value); //Subnormal
+
+	//value is in [2^binaryExponent, 2^(binaryExponent + 1)), so it has either "lowerExponent + 1" or "lowerExponent + 2" digits.
+	//78913 / 2^18 approximates log10(2) closely enough to yield floor(binaryExponent * log10(2)) for all double exponents.
+	int32_t lowerExponent = (binaryExponent * 78913) >> 18;
+	const PowersOfTen& powers = powersOfTen();
+	int32_t index = lowerExponent - _minPowerOfTen;
+	if(value >= powers.values[index + 1]) index++;
+	if(value == powers.values[index]) return powers.digits[index];
+	//Close to a power of ten the result depends on the rounding of std::log10, so use it there.
+	if(value < powers.values[index] * 1.0000000001 || value > powers.values[index + 1] * 0.9999999999) return referenceDigits(value);
+	return index + _minPowerOfTen + 1;
+}
+
+void FloatCodec::writeInt32(char* encodedData, int32_t value)
+{
+	encodedData[0] = (char)((uint32_t)value >> 24);
+	encodedData[1] = (char)((uint32_t)value >> 16);
+	encodedData[2] = (char)((uint32_t)value >> 8);
+	encodedData[3] = (char)value;
+}
+
+int32_t FloatCodec::readInt32(const char* encodedData)
+{
+	return (int32_t)(((uint32_t)(uint8_t)encodedData[0] << 24) | ((uint32_t)(uint8_t)encodedData[1] << 16) | ((uint32_t)(uint8_t)encodedData[2] << 8) | (uint32_t)(uint8_t)encodedData[3]);
+}
+
+void FloatCodec::encode(double value, int32_t& mantissa, int32_t& exponent)
+{
+	uint64_t bits;
+	std::memcpy(&bits, &value, 8);
+	uint64_t significand = bits & 0xFFFFFFFFFFFFFull;
+	int32_t biasedExponent = (int32_t)((bits >> 52) & 0x7FF);
+	bool negative = (bits >> 63) != 0;
+	if(biasedExponent == 0x7FF)
+	{
+		if(significand == 0)
+		{
+			//Infinity. 1.0 * 2^1024 is the smallest encoding decoding to infinity again.
+			mantissa = negative ? -0x40000000 : 0x40000000;
+			exponent = 1024;
+		}
+		else
+		{
+			mantissa = 0;
+			exponent = 0;
+		}
+		return;
+	}
+	if(biasedExponent == 0)
+	{
+		if(significand == 0)
+		{
+			mantissa = 0;
+			exponent = 0;
+			return;
+		}
+		//Subnormal, normalize the significand so bit 52 is set.
+		int32_t shift = __builtin_clzll(significand) - 11;
+		significand <<= shift;
+		exponent = -1021 - shift;
+	}
+	else
+	{
+		significand |= 0x10000000000000ull;
+		exponent = biasedExponent - 1022;
+	}
+	//The value is now significand / 2^53 * 2^exponent with significand / 2^53 in [0.5, 1). Scale it to 2^30 rounding half away from
+	//zero like std::lround.
+	int32_t magnitude = (int32_t)((significand + 0x400000) >> 23);
+	mantissa = negative ? -magnitude : magnitude;
+}
+
+void FloatCodec::encode(double value, char* encodedData)
+{
+	int32_t mantissa = 0;
+	int32_t exponent = 0;
+	encode(value, mantissa, exponent);
+	writeInt32(encodedData, mantissa);
+	writeInt32(encodedData + 4, exponent);
+}
+
+void FloatCodec::encode(const double* values, uint32_t count, char* encodedData)
+{
+	for(uint32_t i = 0; i < count; i++)
+	{
+		encode(values[i], encodedData);
+		encodedData += encodedSize;
+	}
+}
+
+double FloatCodec::decode(int32_t mantissa, int32_t exponent)
+{
+	double value = ((double)mantissa / 0x40000000) * powerOfTwo(exponent);
+	if(value == 0) return value;
+	//std::log10 returns NaN or infinity for negative and infinite values, which std::lround turned into a digit count of 0.
+	int32_t digits = (value > 0 && value <= std::numeric_limits<double>::max()) ? countDigits(value) : 0;
+	double factor = powerOfTen(9 - digits);
+	//Round to 9 digits. Truncating through int64_t is equivalent to std::floor for values below 2^52, larger ones are integral already.
+	double rounded = value * factor + 0.5;
+	if(std::abs(rounded) < 4503599627370496.0)
+	{
+		double truncated = (double)(int64_t)rounded;
+		rounded = truncated > rounded ? truncated - 1 : truncated;
+	}
+	return rounded / factor;
+}
+
+double FloatCodec::decode(const char* encodedData)
+{
+	return decode(readInt32(encodedData), readInt32(encodedData + 4));
+}
+
+void FloatCodec::decode(const char* encodedData, uint32_t count, double* values)
+{
+	for(uint32_t i = 0; i < count; i++)
+	{
+		values[i] = decode(encodedData);
+		encodedData += encodedSize;
+	}
+}
+
+}
@@ -0,0 +1,139 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef FLOATCODEC_H_
+#define FLOATCODEC_H_
+
+#include <cstdint>
+
+namespace HgAddonLib
+{
+/**
+ * Conversion kernels for the float format of binary RPC. A float is transferred as a 32 bit mantissa scaled by 2^30 followed by a 32 bit
+ * exponent, both big endian. Decoding rounds the value to 9 significant digits (negative values to 9 decimal places).
+ *
+ * The kernels work on the bits of the double and on lookup tables instead of normalization loops and std::pow/std::log10. Their results
+ * are bit-exact with the original loop based implementation, "homegear-addon-float-check" verifies that. In contrast to the original
+ * implementation encoding infinity doesn't hang (it is encoded as 1.0 * 2^1024, which decodes to infinity again) and exponents outside of
+ * the range of int32_t shifts are decoded correctly. None of the methods throw.
+ */
+class FloatCodec
+{
+public:
+	/**
+	 * The number of bytes of one encoded float.
+	 */
+	static const uint32_t encodedSize = 8;
+
+	/**
+	 * Splits a double into mantissa and exponent.
+	 *
+	 * @param value The value to encode. NaN is encoded as 0.
+	 * @param[out] mantissa The mantissa scaled by 2^30.
+	 * @param[out] exponent The exponent.
+	 */
+	static void encode(double value, int32_t& mantissa, int32_t& exponent);
+
+	/**
+	 * Encodes a double into its 8 byte wire representation.
+	 *
+	 * @param value The value to encode.
+	 * @param[out] encodedData The destination. It must have room for "encodedSize" bytes.
+	 */
+	static void encode(double value, char* encodedData);
+
+	/**
+	 * Encodes an array of doubles. The encoded values are written back to back.
+	 *
+	 * @param values The values to encode.
+	 * @param count The number of values.
+	 * @param[out] encodedData The destination. It must have room for "count * encodedSize" bytes.
+	 */
+	static void encode(const double* values, uint32_t count, char* encodedData);
+
+	/**
+	 * Converts mantissa and exponent back to a double and rounds it the way Homegear does.
+	 *
+	 * @param mantissa The mantissa scaled by 2^30.
+	 * @param exponent The exponent.
+	 * @return Returns the decoded value.
+	 */
+	static double decode(int32_t mantissa, int32_t exponent);
+
+	/**
+	 * Decodes one float from its 8 byte wire representation.
+	 *
+	 * @param encodedData The encoded float. It must contain at least "encodedSize" bytes.
+	 * @return Returns the decoded value.
+	 */
+	static double decode(const char* encodedData);
+
+	/**
+	 * Decodes an array of floats written back to back.
+	 *
+	 * @param encodedData The encoded floats. It must contain at least "count * encodedSize" bytes.
+	 * @param count The number of values.
+	 * @param[out] values The destination. It must have room for "count" values.
+	 */
+	static void decode(const char* encodedData, uint32_t count, double* values);
+
+	/**
+	 * Returns 2^exponent like std::pow(2, exponent) does, i. e. 0 below the smallest subnormal and infinity above the largest double.
+	 */
+	static double powerOfTwo(int32_t exponent);
+
+	/**
+	 * Returns the number of digits in front of the decimal point the same way "std::lround(std::floor(std::log10(value) + 1))" does.
+	 * Only valid for positive, finite values.
+	 */
+	static int32_t countDigits(double value);
+private:
+	static const int32_t _minPowerOfTen = -350;
+	static const int32_t _maxPowerOfTen = 350;
+
+	/**
+	 * Powers of ten from 10^_minPowerOfTen to 10^_maxPowerOfTen as returned by std::pow and the digit count std::log10 yields for each of
+	 * them. Values equal to a power of ten (1, 10, 0.1, ...) are common, so they are looked up instead of calling std::log10.
+	 */
+	struct PowersOfTen
+	{
+		double values[_maxPowerOfTen - _minPowerOfTen + 1];
+		int32_t digits[_maxPowerOfTen - _minPowerOfTen + 1];
+
+		PowersOfTen();
+	};
+
+	static const PowersOfTen& powersOfTen();
+	static double powerOfTen(int32_t exponent);
+	static int32_t referenceDigits(double value);
+	static void writeInt32(char* encodedData, int32_t value);
+	static int32_t readInt32(const char* encodedData);
+};
+}
+#endif
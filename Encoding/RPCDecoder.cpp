@@ -28,13 +28,15 @@
  */
 
 #include "RPCDecoder.h"
-#include "../GD.h"
+#include "FloatCodec.h"
+#include "../SharedObjects.h"
 
 namespace HgAddonLib
 {
 
-RPCDecoder::RPCDecoder()
+RPCDecoder::RPCDecoder(SharedObjects* bl) : _decoder(bl)
 {
+	_bl = bl;
 }
 
 std::shared_ptr<RPCHeader> RPCDecoder::decodeHeader(std::vector<char>& packet)
@@ -58,15 +60,15 @@ std::shared_ptr<RPCHeader> RPCDecoder::decodeHeader(std::vector<char>& packet)
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
     return header;
 }
@@ -92,20 +94,30 @@ std::shared_ptr<RPCHeader> RPCDecoder::decodeHeader(std::vector<uint8_t>& packet
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
     return header;
 }
 
 std::shared_ptr<std::vector<std::shared_ptr<Variable>>> RPCDecoder::decodeRequest(std::vector<char>& packet, std::string& methodName)
+{
+	uint32_t methodNameOffset = 0;
+	uint32_t methodNameSize = 0;
+	std::shared_ptr<std::vector<std::shared_ptr<Variable>>> parameters = decodeRequest(packet, methodNameOffset, methodNameSize);
+	if(methodNameSize > 0) methodName = std::string(&packet.at(methodNameOffset), methodNameSize);
+	else methodName.clear();
+	return parameters;
+}
+
+std::shared_ptr<std::vector<std::shared_ptr<Variable>>> RPCDecoder::decodeRequest(std::vector<char>& packet, uint32_t& methodNameOffset, uint32_t& methodNameSize)
 {
 	try
 	{
@@ -113,12 +125,20 @@ std::shared_ptr<std::vector<std::shared_ptr<Variable>>> RPCDecoder::decodeReques
 		uint32_t headerSize = 0;
 		if(packet.at(3) & 0x40) headerSize = _decoder.decodeInteger(packet, position) + 4;
 		position = 8 + headerSize;
-		methodName = _decoder.decodeString(packet, position);
+		methodNameOffset = 0;
+		methodNameSize = 0;
+		int32_t stringLength = _decoder.decodeInteger(packet, position);
+		if(stringLength > 0 && position + stringLength <= packet.size())
+		{
+			methodNameOffset = position;
+			methodNameSize = stringLength;
+			position += stringLength;
+		}
 		uint32_t parameterCount = _decoder.decodeInteger(packet, position);
 		std::shared_ptr<std::vector<std::shared_ptr<Variable>>> parameters(new std::vector<std::shared_ptr<Variable>>());
 		if(parameterCount > 100)
 		{
-			GD::out.printError("Parameter count of RPC request is larger than 100.");
+			_bl->out.printError("Parameter count of RPC request is larger than 100.");
 			return parameters;
 		}
 		for(uint32_t i = 0; i < parameterCount; i++)
@@ -129,20 +149,30 @@ std::shared_ptr<std::vector<std::shared_ptr<Variable>>> RPCDecoder::decodeReques
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
     return std::shared_ptr<std::vector<std::shared_ptr<Variable>>>();
 }
 
 std::shared_ptr<std::vector<std::shared_ptr<Variable>>> RPCDecoder::decodeRequest(std::vector<uint8_t>& packet, std::string& methodName)
+{
+	uint32_t methodNameOffset = 0;
+	uint32_t methodNameSize = 0;
+	std::shared_ptr<std::vector<std::shared_ptr<Variable>>> parameters = decodeRequest(packet, methodNameOffset, methodNameSize);
+	if(methodNameSize > 0) methodName = std::string((char*)&packet.at(methodNameOffset), methodNameSize);
+	else methodName.clear();
+	return parameters;
+}
+
+std::shared_ptr<std::vector<std::shared_ptr<Variable>>> RPCDecoder::decodeRequest(std::vector<uint8_t>& packet, uint32_t& methodNameOffset, uint32_t& methodNameSize)
 {
 	try
 	{
@@ -150,12 +180,20 @@ std::shared_ptr<std::vector<std::shared_ptr<Variable>>> RPCDecoder::decodeReques
 		uint32_t headerSize = 0;
 		if(packet.at(3) & 0x40) headerSize = _decoder.decodeInteger(packet, position) + 4;
 		position = 8 + headerSize;
-		methodName = _decoder.decodeString(packet, position);
+		methodNameOffset = 0;
+		methodNameSize = 0;
+		int32_t stringLength = _decoder.decodeInteger(packet, position);
+		if(stringLength > 0 && position + stringLength <= packet.size())
+		{
+			methodNameOffset = position;
+			methodNameSize = stringLength;
+			position += stringLength;
+		}
 		uint32_t parameterCount = _decoder.decodeInteger(packet, position);
 		std::shared_ptr<std::vector<std::shared_ptr<Variable>>> parameters(new std::vector<std::shared_ptr<Variable>>());
 		if(parameterCount > 100)
 		{
-			GD::out.printError("Parameter count of RPC request is larger than 100.");
+			_bl->out.printError("Parameter count of RPC request is larger than 100.");
 			return parameters;
 		}
 		for(uint32_t i = 0; i < parameterCount; i++)
@@ -166,15 +204,15 @@ std::shared_ptr<std::vector<std::shared_ptr<Variable>>> RPCDecoder::decodeReques
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
     return std::shared_ptr<std::vector<std::shared_ptr<Variable>>>();
 }
@@ -184,7 +222,7 @@ std::shared_ptr<Variable> RPCDecoder::decodeResponse(std::vector<char>& packet,
 	uint32_t position = offset + 8;
 	std::shared_ptr<Variable> response = decodeParameter(packet, position);
 	if(packet.size() < 4) return response; //response is Void when packet is empty.
-	if(packet.at(3) == 0xFF)
+	if((uint8_t)packet.at(3) == 0xFF)
 	{
 		response->errorStruct = true;
 		if(response->structValue->find("faultCode") == response->structValue->end()) response->structValue->insert(RPCStructElement("faultCode", std::shared_ptr<Variable>(new Variable(-1))));
@@ -251,15 +289,15 @@ std::shared_ptr<Variable> RPCDecoder::decodeParameter(std::vector<char>& packet,
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
     return std::shared_ptr<Variable>();
 }
@@ -298,15 +336,15 @@ std::shared_ptr<Variable> RPCDecoder::decodeParameter(std::vector<uint8_t>& pack
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
     return std::shared_ptr<Variable>();
 }
@@ -325,15 +363,15 @@ std::shared_ptr<RPCArray> RPCDecoder::decodeArray(std::vector<char>& packet, uin
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
     return std::shared_ptr<std::vector<std::shared_ptr<Variable>>>();
 }
@@ -352,15 +390,15 @@ std::shared_ptr<RPCArray> RPCDecoder::decodeArray(std::vector<uint8_t>& packet,
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
     return std::shared_ptr<std::vector<std::shared_ptr<Variable>>>();
 }
@@ -380,15 +418,15 @@ std::shared_ptr<RPCStruct> RPCDecoder::decodeStruct(std::vector<char>& packet, u
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
     return std::shared_ptr<RPCStruct>();
 }
@@ -408,16 +446,217 @@ std::shared_ptr<RPCStruct> RPCDecoder::decodeStruct(std::vector<uint8_t>& packet
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
     return std::shared_ptr<RPCStruct>();
 }
+
+std::string RPCDecoder::getStatusString(DecodeStatus status)
+{
+	switch(status)
+	{
+	case DecodeStatus::ok:
+		return "ok";
+	case DecodeStatus::invalidHeader:
+		return "invalid header";
+	case DecodeStatus::truncated:
+		return "packet is truncated";
+	case DecodeStatus::invalidLength:
+		return "invalid length";
+	case DecodeStatus::invalidType:
+		return "unknown variable type";
+	case DecodeStatus::tooManyParameters:
+		return "more than 100 parameters";
+	case DecodeStatus::nestingTooDeep:
+		return "values are nested too deep";
+	case DecodeStatus::invalidXml:
+		return "invalid XML";
+	}
+	return "unknown status";
+}
+
+DecodeStatus RPCDecoder::readInteger(const char*& position, const char* end, int32_t& value)
+{
+	if(end - position < 4) return DecodeStatus::truncated;
+	value = (int32_t)(((uint32_t)(uint8_t)position[0] << 24) | ((uint32_t)(uint8_t)position[1] << 16) | ((uint32_t)(uint8_t)position[2] << 8) | (uint32_t)(uint8_t)position[3]);
+	position += 4;
+	return DecodeStatus::ok;
+}
+
+DecodeStatus RPCDecoder::readLength(const char*& position, const char* end, uint32_t minimumElementSize, uint32_t& length)
+{
+	int32_t value = 0;
+	DecodeStatus status = readInteger(position, end, value);
+	if(status != DecodeStatus::ok) return status;
+	if(value < 0) return DecodeStatus::invalidLength;
+	//Every element occupies at least "minimumElementSize" bytes, so this also rejects absurd counts before anything is allocated.
+	if((uint64_t)value * minimumElementSize > (uint64_t)(end - position)) return minimumElementSize == 1 ? DecodeStatus::truncated : DecodeStatus::invalidLength;
+	length = value;
+	return DecodeStatus::ok;
+}
+
+DecodeStatus RPCDecoder::getData(const char* packet, uint32_t packetSize, bool request, const char*& position, const char*& end)
+{
+	if(packetSize < 8 || strncmp(packet, "Bin", 3) != 0) return DecodeStatus::invalidHeader;
+	end = packet + packetSize;
+	position = packet + 4;
+	//Only requests carry a header. The type byte of error responses is 0xFF, which has the header bit set as well.
+	if(request && (packet[3] & 0x40))
+	{
+		//Header length, header and data length.
+		uint32_t headerSize = 0;
+		if(readLength(position, end, 1, headerSize) != DecodeStatus::ok || (uint32_t)(end - position) < headerSize + 4) return DecodeStatus::invalidHeader;
+		position += headerSize;
+	}
+	//Checking the data size first rejects truncated packets before anything is decoded. Bytes following the data are ignored.
+	uint32_t dataSize = 0;
+	DecodeStatus status = readLength(position, end, 1, dataSize);
+	if(status != DecodeStatus::ok) return status;
+	end = position + dataSize;
+	return DecodeStatus::ok;
+}
+
+DecodeStatus RPCDecoder::decodeParameter(const char*& position, const char* end, uint32_t depth, std::shared_ptr<Variable>& variable)
+{
+	if(depth > _maxNestingDepth) return DecodeStatus::nestingTooDeep;
+	int32_t typeValue = 0;
+	DecodeStatus status = readInteger(position, end, typeValue);
+	if(status != DecodeStatus::ok) return status;
+	VariableType type = (VariableType)typeValue;
+	uint32_t length = 0;
+	switch(type)
+	{
+	case VariableType::rpcVoid:
+		variable.reset(new Variable(type));
+		return DecodeStatus::ok;
+	case VariableType::rpcString:
+	case VariableType::rpcBase64:
+		status = readLength(position, end, 1, length);
+		if(status != DecodeStatus::ok) return status;
+		variable.reset(new Variable(type));
+		variable->stringValue.assign(position, length);
+		position += length;
+		return DecodeStatus::ok;
+	case VariableType::rpcInteger:
+		variable.reset(new Variable(type));
+		return readInteger(position, end, variable->integerValue);
+	case VariableType::rpcFloat:
+		if(end - position < (signed)FloatCodec::encodedSize) return DecodeStatus::truncated;
+		variable.reset(new Variable(type));
+		variable->floatValue = FloatCodec::decode(position);
+		position += FloatCodec::encodedSize;
+		return DecodeStatus::ok;
+	case VariableType::rpcBoolean:
+		if(end - position < 1) return DecodeStatus::truncated;
+		variable.reset(new Variable(type));
+		variable->booleanValue = (bool)*position;
+		position++;
+		return DecodeStatus::ok;
+	case VariableType::rpcArray:
+	{
+		//An element consists of at least its type.
+		status = readLength(position, end, 4, length);
+		if(status != DecodeStatus::ok) return status;
+		PVariable array(new Variable(type));
+		array->arrayValue->reserve(length);
+		for(uint32_t i = 0; i < length; i++)
+		{
+			PVariable element;
+			status = decodeParameter(position, end, depth + 1, element);
+			if(status != DecodeStatus::ok) return status;
+			array->arrayValue->push_back(std::move(element));
+		}
+		variable = std::move(array);
+		return DecodeStatus::ok;
+	}
+	case VariableType::rpcStruct:
+	{
+		//An element consists of at least the length of its name and its type.
+		status = readLength(position, end, 8, length);
+		if(status != DecodeStatus::ok) return status;
+		PVariable rpcStruct(new Variable(type));
+		for(uint32_t i = 0; i < length; i++)
+		{
+			uint32_t nameLength = 0;
+			status = readLength(position, end, 1, nameLength);
+			if(status != DecodeStatus::ok) return status;
+			std::string name(position, nameLength);
+			position += nameLength;
+			PVariable element;
+			status = decodeParameter(position, end, depth + 1, element);
+			if(status != DecodeStatus::ok) return status;
+			rpcStruct->structValue->insert(RPCStructElement(std::move(name), std::move(element)));
+		}
+		variable = std::move(rpcStruct);
+		return DecodeStatus::ok;
+	}
+	default:
+		return DecodeStatus::invalidType;
+	}
+}
+
+DecodeStatus RPCDecoder::decodeRequest(const char* packet, uint32_t packetSize, uint32_t& methodNameOffset, uint32_t& methodNameSize, std::shared_ptr<std::vector<std::shared_ptr<Variable>>>& parameters)
+{
+	methodNameOffset = 0;
+	methodNameSize = 0;
+	parameters.reset();
+	const char* position = nullptr;
+	const char* end = nullptr;
+	DecodeStatus status = getData(packet, packetSize, true, position, end);
+	if(status != DecodeStatus::ok) return status;
+	uint32_t stringLength = 0;
+	status = readLength(position, end, 1, stringLength);
+	if(status != DecodeStatus::ok) return status;
+	methodNameOffset = position - packet;
+	methodNameSize = stringLength;
+	position += stringLength;
+	uint32_t parameterCount = 0;
+	status = readLength(position, end, 4, parameterCount);
+	if(status != DecodeStatus::ok) return status;
+	if(parameterCount > _maxParameterCount) return DecodeStatus::tooManyParameters;
+	std::shared_ptr<std::vector<std::shared_ptr<Variable>>> decodedParameters(new std::vector<std::shared_ptr<Variable>>());
+	decodedParameters->reserve(parameterCount);
+	for(uint32_t i = 0; i < parameterCount; i++)
+	{
+		PVariable parameter;
+		status = decodeParameter(position, end, 0, parameter);
+		if(status != DecodeStatus::ok) return status;
+		decodedParameters->push_back(std::move(parameter));
+	}
+	parameters = std::move(decodedParameters);
+	return DecodeStatus::ok;
+}
+
+DecodeStatus RPCDecoder::decodeResponse(const char* packet, uint32_t packetSize, std::shared_ptr<Variable>& response)
+{
+	response.reset();
+	const char* position = nullptr;
+	const char* end = nullptr;
+	DecodeStatus status = getData(packet, packetSize, false, position, end);
+	if(status != DecodeStatus::ok) return status;
+	PVariable decodedResponse;
+	//An empty response is Void.
+	if(position == end) decodedResponse.reset(new Variable(VariableType::rpcVoid));
+	else
+	{
+		status = decodeParameter(position, end, 0, decodedResponse);
+		if(status != DecodeStatus::ok) return status;
+	}
+	if((uint8_t)packet[3] == 0xFF)
+	{
+		decodedResponse->errorStruct = true;
+		if(decodedResponse->structValue->find("faultCode") == decodedResponse->structValue->end()) decodedResponse->structValue->insert(RPCStructElement("faultCode", std::shared_ptr<Variable>(new Variable(-1))));
+		if(decodedResponse->structValue->find("faultString") == decodedResponse->structValue->end()) decodedResponse->structValue->insert(RPCStructElement("faultString", std::shared_ptr<Variable>(new Variable(std::string("undefined")))));
+	}
+	response = std::move(decodedResponse);
+	return DecodeStatus::ok;
+}
 }
@@ -41,21 +41,104 @@
 
 namespace HgAddonLib
 {
+class SharedObjects;
+
+/**
+ * The result of the strict decoding methods of RPCDecoder.
+ */
+enum class DecodeStatus : int32_t
+{
+	ok = 0,
+	/**
+	 * The packet doesn't start with "Bin" or its header is invalid.
+	 */
+	invalidHeader = 1,
+	/**
+	 * A value extends beyond the end of the packet.
+	 */
+	truncated = 2,
+	/**
+	 * A length or element count is negative or larger than the remaining bytes can hold.
+	 */
+	invalidLength = 3,
+	/**
+	 * The type of a value is unknown.
+	 */
+	invalidType = 4,
+	/**
+	 * A request has more than 100 parameters.
+	 */
+	tooManyParameters = 5,
+	/**
+	 * Arrays and structs are nested deeper than 512 levels.
+	 */
+	nestingTooDeep = 6,
+	/**
+	 * An XML-RPC packet is not well-formed XML or doesn't have the structure of XML-RPC.
+	 */
+	invalidXml = 7
+};
+
 class RPCDecoder
 {
 public:
-	RPCDecoder();
+	RPCDecoder(SharedObjects* bl);
 	virtual ~RPCDecoder() {}
 
 	virtual std::shared_ptr<RPCHeader> decodeHeader(std::vector<char>& packet);
 	virtual std::shared_ptr<RPCHeader> decodeHeader(std::vector<uint8_t>& packet);
 	virtual std::shared_ptr<std::vector<std::shared_ptr<Variable>>> decodeRequest(std::vector<char>& packet, std::string& methodName);
 	virtual std::shared_ptr<std::vector<std::shared_ptr<Variable>>> decodeRequest(std::vector<uint8_t>& packet, std::string& methodName);
+
+	/**
+	 * Decodes a request without copying the method name. The method name can be accessed using "methodNameOffset" and "methodNameSize".
+	 */
+	virtual std::shared_ptr<std::vector<std::shared_ptr<Variable>>> decodeRequest(std::vector<char>& packet, uint32_t& methodNameOffset, uint32_t& methodNameSize);
+	virtual std::shared_ptr<std::vector<std::shared_ptr<Variable>>> decodeRequest(std::vector<uint8_t>& packet, uint32_t& methodNameOffset, uint32_t& methodNameSize);
 	virtual std::shared_ptr<Variable> decodeResponse(std::vector<char>& packet, uint32_t offset = 0);
 	virtual std::shared_ptr<Variable> decodeResponse(std::vector<uint8_t>& packet, uint32_t offset = 0);
+
+	/**
+	 * Strict variant of "decodeRequest". Every length and element count is validated against the remaining bytes before anything is
+	 * allocated, the values themselves are read without further checks and without exceptions. A corrupt packet is rejected as a whole:
+	 * on any status but DecodeStatus::ok "parameters" is empty and no partially decoded values are returned. In contrast to the lenient
+	 * variant integers cut off at the end of the packet are not interpreted as text.
+	 *
+	 * @param packet The complete packet including the "Bin" prefix.
+	 * @param packetSize The size of the packet in bytes.
+	 * @param[out] methodNameOffset The offset of the method name within the packet.
+	 * @param[out] methodNameSize The length of the method name.
+	 * @param[out] parameters The decoded parameters.
+	 * @return Returns DecodeStatus::ok on success or the reason the packet was rejected.
+	 */
+	virtual DecodeStatus decodeRequest(const char* packet, uint32_t packetSize, uint32_t& methodNameOffset, uint32_t& methodNameSize, std::shared_ptr<std::vector<std::shared_ptr<Variable>>>& parameters);
+
+	/**
+	 * Strict variant of "decodeResponse". See the strict "decodeRequest" for the validation rules.
+	 *
+	 * @param packet The complete packet including the "Bin" prefix.
+	 * @param packetSize The size of the packet in bytes.
+	 * @param[out] response The decoded response. Empty on any status but DecodeStatus::ok.
+	 * @return Returns DecodeStatus::ok on success or the reason the packet was rejected.
+	 */
+	virtual DecodeStatus decodeResponse(const char* packet, uint32_t packetSize, std::shared_ptr<Variable>& response);
+
+	/**
+	 * Returns a description of "status" for log messages.
+	 */
+	static std::string getStatusString(DecodeStatus status);
 private:
+	static const uint32_t _maxParameterCount = 100;
+	static const uint32_t _maxNestingDepth = 512;
+
+	SharedObjects* _bl = nullptr;
 	BinaryDecoder _decoder;
 
+	static DecodeStatus readInteger(const char*& position, const char* end, int32_t& value);
+	static DecodeStatus readLength(const char*& position, const char* end, uint32_t minimumElementSize, uint32_t& length);
+	static DecodeStatus getData(const char* packet, uint32_t packetSize, bool request, const char*& position, const char*& end);
+	DecodeStatus decodeParameter(const char*& position, const char* end, uint32_t depth, std::shared_ptr<Variable>& variable);
+
 	std::shared_ptr<Variable> decodeParameter(std::vector<char>& packet, uint32_t& position);
 	std::shared_ptr<Variable> decodeParameter(std::vector<uint8_t>& packet, uint32_t& position);
 	VariableType decodeType(std::vector<char>& packet, uint32_t& position);
@@ -40,10 +40,12 @@
 
 namespace HgAddonLib
 {
+class SharedObjects;
+
 class RPCEncoder
 {
 public:
-	RPCEncoder();
+	RPCEncoder(SharedObjects* bl);
 	virtual ~RPCEncoder() {}
 
 	virtual void insertHeader(std::vector<char>& packet, const RPCHeader& header);
@@ -53,6 +55,7 @@ public:
 	virtual void encodeResponse(std::shared_ptr<Variable> variable, std::vector<char>& encodedData);
 	virtual void encodeResponse(std::shared_ptr<Variable> variable, std::vector<uint8_t>& encodedData);
 private:
+	SharedObjects* _bl = nullptr;
 	BinaryEncoder _encoder;
 	char _packetStartRequest[4];
 	char _packetStartResponse[5];
@@ -0,0 +1,426 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "XMLRPCDecoder.h"
+#include "RapidXml/rapidxml.hpp"
+#include "../SharedObjects.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+
+namespace HgAddonLib
+{
+
+namespace
+{
+bool equals(const char* text, std::size_t size, const char* expected)
+{
+	std::size_t expectedSize = strlen(expected);
+	return size == expectedSize && strncmp(text, expected, size) == 0;
+}
+
+rapidxml::xml_node<char>* firstElement(rapidxml::xml_node<char>* node)
+{
+	rapidxml::xml_node<char>* child = node->first_node();
+	while(child && child->type() != rapidxml::node_element) child = child->next_sibling();
+	return child;
+}
+
+rapidxml::xml_node<char>* nextElement(rapidxml::xml_node<char>* node)
+{
+	rapidxml::xml_node<char>* sibling = node->next_sibling();
+	while(sibling && sibling->type() != rapidxml::node_element) sibling = sibling->next_sibling();
+	return sibling;
+}
+
+//Returns the text from "start" up to the next markup.
+std::string getTextUntilMarkup(const char* start)
+{
+	const char* end = start;
+	while(*end && *end != '<') end++;
+	return std::string(start, end - start);
+}
+
+//The text of an element is split into data nodes and CDATA sections. RapidXml drops text consisting only of whitespace when it is
+//followed by markup. As the document is parsed in place, that whitespace is taken from the source.
+std::string getText(rapidxml::xml_node<char>* node)
+{
+	std::string text;
+	rapidxml::xml_node<char>* child = node->first_node();
+	if(!child || child->type() != rapidxml::node_data)
+	{
+		const char* start = node->name() + node->name_size();
+		while(*start && *start != '>') start++;
+		if(!*start || *(start - 1) == '/') return text;
+		text = getTextUntilMarkup(start + 1);
+	}
+	for(; child; child = child->next_sibling())
+	{
+		if(child->type() != rapidxml::node_data && child->type() != rapidxml::node_cdata) continue;
+		text.append(child->value(), child->value_size());
+		//Text following a CDATA section is a data node, unless it is whitespace only. The section ends with "]]>".
+		if(child->type() == rapidxml::node_cdata && (!child->next_sibling() || child->next_sibling()->type() != rapidxml::node_data))
+		{
+			text.append(getTextUntilMarkup(child->value() + child->value_size() + 3));
+		}
+	}
+	return text;
+}
+
+void trim(const char*& text, std::size_t& size)
+{
+	while(size > 0 && std::isspace((uint8_t)*text))
+	{
+		text++;
+		size--;
+	}
+	while(size > 0 && std::isspace((uint8_t)text[size - 1])) size--;
+}
+
+bool parseInteger(const char* text, std::size_t size, int32_t& value)
+{
+	trim(text, size);
+	bool negative = false;
+	if(size > 0 && (*text == '-' || *text == '+'))
+	{
+		negative = *text == '-';
+		text++;
+		size--;
+	}
+	if(size == 0 || size > 10) return false;
+	int64_t result = 0;
+	for(std::size_t i = 0; i < size; i++)
+	{
+		if(text[i] < '0' || text[i] > '9') return false;
+		result = result * 10 + (text[i] - '0');
+	}
+	if(negative) result = -result;
+	if(result < INT32_MIN || result > INT32_MAX) return false;
+	value = (int32_t)result;
+	return true;
+}
+
+//RapidXml parses recursively without depth limit, so the element depth is checked before parsing. The markup is skipped the same way
+//RapidXml skips it, so closing tags within comments, CDATA sections, processing instructions or a DOCTYPE can't hide the depth.
+//XML-RPC doesn't use attributes, so start tags containing quotes are rejected instead of guessing where the attribute values end.
+DecodeStatus checkElementDepth(const char* body, uint32_t maxDepth)
+{
+	uint32_t depth = 0;
+	const char* i = body;
+	while(*i)
+	{
+		if(*i != '<')
+		{
+			i++;
+			continue;
+		}
+		const char* end = nullptr;
+		if(i[1] == '?') end = strstr(i + 2, "?>");
+		else if(strncmp(i, "<!--", 4) == 0) end = strstr(i + 4, "-->");
+		else if(strncmp(i, "<![CDATA[", 9) == 0) end = strstr(i + 9, "]]>");
+		else if(strncmp(i, "<!DOCTYPE", 9) == 0 && std::isspace((uint8_t)i[9]))
+		{
+			end = i + 10;
+			while(*end && *end != '>')
+			{
+				if(*end == '[')
+				{
+					uint32_t brackets = 1;
+					end++;
+					while(*end && brackets > 0)
+					{
+						if(*end == '[') brackets++;
+						else if(*end == ']') brackets--;
+						end++;
+					}
+				}
+				else end++;
+			}
+			if(!*end) end = nullptr;
+		}
+		else if(i[1] == '!') end = strchr(i + 2, '>');
+		else if(i[1] == '/')
+		{
+			if(depth == 0) return DecodeStatus::invalidXml;
+			depth--;
+			end = strchr(i + 2, '>');
+		}
+		else
+		{
+			end = i + 1;
+			while(*end && *end != '>')
+			{
+				if(*end == '"' || *end == '\'') return DecodeStatus::invalidXml;
+				end++;
+			}
+			if(!*end) return DecodeStatus::invalidXml;
+			if(*(end - 1) != '/' && ++depth > maxDepth) return DecodeStatus::nestingTooDeep;
+		}
+		if(!end) return DecodeStatus::invalidXml;
+		i = end + 1;
+	}
+	return DecodeStatus::ok;
+}
+
+bool parseDouble(const char* text, std::size_t size, double& value)
+{
+	trim(text, size);
+	//strtod needs a terminated string, values aren't terminated when parsing with "parse_no_string_terminators".
+	char buffer[64];
+	if(size == 0 || size >= sizeof(buffer)) return false;
+	memcpy(buffer, text, size);
+	buffer[size] = 0;
+	char* end = nullptr;
+	value = std::strtod(buffer, &end);
+	return end == buffer + size;
+}
+}
+
+XMLRPCDecoder::XMLRPCDecoder(SharedObjects* bl)
+{
+	_bl = bl;
+}
+
+bool XMLRPCDecoder::isRequest(const char* packet, uint32_t packetSize)
+{
+	return packetSize >= 5 && strncmp(packet, "POST ", 5) == 0;
+}
+
+bool XMLRPCDecoder::isResponse(const char* packet, uint32_t packetSize)
+{
+	return packetSize >= 5 && strncmp(packet, "HTTP/", 5) == 0;
+}
+
+DecodeStatus XMLRPCDecoder::getMessageSize(const char* packet, uint32_t packetSize, uint32_t& headerSize, uint32_t& contentLength)
+{
+	headerSize = 0;
+	contentLength = 0;
+	bool contentLengthFound = false;
+	const char* end = packet + packetSize;
+	const char* line = packet;
+	while(true)
+	{
+		const char* lineEnd = line;
+		while(lineEnd + 1 < end && !(lineEnd[0] == '\r' && lineEnd[1] == '\n')) lineEnd++;
+		if(lineEnd + 1 >= end) return DecodeStatus::truncated;
+		if(lineEnd == line)
+		{
+			//Empty line, end of header.
+			if(!contentLengthFound) return DecodeStatus::invalidHeader;
+			headerSize = lineEnd + 2 - packet;
+			return DecodeStatus::ok;
+		}
+		if(lineEnd - line > 15 && strncasecmp(line, "Content-Length:", 15) == 0)
+		{
+			int32_t length = 0;
+			if(!parseInteger(line + 15, lineEnd - line - 15, length) || length < 0) return DecodeStatus::invalidHeader;
+			contentLength = length;
+			contentLengthFound = true;
+		}
+		else if(lineEnd - line > 18 && strncasecmp(line, "Transfer-Encoding:", 18) == 0) return DecodeStatus::invalidHeader;
+		line = lineEnd + 2;
+	}
+}
+
+DecodeStatus XMLRPCDecoder::getBody(std::vector<char>& packet, char*& body)
+{
+	uint32_t headerSize = 0;
+	uint32_t contentLength = 0;
+	DecodeStatus status = getMessageSize(packet.data(), packet.size(), headerSize, contentLength);
+	if(status != DecodeStatus::ok) return status == DecodeStatus::truncated ? DecodeStatus::invalidHeader : status;
+	if(packet.size() < headerSize + contentLength) return DecodeStatus::truncated;
+	//RapidXml needs the body to be terminated.
+	packet.resize(headerSize + contentLength);
+	packet.push_back(0);
+	body = packet.data() + headerSize;
+	return DecodeStatus::ok;
+}
+
+DecodeStatus XMLRPCDecoder::decodeValue(rapidxml::xml_node<char>* valueNode, uint32_t depth, std::shared_ptr<Variable>& variable)
+{
+	if(depth > _maxNestingDepth) return DecodeStatus::nestingTooDeep;
+	if(!valueNode || !equals(valueNode->name(), valueNode->name_size(), "value")) return DecodeStatus::invalidXml;
+	rapidxml::xml_node<char>* typeNode = firstElement(valueNode);
+	if(!typeNode)
+	{
+		//A value without type is a string.
+		variable.reset(new Variable(VariableType::rpcString));
+		variable->stringValue = getText(valueNode);
+		return DecodeStatus::ok;
+	}
+	const char* type = typeNode->name();
+	std::size_t typeSize = typeNode->name_size();
+	if(equals(type, typeSize, "string"))
+	{
+		variable.reset(new Variable(VariableType::rpcString));
+		variable->stringValue = getText(typeNode);
+	}
+	else if(equals(type, typeSize, "i4") || equals(type, typeSize, "int"))
+	{
+		variable.reset(new Variable(VariableType::rpcInteger));
+		if(!parseInteger(typeNode->value(), typeNode->value_size(), variable->integerValue)) return DecodeStatus::invalidXml;
+	}
+	else if(equals(type, typeSize, "boolean"))
+	{
+		variable.reset(new Variable(VariableType::rpcBoolean));
+		int32_t value = 0;
+		if(parseInteger(typeNode->value(), typeNode->value_size(), value)) variable->booleanValue = value != 0;
+		else if(equals(typeNode->value(), typeNode->value_size(), "true")) variable->booleanValue = true;
+		else if(!equals(typeNode->value(), typeNode->value_size(), "false")) return DecodeStatus::invalidXml;
+	}
+	else if(equals(type, typeSize, "double"))
+	{
+		variable.reset(new Variable(VariableType::rpcFloat));
+		if(!parseDouble(typeNode->value(), typeNode->value_size(), variable->floatValue)) return DecodeStatus::invalidXml;
+	}
+	else if(equals(type, typeSize, "base64"))
+	{
+		variable.reset(new Variable(VariableType::rpcBase64));
+		variable->stringValue = getText(typeNode);
+	}
+	else if(equals(type, typeSize, "array"))
+	{
+		rapidxml::xml_node<char>* dataNode = typeNode->first_node("data", 4);
+		if(!dataNode) return DecodeStatus::invalidXml;
+		PVariable array(new Variable(VariableType::rpcArray));
+		for(rapidxml::xml_node<char>* elementNode = firstElement(dataNode); elementNode; elementNode = nextElement(elementNode))
+		{
+			PVariable element;
+			DecodeStatus status = decodeValue(elementNode, depth + 1, element);
+			if(status != DecodeStatus::ok) return status;
+			array->arrayValue->push_back(std::move(element));
+		}
+		variable = std::move(array);
+	}
+	else if(equals(type, typeSize, "struct"))
+	{
+		PVariable rpcStruct(new Variable(VariableType::rpcStruct));
+		for(rapidxml::xml_node<char>* memberNode = firstElement(typeNode); memberNode; memberNode = nextElement(memberNode))
+		{
+			rapidxml::xml_node<char>* nameNode = memberNode->first_node("name", 4);
+			if(!equals(memberNode->name(), memberNode->name_size(), "member") || !nameNode) return DecodeStatus::invalidXml;
+			PVariable element;
+			DecodeStatus status = decodeValue(memberNode->first_node("value", 5), depth + 1, element);
+			if(status != DecodeStatus::ok) return status;
+			rpcStruct->structValue->insert(RPCStructElement(getText(nameNode), std::move(element)));
+		}
+		variable = std::move(rpcStruct);
+	}
+	else if(equals(type, typeSize, "nil")) variable.reset(new Variable(VariableType::rpcVoid));
+	else return DecodeStatus::invalidType;
+	return DecodeStatus::ok;
+}
+
+DecodeStatus XMLRPCDecoder::decodeRequest(std::vector<char>& packet, std::string& methodName, std::shared_ptr<std::vector<std::shared_ptr<Variable>>>& parameters)
+{
+	methodName.clear();
+	parameters.reset();
+	char* body = nullptr;
+	DecodeStatus status = getBody(packet, body);
+	if(status != DecodeStatus::ok) return status;
+	status = checkElementDepth(body, _maxElementDepth);
+	if(status != DecodeStatus::ok) return status;
+	try
+	{
+		rapidxml::xml_document<char> document;
+		document.parse<rapidxml::parse_no_string_terminators>(body);
+		rapidxml::xml_node<char>* methodCallNode = document.first_node("methodCall", 10);
+		if(!methodCallNode) return DecodeStatus::invalidXml;
+		rapidxml::xml_node<char>* methodNameNode = methodCallNode->first_node("methodName", 10);
+		if(!methodNameNode) return DecodeStatus::invalidXml;
+		std::shared_ptr<std::vector<std::shared_ptr<Variable>>> decodedParameters(new std::vector<std::shared_ptr<Variable>>());
+		rapidxml::xml_node<char>* paramsNode = methodCallNode->first_node("params", 6);
+		if(paramsNode)
+		{
+			for(rapidxml::xml_node<char>* paramNode = firstElement(paramsNode); paramNode; paramNode = nextElement(paramNode))
+			{
+				if(!equals(paramNode->name(), paramNode->name_size(), "param")) return DecodeStatus::invalidXml;
+				PVariable parameter;
+				status = decodeValue(paramNode->first_node("value", 5), 0, parameter);
+				if(status != DecodeStatus::ok) return status;
+				decodedParameters->push_back(std::move(parameter));
+			}
+		}
+		methodName.assign(methodNameNode->value(), methodNameNode->value_size());
+		parameters = std::move(decodedParameters);
+		return DecodeStatus::ok;
+	}
+	catch(const rapidxml::parse_error& ex)
+	{
+		return DecodeStatus::invalidXml;
+	}
+}
+
+DecodeStatus XMLRPCDecoder::decodeResponse(std::vector<char>& packet, std::shared_ptr<Variable>& response)
+{
+	response.reset();
+	char* body = nullptr;
+	DecodeStatus status = getBody(packet, body);
+	if(status != DecodeStatus::ok) return status;
+	status = checkElementDepth(body, _maxElementDepth);
+	if(status != DecodeStatus::ok) return status;
+	try
+	{
+		rapidxml::xml_document<char> document;
+		document.parse<rapidxml::parse_no_string_terminators>(body);
+		rapidxml::xml_node<char>* methodResponseNode = document.first_node("methodResponse", 14);
+		if(!methodResponseNode) return DecodeStatus::invalidXml;
+		PVariable decodedResponse;
+		rapidxml::xml_node<char>* faultNode = methodResponseNode->first_node("fault", 5);
+		if(faultNode)
+		{
+			status = decodeValue(faultNode->first_node("value", 5), 0, decodedResponse);
+			if(status != DecodeStatus::ok) return status;
+			decodedResponse->errorStruct = true;
+			if(decodedResponse->structValue->find("faultCode") == decodedResponse->structValue->end()) decodedResponse->structValue->insert(RPCStructElement("faultCode", std::shared_ptr<Variable>(new Variable(-1))));
+			if(decodedResponse->structValue->find("faultString") == decodedResponse->structValue->end()) decodedResponse->structValue->insert(RPCStructElement("faultString", std::shared_ptr<Variable>(new Variable(std::string("undefined")))));
+		}
+		else
+		{
+			rapidxml::xml_node<char>* paramsNode = methodResponseNode->first_node("params", 6);
+			rapidxml::xml_node<char>* paramNode = paramsNode ? paramsNode->first_node("param", 5) : nullptr;
+			//A response without value is Void.
+			if(!paramNode) decodedResponse.reset(new Variable(VariableType::rpcVoid));
+			else
+			{
+				status = decodeValue(paramNode->first_node("value", 5), 0, decodedResponse);
+				if(status != DecodeStatus::ok) return status;
+			}
+		}
+		response = std::move(decodedResponse);
+		return DecodeStatus::ok;
+	}
+	catch(const rapidxml::parse_error& ex)
+	{
+		return DecodeStatus::invalidXml;
+	}
+}
+
+}
@@ -0,0 +1,117 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef XMLRPCDECODER_H_
+#define XMLRPCDECODER_H_
+
+#include "../Variable.h"
+#include "RPCDecoder.h"
+
+#include <memory>
+#include <vector>
+#include <string>
+
+namespace rapidxml
+{
+template<class Ch> class xml_node;
+}
+
+namespace HgAddonLib
+{
+class SharedObjects;
+
+/**
+ * Decodes XML-RPC requests and responses including their HTTP header into the same Variable trees as RPCDecoder. The XML is parsed in
+ * situ with RapidXml: names and values point into the packet, only the resulting Variables are allocated. Like the strict methods of
+ * RPCDecoder all methods report errors through a DecodeStatus and never return partially decoded values.
+ */
+class XMLRPCDecoder
+{
+public:
+	XMLRPCDecoder(SharedObjects* bl);
+	virtual ~XMLRPCDecoder() {}
+
+	/**
+	 * Checks whether "packet" starts like an HTTP POST request.
+	 */
+	static bool isRequest(const char* packet, uint32_t packetSize);
+
+	/**
+	 * Checks whether "packet" starts like an HTTP response.
+	 */
+	static bool isResponse(const char* packet, uint32_t packetSize);
+
+	/**
+	 * Determines the size of an HTTP message from its header. Chunked transfer encoding is not supported.
+	 *
+	 * @param packet The beginning of the message.
+	 * @param packetSize The number of bytes received so far.
+	 * @param[out] headerSize The size of the header including the empty line.
+	 * @param[out] contentLength The size of the body.
+	 * @return Returns DecodeStatus::ok when the header is complete, DecodeStatus::truncated when it isn't and DecodeStatus::invalidHeader
+	 * when it has no "Content-Length".
+	 */
+	static DecodeStatus getMessageSize(const char* packet, uint32_t packetSize, uint32_t& headerSize, uint32_t& contentLength);
+
+	/**
+	 * Decodes an XML-RPC request.
+	 *
+	 * @param packet The complete HTTP request. It is parsed in place and modified. Bytes following the body are removed, so the start of
+	 * a pipelined request has to be copied before.
+	 * @param[out] methodName The name of the called method.
+	 * @param[out] parameters The decoded parameters.
+	 * @return Returns DecodeStatus::ok on success or the reason the packet was rejected. Documents nested deeper than _maxElementDepth
+	 * are rejected with DecodeStatus::nestingTooDeep before they are parsed.
+	 */
+	virtual DecodeStatus decodeRequest(std::vector<char>& packet, std::string& methodName, std::shared_ptr<std::vector<std::shared_ptr<Variable>>>& parameters);
+
+	/**
+	 * Decodes an XML-RPC response. Faults are returned with "errorStruct" set.
+	 *
+	 * @param packet The complete HTTP response. It is parsed in place and modified. Bytes following the body are removed.
+	 * @param[out] response The decoded response.
+	 * @return Returns DecodeStatus::ok on success or the reason the packet was rejected.
+	 */
+	virtual DecodeStatus decodeResponse(std::vector<char>& packet, std::shared_ptr<Variable>& response);
+private:
+	static const uint32_t _maxNestingDepth = 512;
+
+	/**
+	 * The maximum depth of XML elements. Every nesting level of a Variable takes three elements ("value", "array" and "data" or "value",
+	 * "struct" and "member"), "methodCall", "params" and "param" come on top. Deeper documents are rejected before parsing.
+	 */
+	static const uint32_t _maxElementDepth = _maxNestingDepth * 3 + 8;
+
+	SharedObjects* _bl = nullptr;
+
+	DecodeStatus getBody(std::vector<char>& packet, char*& body);
+	DecodeStatus decodeValue(rapidxml::xml_node<char>* valueNode, uint32_t depth, std::shared_ptr<Variable>& variable);
+};
+}
+#endif
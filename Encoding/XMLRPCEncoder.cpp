@@ -0,0 +1,230 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "XMLRPCEncoder.h"
+#include "../SharedObjects.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+namespace HgAddonLib
+{
+
+XMLRPCEncoder::XMLRPCEncoder(SharedObjects* bl)
+{
+	_bl = bl;
+}
+
+void XMLRPCEncoder::append(std::vector<char>& encodedData, const char* text)
+{
+	encodedData.insert(encodedData.end(), text, text + strlen(text));
+}
+
+bool XMLRPCEncoder::appendEscaped(std::vector<char>& encodedData, const std::string& text)
+{
+	const char* start = text.data();
+	const char* end = start + text.size();
+	for(const char* i = start; i != end; ++i)
+	{
+		const char* entity = nullptr;
+		if(*i == '<') entity = "&lt;";
+		else if(*i == '>') entity = "&gt;";
+		else if(*i == '&') entity = "&amp;";
+		//XML parsers convert line breaks to "\n", so a carriage return only survives as character reference.
+		else if(*i == '\r') entity = "&#13;";
+		//XML 1.0 doesn't allow any other control characters, not even as character reference.
+		else if((uint8_t)*i < 0x20 && *i != '\t' && *i != '\n') return false;
+		else continue;
+		encodedData.insert(encodedData.end(), start, i);
+		append(encodedData, entity);
+		start = i + 1;
+	}
+	encodedData.insert(encodedData.end(), start, end);
+	return true;
+}
+
+void XMLRPCEncoder::insertHttpHeader(std::vector<char>& encodedData, const std::string& header)
+{
+	std::string fullHeader = header + "Content-Type: text/xml\r\nContent-Length: " + std::to_string(encodedData.size()) + "\r\nConnection: Keep-Alive\r\n\r\n";
+	encodedData.insert(encodedData.begin(), fullHeader.begin(), fullHeader.end());
+}
+
+bool XMLRPCEncoder::encodeVariable(std::vector<char>& encodedData, const std::shared_ptr<Variable>& variable)
+{
+	append(encodedData, "<value>");
+	if(!variable || variable->type == VariableType::rpcVoid) append(encodedData, "<nil/>");
+	else if(variable->type == VariableType::rpcString)
+	{
+		append(encodedData, "<string>");
+		if(!appendEscaped(encodedData, variable->stringValue)) return false;
+		append(encodedData, "</string>");
+	}
+	else if(variable->type == VariableType::rpcInteger)
+	{
+		append(encodedData, "<i4>");
+		append(encodedData, std::to_string(variable->integerValue).c_str());
+		append(encodedData, "</i4>");
+	}
+	else if(variable->type == VariableType::rpcFloat)
+	{
+		if(std::isnan(variable->floatValue) || std::isinf(variable->floatValue)) return false;
+		//15 digits are enough for most values, only use 17 when they don't convert back to the same double.
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%.15g", variable->floatValue);
+		if(std::strtod(buffer, nullptr) != variable->floatValue) snprintf(buffer, sizeof(buffer), "%.17g", variable->floatValue);
+		append(encodedData, "<double>");
+		append(encodedData, buffer);
+		append(encodedData, "</double>");
+	}
+	else if(variable->type == VariableType::rpcBoolean)
+	{
+		append(encodedData, variable->booleanValue ? "<boolean>1</boolean>" : "<boolean>0</boolean>");
+	}
+	else if(variable->type == VariableType::rpcBase64)
+	{
+		append(encodedData, "<base64>");
+		if(!appendEscaped(encodedData, variable->stringValue)) return false;
+		append(encodedData, "</base64>");
+	}
+	else if(variable->type == VariableType::rpcArray)
+	{
+		append(encodedData, "<array><data>");
+		for(std::vector<std::shared_ptr<Variable>>::iterator i = variable->arrayValue->begin(); i != variable->arrayValue->end(); ++i)
+		{
+			if(!encodeVariable(encodedData, *i)) return false;
+		}
+		append(encodedData, "</data></array>");
+	}
+	else if(variable->type == VariableType::rpcStruct)
+	{
+		append(encodedData, "<struct>");
+		for(RPCStruct::iterator i = variable->structValue->begin(); i != variable->structValue->end(); ++i)
+		{
+			append(encodedData, "<member><name>");
+			if(!appendEscaped(encodedData, i->first)) return false;
+			append(encodedData, "</name>");
+			if(!encodeVariable(encodedData, i->second)) return false;
+			append(encodedData, "</member>");
+		}
+		append(encodedData, "</struct>");
+	}
+	append(encodedData, "</value>");
+	return true;
+}
+
+bool XMLRPCEncoder::encodeRequest(std::string methodName, std::shared_ptr<std::list<std::shared_ptr<Variable>>> parameters, std::vector<char>& encodedData, const std::string& host)
+{
+	try
+	{
+		encodedData.clear();
+		append(encodedData, "<?xml version=\"1.0\"?>\n<methodCall><methodName>");
+		bool valid = appendEscaped(encodedData, methodName);
+		append(encodedData, "</methodName><params>");
+		if(parameters)
+		{
+			for(std::list<std::shared_ptr<Variable>>::iterator i = parameters->begin(); valid && i != parameters->end(); ++i)
+			{
+				append(encodedData, "<param>");
+				valid = encodeVariable(encodedData, *i);
+				append(encodedData, "</param>");
+			}
+		}
+		if(!valid)
+		{
+			encodedData.clear();
+			return false;
+		}
+		append(encodedData, "</params></methodCall>\n");
+		insertHttpHeader(encodedData, "POST /RPC2 HTTP/1.1\r\nUser-Agent: Homegear Addon\r\nHost: " + host + "\r\n");
+		return true;
+	}
+	catch(const std::exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+    encodedData.clear();
+    return false;
+}
+
+bool XMLRPCEncoder::encodeResponseBody(const std::shared_ptr<Variable>& variable, std::vector<char>& encodedData)
+{
+	encodedData.clear();
+	append(encodedData, "<?xml version=\"1.0\"?>\n<methodResponse>");
+	if(variable && variable->errorStruct)
+	{
+		append(encodedData, "<fault>");
+		if(!encodeVariable(encodedData, variable)) return false;
+		append(encodedData, "</fault>");
+	}
+	else
+	{
+		append(encodedData, "<params><param>");
+		if(!encodeVariable(encodedData, variable)) return false;
+		append(encodedData, "</param></params>");
+	}
+	append(encodedData, "</methodResponse>\n");
+	return true;
+}
+
+void XMLRPCEncoder::encodeResponse(std::shared_ptr<Variable> variable, std::vector<char>& encodedData)
+{
+	try
+	{
+		if(!encodeResponseBody(variable, encodedData))
+		{
+			_bl->out.printError("Error: Response contains values XML-RPC can't represent (control characters, NaN or infinity).");
+			encodeResponseBody(Variable::createError(-32603, "Response contains values XML-RPC can't represent."), encodedData);
+		}
+		insertHttpHeader(encodedData, "HTTP/1.1 200 OK\r\n");
+	}
+	catch(const std::exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+}
+
+}
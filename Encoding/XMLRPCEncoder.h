@@ -0,0 +1,84 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef XMLRPCENCODER_H_
+#define XMLRPCENCODER_H_
+
+#include "../Variable.h"
+
+#include <memory>
+#include <vector>
+#include <list>
+#include <string>
+
+namespace HgAddonLib
+{
+class SharedObjects;
+
+/**
+ * Encodes XML-RPC requests and responses including their HTTP header. The XML is written directly into the packet, so encoding doesn't
+ * build a document tree. Void is encoded as "<nil/>". Values XML-RPC can't represent, i. e. strings containing
+ * control characters XML 1.0 doesn't allow and NaN or infinite doubles, are rejected.
+ */
+class XMLRPCEncoder
+{
+public:
+	XMLRPCEncoder(SharedObjects* bl);
+	virtual ~XMLRPCEncoder() {}
+
+	/**
+	 * Encodes a request as HTTP POST request.
+	 *
+	 * @param methodName The name of the method to call.
+	 * @param parameters The parameters of the method.
+	 * @param[out] encodedData The encoded request.
+	 * @param host The value of the HTTP "Host" header.
+	 * @return Returns false, when a parameter can't be represented in XML-RPC. "encodedData" is empty then.
+	 */
+	virtual bool encodeRequest(std::string methodName, std::shared_ptr<std::list<std::shared_ptr<Variable>>> parameters, std::vector<char>& encodedData, const std::string& host = "127.0.0.1");
+
+	/**
+	 * Encodes a response as HTTP response. Variables with "errorStruct" set are encoded as fault. When the return value can't be
+	 * represented in XML-RPC, a fault with code -32603 is encoded instead.
+	 *
+	 * @param variable The return value.
+	 * @param[out] encodedData The encoded response.
+	 */
+	virtual void encodeResponse(std::shared_ptr<Variable> variable, std::vector<char>& encodedData);
+private:
+	SharedObjects* _bl = nullptr;
+
+	void append(std::vector<char>& encodedData, const char* text);
+	bool appendEscaped(std::vector<char>& encodedData, const std::string& text);
+	void insertHttpHeader(std::vector<char>& encodedData, const std::string& header);
+	bool encodeVariable(std::vector<char>& encodedData, const std::shared_ptr<Variable>& variable);
+	bool encodeResponseBody(const std::shared_ptr<Variable>& variable, std::vector<char>& encodedData);
+};
+}
+#endif
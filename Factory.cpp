@@ -34,6 +34,11 @@ HgAddonLib::Base* HgAddonLib::AddonFactory::createAddon(int32_t homegearPort, ui
 	return new HgAddonLib::Base(homegearPort, myPeerId, debugLevel);
 }
 
+HgAddonLib::Base* HgAddonLib::AddonFactory::createAddon(std::shared_ptr<HgAddonLib::AddonHost> host, uint64_t myPeerId)
+{
+	return new HgAddonLib::Base(host, myPeerId);
+}
+
 HgAddonLib::AddonFactory* getFactory()
 {
 	return new HgAddonLib::AddonFactory();
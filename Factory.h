@@ -31,6 +31,7 @@
 #define SYSTEMFACTORY_H_
 
 #include "Base.h"
+#include "Host.h"
 
 #include <memory>
 
@@ -43,6 +44,7 @@ public:
 	virtual ~AddonFactory() {}
 
 	virtual Base* createAddon(int32_t homegearPort, uint64_t myPeerId, int32_t debugLevel);
+	virtual Base* createAddon(std::shared_ptr<AddonHost> host, uint64_t myPeerId);
 };
 
 extern "C" AddonFactory* getFactory();
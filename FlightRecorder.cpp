@@ -0,0 +1,241 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "FlightRecorder.h"
+#include "SharedObjects.h"
+
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace HgAddonLib
+{
+FlightRecorder::FlightRecorder(SharedObjects* bl) : _enabled(false), _lastErrorDump(-10000), _errorDumpTimer(0)
+{
+	_bl = bl;
+}
+
+FlightRecorder::~FlightRecorder()
+{
+	stop();
+}
+
+void FlightRecorder::release()
+{
+	_enabled = false;
+	_header = nullptr;
+	_ring = nullptr;
+	std::vector<char>().swap(_memory);
+	if(_mappedMemory)
+	{
+		msync(_mappedMemory, _mappedSize, MS_ASYNC);
+		munmap(_mappedMemory, _mappedSize);
+		_mappedMemory = nullptr;
+		_mappedSize = 0;
+	}
+}
+
+bool FlightRecorder::start(uint32_t capacity, std::string filename)
+{
+	std::string error;
+	{
+		std::lock_guard<std::mutex> recorderGuard(_mutex);
+		release();
+		if(capacity < 1024) capacity = 1024;
+		size_t size = sizeof(FileHeader) + capacity;
+		char* memory = nullptr;
+		if(filename.empty())
+		{
+			_memory.resize(size, 0);
+			memory = _memory.data();
+		}
+		else
+		{
+			int fileDescriptor = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+			if(fileDescriptor == -1) error = "Could not open flight recorder file " + filename + ": " + strerror(errno);
+			else if(ftruncate(fileDescriptor, size) == -1) error = "Could not resize flight recorder file " + filename + ": " + strerror(errno);
+			else
+			{
+				void* mappedMemory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+				if(mappedMemory == MAP_FAILED) error = "Could not map flight recorder file " + filename + ": " + strerror(errno);
+				else
+				{
+					_mappedMemory = (char*)mappedMemory;
+					_mappedSize = size;
+					memory = _mappedMemory;
+				}
+			}
+			//The mapping stays valid after closing the file.
+			if(fileDescriptor != -1) close(fileDescriptor);
+		}
+
+		if(memory)
+		{
+			_header = (FileHeader*)memory;
+			_ring = memory + sizeof(FileHeader);
+			std::memset(_header, 0, sizeof(FileHeader));
+			std::memcpy(_header->magic, "HGFR", 4);
+			_header->version = version;
+			_header->capacity = capacity;
+			//The frame times are relative to the creation of the library context, so the header gets the matching wall clock time.
+			int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+			_header->startTime = now - std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _bl->startTime).count();
+			_maxFrameSize = capacity / 4 - sizeof(FrameHeader);
+			_enabled = true;
+		}
+	}
+	if(!error.empty())
+	{
+		_bl->out.printError("Error: " + error);
+		return false;
+	}
+	return true;
+}
+
+void FlightRecorder::stop()
+{
+	uint64_t errorDumpTimer = 0;
+	{
+		//Disabled under the lock, so "errorOccurred" can't add a dump after the timer is removed.
+		std::lock_guard<std::mutex> recorderGuard(_mutex);
+		_enabled = false;
+		errorDumpTimer = _errorDumpTimer;
+		_errorDumpTimer = 0;
+	}
+	//"remove" waits for a running dump, which locks the recorder, so the lock must not be held here.
+	_bl->timers.remove(errorDumpTimer);
+	std::lock_guard<std::mutex> recorderGuard(_mutex);
+	release();
+}
+
+void FlightRecorder::copyIn(uint64_t offset, const void* data, uint32_t size)
+{
+	uint32_t position = offset % _header->capacity;
+	uint32_t firstPart = std::min((uint64_t)size, _header->capacity - position);
+	std::memcpy(_ring + position, data, firstPart);
+	if(firstPart < size) std::memcpy(_ring, (const char*)data + firstPart, size - firstPart);
+}
+
+void FlightRecorder::copyOut(uint64_t offset, void* data, uint32_t size)
+{
+	uint32_t position = offset % _header->capacity;
+	uint32_t firstPart = std::min((uint64_t)size, _header->capacity - position);
+	std::memcpy(data, _ring + position, firstPart);
+	if(firstPart < size) std::memcpy((char*)data + firstPart, _ring, size - firstPart);
+}
+
+void FlightRecorder::record(Direction direction, const char* data, uint32_t size)
+{
+	if(!enabled()) return;
+	FrameHeader frame;
+	std::memset(&frame, 0, sizeof(FrameHeader));
+	frame.time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _bl->startTime).count();
+	frame.originalSize = size;
+	frame.direction = direction;
+
+	std::lock_guard<std::mutex> recorderGuard(_mutex);
+	if(!_header) return;
+	frame.size = std::min(size, _maxFrameSize);
+	uint64_t frameSize = sizeof(FrameHeader) + frame.size;
+	//Make room by dropping the oldest frames.
+	while(_header->head + frameSize - _header->tail > _header->capacity)
+	{
+		FrameHeader oldFrame;
+		copyOut(_header->tail, &oldFrame, sizeof(FrameHeader));
+		_header->tail += sizeof(FrameHeader) + oldFrame.size;
+		_header->overwrittenFrames++;
+	}
+	copyIn(_header->head, &frame, sizeof(FrameHeader));
+	copyIn(_header->head + sizeof(FrameHeader), data, frame.size);
+	//"head" is moved last, so a mapped file never contains a partially written frame.
+	_header->head += frameSize;
+}
+
+bool FlightRecorder::dump(std::string filename)
+{
+	std::vector<char> content;
+	{
+		std::lock_guard<std::mutex> recorderGuard(_mutex);
+		if(!_header) return false;
+		//Write the frames as a ring without free space starting at offset 0.
+		uint64_t usedBytes = _header->head - _header->tail;
+		content.resize(sizeof(FileHeader) + usedBytes);
+		FileHeader* header = (FileHeader*)content.data();
+		*header = *_header;
+		header->capacity = usedBytes;
+		header->tail = 0;
+		header->head = usedBytes;
+		copyOut(_header->tail, content.data() + sizeof(FileHeader), usedBytes);
+	}
+
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	if(file) file.write(content.data(), content.size());
+	if(!file)
+	{
+		_bl->out.printError("Error: Could not write flight recorder dump " + filename + ": " + strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+void FlightRecorder::setErrorDumpFile(std::string filename)
+{
+	std::lock_guard<std::mutex> recorderGuard(_mutex);
+	_errorDumpFile = filename;
+}
+
+void FlightRecorder::errorOccurred()
+{
+	if(!enabled()) return;
+	int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	int64_t lastErrorDump = _lastErrorDump;
+	//Besides limiting the number of dumps, this also keeps errors printed by "dump" from triggering another dump.
+	if(now - lastErrorDump < 10000 || !_lastErrorDump.compare_exchange_strong(lastErrorDump, now)) return;
+	std::lock_guard<std::mutex> recorderGuard(_mutex);
+	//Checked again under the lock, because "stop" might have been called in the meantime.
+	if(!_enabled || _errorDumpFile.empty()) return;
+	//Errors are logged on any thread, including the ones serving Homegear. Writing the file is left to the timer thread.
+	_errorDumpTimer = _bl->timers.add(0, [this] { dumpOnError(); });
+}
+
+void FlightRecorder::dumpOnError()
+{
+	std::string filename;
+	{
+		std::lock_guard<std::mutex> recorderGuard(_mutex);
+		filename = _errorDumpFile;
+	}
+	if(!filename.empty()) dump(filename);
+}
+
+}
@@ -0,0 +1,198 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef FLIGHTRECORDER_H_
+#define FLIGHTRECORDER_H_
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+namespace HgAddonLib
+{
+class SharedObjects;
+
+/**
+ * Captures the raw RPC frames exchanged with Homegear in a fixed size in-memory ring, so a problem can be analyzed without raising the
+ * debug level. When the ring is full, the oldest frames are overwritten. The content can be written to a file with "dump", on request or
+ * automatically when an error is logged. Alternatively the ring can be placed in a memory mapped file, so the capture is continuously
+ * written to disk and survives a crash of the process.
+ *
+ * Dumps and mapped files share one format: a FileHeader followed by the ring of "capacity" bytes. The frames are stored between the
+ * offsets "tail" and "head" (modulo "capacity"), each as a FrameHeader followed by the frame data. All numbers are in host byte order.
+ */
+class FlightRecorder
+{
+public:
+	/**
+	 * The direction of a frame.
+	 */
+	enum class Direction : uint8_t
+	{
+		clientRequest = 0,
+		clientResponse = 1,
+		serverRequest = 2,
+		serverResponse = 3
+	};
+
+	struct FileHeader
+	{
+		/**
+		 * "HGFR"
+		 */
+		char magic[4];
+		uint32_t version;
+
+		/**
+		 * The size of the ring following the header.
+		 */
+		uint64_t capacity;
+
+		/**
+		 * The offset behind the newest frame. Grows continuously and has to be taken modulo "capacity".
+		 */
+		uint64_t head;
+
+		/**
+		 * The offset of the oldest frame. Grows continuously and has to be taken modulo "capacity".
+		 */
+		uint64_t tail;
+
+		/**
+		 * The unix time in milliseconds the frame times are relative to.
+		 */
+		int64_t startTime;
+
+		/**
+		 * The number of frames overwritten because the ring was full.
+		 */
+		uint64_t overwrittenFrames;
+	};
+
+	struct FrameHeader
+	{
+		/**
+		 * The nanoseconds since "startTime" of the file header. Taken from a monotonic clock.
+		 */
+		int64_t time;
+
+		/**
+		 * The number of bytes following this header.
+		 */
+		uint32_t size;
+
+		/**
+		 * The size of the frame on the wire. Larger than "size" when the frame was truncated.
+		 */
+		uint32_t originalSize;
+
+		Direction direction;
+		uint8_t reserved[7];
+	};
+
+	static const uint32_t version = 1;
+
+	FlightRecorder(SharedObjects* bl);
+	virtual ~FlightRecorder();
+
+	/**
+	 * Returns true when frames are captured. Only one relaxed atomic load, so it can be checked on every frame.
+	 */
+	bool enabled() { return _enabled.load(std::memory_order_relaxed); }
+
+	/**
+	 * Starts capturing frames. A running capture is stopped first.
+	 *
+	 * @param capacity The size of the ring in bytes. Frames larger than a quarter of it are truncated.
+	 * @param filename When set, the ring is placed in this file using mmap. The file is created or overwritten.
+	 * @return Returns true on success.
+	 */
+	bool start(uint32_t capacity, std::string filename = "");
+
+	/**
+	 * Stops capturing and releases the ring. A mapped file is kept and contains the frames captured so far.
+	 */
+	void stop();
+
+	/**
+	 * Captures one frame. Does nothing when the recorder is not enabled.
+	 *
+	 * @param direction The direction of the frame.
+	 * @param data The frame as sent or received including the binary RPC header.
+	 * @param size The size of the frame.
+	 */
+	void record(Direction direction, const char* data, uint32_t size);
+
+	/**
+	 * Writes the frames currently in the ring to a file.
+	 *
+	 * @param filename The file to write. It is overwritten.
+	 * @return Returns true on success.
+	 */
+	bool dump(std::string filename);
+
+	/**
+	 * Sets a file the ring is dumped to, when an error or critical message is logged. Dumps are written at most every 10 seconds on the
+	 * timer thread, so the thread logging the error doesn't wait for the file to be written.
+	 *
+	 * @param filename The file to write or an empty string to disable dumps on errors.
+	 */
+	void setErrorDumpFile(std::string filename);
+
+	/**
+	 * Called by Output when an error is logged. Schedules the dump and returns immediately.
+	 */
+	void errorOccurred();
+private:
+	SharedObjects* _bl = nullptr;
+	std::atomic_bool _enabled;
+	std::mutex _mutex;
+	std::vector<char> _memory;
+	char* _mappedMemory = nullptr;
+	size_t _mappedSize = 0;
+	FileHeader* _header = nullptr;
+	char* _ring = nullptr;
+	uint32_t _maxFrameSize = 0;
+	std::string _errorDumpFile;
+	std::atomic<int64_t> _lastErrorDump;
+	uint64_t _errorDumpTimer; //Guarded by "_mutex".
+
+	void copyIn(uint64_t offset, const void* data, uint32_t size);
+	void copyOut(uint64_t offset, void* data, uint32_t size);
+	void release();
+	void dumpOnError();
+
+	FlightRecorder(const FlightRecorder&);
+	FlightRecorder& operator=(const FlightRecorder&);
+};
+
+}
+#endif
@@ -28,11 +28,16 @@
  */
 
 #include "HelperFunctions.h"
-#include "../GD.h"
+#include "../Output.h"
 #include "sys/resource.h"
 
 namespace HgAddonLib
 {
+/**
+ * Most helper functions are static and have no library context, so errors are printed with the default debug level.
+ */
+static Output _out;
+
 HelperFunctions::HelperFunctions()
 {
 	checkEndianness();
@@ -174,15 +179,15 @@ std::vector<std::string> HelperFunctions::getFiles(std::string path)
 				}
 				catch(const std::exception& ex)
 				{
-					GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+					_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
 				}
 				catch(const Exception& ex)
 				{
-					GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+					_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
 				}
 				catch(...)
 				{
-					GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+					_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
 				}
 			}
 		}
@@ -273,15 +278,15 @@ void HelperFunctions::memcpyBigEndian(char* to, const char* from, const uint32_t
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
 }
 
@@ -293,15 +298,15 @@ void HelperFunctions::memcpyBigEndian(uint8_t* to, const uint8_t* from, const ui
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
 }
 
@@ -318,15 +323,15 @@ void HelperFunctions::memcpyBigEndian(int32_t& to, const std::vector<uint8_t>& f
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
 }
 
@@ -346,15 +351,15 @@ void HelperFunctions::memcpyBigEndian(std::vector<uint8_t>& to, const int32_t& f
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
 }
 
@@ -398,15 +403,15 @@ char HelperFunctions::getHexChar(int32_t nibble)
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
     return 0;
 }
@@ -538,7 +543,7 @@ void HelperFunctions::copyFile(std::string source, std::string dest)
 		int32_t in_fd = open(source.c_str(), O_RDONLY);
 		if(in_fd == -1)
 		{
-			GD::out.printError("Error copying file " + source + ": " + strerror(errno));
+			_out.printError("Error copying file " + source + ": " + strerror(errno));
 			return;
 		}
 
@@ -548,7 +553,7 @@ void HelperFunctions::copyFile(std::string source, std::string dest)
 		if(out_fd == -1)
 		{
 			close(in_fd);
-			GD::out.printError("Error copying file " + source + ": " + strerror(errno));
+			_out.printError("Error copying file " + source + ": " + strerror(errno));
 			return;
 		}
 		char buf[8192];
@@ -561,14 +566,14 @@ void HelperFunctions::copyFile(std::string source, std::string dest)
 			{
 				close(in_fd);
 				close(out_fd);
-				GD::out.printError("Error reading file " + source + ": " + strerror(errno));
+				_out.printError("Error reading file " + source + ": " + strerror(errno));
 				return;
 			}
 			if(write(out_fd, &buf[0], result) != result)
 			{
 				close(in_fd);
 				close(out_fd);
-				GD::out.printError("Error writing file " + dest + ": " + strerror(errno));
+				_out.printError("Error writing file " + dest + ": " + strerror(errno));
 				return;
 			}
 		}
@@ -577,15 +582,15 @@ void HelperFunctions::copyFile(std::string source, std::string dest)
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(const Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
 }
 
@@ -599,8 +604,8 @@ int32_t HelperFunctions::userID(std::string username)
 	int32_t result = getpwnam_r(username.c_str(), &pwd, &buffer.at(0), buffer.size(), &pwdResult);
 	if(!pwdResult)
 	{
-		if(result == 0) GD::out.printError("User name " + username + " not found.");
-		else GD::out.printError("Error getting UID for user name " + username + ": " + std::string(strerror(result)));
+		if(result == 0) _out.printError("User name " + username + " not found.");
+		else _out.printError("Error getting UID for user name " + username + ": " + std::string(strerror(result)));
 		return -1;
 	}
 	return pwd.pw_uid;
@@ -616,8 +621,8 @@ int32_t HelperFunctions::groupID(std::string groupname)
 	int32_t result = getgrnam_r(groupname.c_str(), &grp, &buffer.at(0), buffer.size(), &grpResult);
 	if(!grpResult)
 	{
-		if(result == 0) GD::out.printError("User name " + groupname + " not found.");
-		else GD::out.printError("Error getting GID for group name " + groupname + ": " + std::string(strerror(result)));
+		if(result == 0) _out.printError("User name " + groupname + " not found.");
+		else _out.printError("Error getting GID for group name " + groupname + ": " + std::string(strerror(result)));
 		return -1;
 	}
 	return grp.gr_gid;
@@ -638,7 +643,7 @@ pid_t HelperFunctions::system(std::string command, std::vector<std::string> argu
         struct rlimit limits;
     	if(getrlimit(RLIMIT_NOFILE, &limits) == -1)
     	{
-    		GD::out.printError("Error: Couldn't read rlimits.");
+    		_out.printError("Error: Couldn't read rlimits.");
     		return -1;
     	}
         // Close all other descriptors for the safety sake.
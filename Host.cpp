@@ -27,31 +27,36 @@
  * files in the program, then also delete it here.
  */
 
-#ifndef GD_H_
-#define GD_H_
-
-#include "Exception.h"
-#include "Output.h"
-#include "HelperFunctions/HelperFunctions.h"
-#include "HelperFunctions/Math.h"
-#include "RPCServer.h"
-#include "RPCClient.h"
+#include "Host.h"
+#include "SharedObjects.h"
 
 namespace HgAddonLib
 {
-class GD
+AddonHost::AddonHost(int32_t homegearPort, int32_t debugLevel)
+{
+	_bl.reset(new SharedObjects());
+	_bl->debugLevel = debugLevel;
+	_bl->rpcClient.setPort(homegearPort);
+	_bl->rpcServer.start();
+}
+
+AddonHost::~AddonHost()
+{
+}
+
+bool AddonHost::isConnected()
+{
+	return _bl->rpcServer.isConnected();
+}
+
+bool AddonHost::waitForConnection(uint32_t timeout)
 {
-public:
-	static int32_t debugLevel;
-	static Output out;
-	static HelperFunctions hf;
-	static RPCServer rpcServer;
-	static RPCClient rpcClient;
+	return _bl->rpcServer.waitForConnection(timeout);
+}
+
+void AddonHost::processPacket(std::vector<char>& packet, std::vector<char>& response)
+{
+	_bl->rpcServer.processPacket(packet, response);
+}
 
-	virtual ~GD() {}
-private:
-	//Non public constructor
-	GD();
-};
 }
-#endif
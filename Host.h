@@ -0,0 +1,94 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef HGADDONHOST_H_
+#define HGADDONHOST_H_
+
+#include <memory>
+#include <vector>
+
+namespace HgAddonLib
+{
+class SharedObjects;
+
+/**
+ * Lets multiple Base instances in one process share one connection to Homegear. All instances created with the host use the host's
+ * RPC server, RPC client and one subscription. Events are decoded once and only passed to the instances subscribed to the peer.
+ *
+ * The methods registered with "registerMethod" and the multicall mode are shared by all instances of the host, too.
+ */
+class AddonHost
+{
+public:
+	/**
+	 * Constructor. Starts the RPC server and connects to Homegear in the background.
+	 *
+	 * @param homegearPort The port Homegear's RPC server listens on.
+	 * @param debugLevel The debug level. Possible values: 1 (critical), 2 (error), 3 (warning), 4 (info), 5 (debug)
+	 */
+	AddonHost(int32_t homegearPort, int32_t debugLevel);
+
+	/**
+	 * Destructor. The connection to Homegear is closed, when the host and all Base instances using it are destroyed.
+	 */
+	virtual ~AddonHost();
+
+	/**
+	 * Returns true when the connection to Homegear is initialized.
+	 */
+	virtual bool isConnected();
+
+	/**
+	 * Waits until the connection to Homegear is initialized.
+	 *
+	 * @param timeout The maximum time to wait in milliseconds.
+	 * @return Returns true when the connection is initialized and false on timeout.
+	 */
+	virtual bool waitForConnection(uint32_t timeout);
+
+	/**
+	 * Executes a binary RPC request as if it was received from Homegear and returns the encoded response. The request is passed to the Base
+	 * instances of the host like any other. Meant for replaying recorded traffic (see FlightRecorder) and benchmarks.
+	 *
+	 * @param packet The request including the binary RPC header.
+	 * @param response The encoded response. A fault with code -32700 when the request could not be decoded. Empty when the called method
+	 * returned no value.
+	 */
+	virtual void processPacket(std::vector<char>& packet, std::vector<char>& response);
+private:
+	friend class Base;
+
+	std::shared_ptr<SharedObjects> _bl;
+
+	AddonHost(const AddonHost&);
+	AddonHost& operator=(const AddonHost&);
+};
+
+}
+#endif
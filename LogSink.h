@@ -0,0 +1,83 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef LOGSINK_H_
+#define LOGSINK_H_
+
+#include <string>
+
+namespace HgAddonLib
+{
+/**
+ * One preformatted log line.
+ */
+struct LogRecord
+{
+	/**
+	 * The level of the message: 1 (critical), 2 (error), 3 (warning), 4 (info), 5 (debug). "0" is used for messages printed regardless of
+	 * the debug level.
+	 */
+	int32_t level = 0;
+
+	/**
+	 * The formatted time of the message. Can be empty.
+	 */
+	std::string time;
+
+	/**
+	 * The message including the prefix of the Output object.
+	 */
+	std::string message;
+};
+
+/**
+ * Base class of all log destinations. Sinks are only called from the log writer thread, so they don't need to be thread safe. They must not
+ * use Output themselves.
+ */
+class LogSink
+{
+public:
+	LogSink() {}
+	virtual ~LogSink() {}
+
+	/**
+	 * Writes one record.
+	 *
+	 * @param record The record to write.
+	 */
+	virtual void write(const LogRecord& record) = 0;
+
+	/**
+	 * Called after a batch of records has been written.
+	 */
+	virtual void flush() {}
+};
+
+}
+#endif
@@ -0,0 +1,156 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "LogSinks.h"
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <syslog.h>
+
+namespace HgAddonLib
+{
+void StdoutLogSink::write(const LogRecord& record)
+{
+	if(record.time.empty()) std::cout << record.message << '\n';
+	else std::cout << record.time << ' ' << record.message << '\n';
+	if(record.level < 1 || record.level > 3) return;
+	if(record.time.empty()) std::cerr << record.message << '\n';
+	else std::cerr << record.time << ' ' << record.message << '\n';
+}
+
+void StdoutLogSink::flush()
+{
+	std::cout.flush();
+	std::cerr.flush();
+}
+
+FileLogSink::FileLogSink(std::string filename, uint32_t maxFileSize, uint32_t maxFiles)
+{
+	_filename = filename;
+	_maxFileSize = maxFileSize;
+	_maxFiles = maxFiles;
+	open();
+}
+
+FileLogSink::~FileLogSink()
+{
+	if(_file.is_open()) _file.close();
+}
+
+void FileLogSink::open()
+{
+	_file.open(_filename, std::ios::out | std::ios::app);
+	if(!_file.is_open())
+	{
+		std::cerr << "Error: Could not open log file " << _filename << ": " << strerror(errno) << std::endl;
+		return;
+	}
+	_file.seekp(0, std::ios::end);
+	std::streamoff fileSize = _file.tellp();
+	if(fileSize == -1)
+	{
+		//Not seekable, e. g. a FIFO or a character device. Renaming such a file doesn't start a new one, so it isn't rotated.
+		_file.clear();
+		_fileSize = 0;
+		_rotate = false;
+	}
+	else _fileSize = fileSize;
+}
+
+void FileLogSink::rotate()
+{
+	_file.close();
+	if(_maxFiles == 0) std::remove(_filename.c_str());
+	else
+	{
+		std::remove((_filename + "." + std::to_string(_maxFiles)).c_str());
+		for(uint32_t i = _maxFiles - 1; i > 0; i--)
+		{
+			std::rename((_filename + "." + std::to_string(i)).c_str(), (_filename + "." + std::to_string(i + 1)).c_str());
+		}
+		std::rename(_filename.c_str(), (_filename + ".1").c_str());
+	}
+	open();
+}
+
+void FileLogSink::write(const LogRecord& record)
+{
+	if(!_file.is_open()) return;
+	uint32_t size = record.time.empty() ? record.message.size() + 1 : record.time.size() + record.message.size() + 2;
+	if(_rotate && _fileSize > 0 && _fileSize + size > _maxFileSize)
+	{
+		rotate();
+		if(!_file.is_open()) return;
+	}
+	if(record.time.empty()) _file << record.message << '\n';
+	else _file << record.time << ' ' << record.message << '\n';
+	_fileSize += size;
+}
+
+void FileLogSink::flush()
+{
+	if(_file.is_open()) _file.flush();
+}
+
+SyslogLogSink::SyslogLogSink(std::string ident)
+{
+	_ident = ident;
+	openlog(_ident.c_str(), LOG_PID, LOG_DAEMON);
+}
+
+SyslogLogSink::~SyslogLogSink()
+{
+	closelog();
+}
+
+void SyslogLogSink::write(const LogRecord& record)
+{
+	int priority = LOG_DEBUG;
+	switch(record.level)
+	{
+	case 1:
+		priority = LOG_CRIT;
+		break;
+	case 2:
+		priority = LOG_ERR;
+		break;
+	case 3:
+		priority = LOG_WARNING;
+		break;
+	case 0:
+	case 4:
+		priority = LOG_INFO;
+		break;
+	}
+	syslog(priority, "%s", record.message.c_str());
+}
+
+}
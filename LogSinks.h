@@ -0,0 +1,109 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef LOGSINKS_H_
+#define LOGSINKS_H_
+
+#include "LogSink.h"
+
+#include <string>
+#include <fstream>
+
+namespace HgAddonLib
+{
+/**
+ * Writes all records to the standard output. Warnings, errors and critical messages are written to the error output, too.
+ */
+class StdoutLogSink : public LogSink
+{
+public:
+	StdoutLogSink() {}
+	virtual ~StdoutLogSink() {}
+
+	virtual void write(const LogRecord& record);
+	virtual void flush();
+};
+
+/**
+ * Writes all records to a file. When the file exceeds the maximum size, it is renamed to "<filename>.1" (existing backups are shifted
+ * up to "<filename>.<maxFiles>") and a new file is started. Files that are not seekable, e. g. FIFOs, are not rotated.
+ */
+class FileLogSink : public LogSink
+{
+public:
+	/**
+	 * Constructor. Opens the file for appending.
+	 *
+	 * @param filename The path of the log file.
+	 * @param maxFileSize The size in bytes at which the file is rotated.
+	 * @param maxFiles The number of rotated files to keep.
+	 */
+	FileLogSink(std::string filename, uint32_t maxFileSize = 10485760, uint32_t maxFiles = 5);
+	virtual ~FileLogSink();
+
+	virtual void write(const LogRecord& record);
+	virtual void flush();
+private:
+	std::string _filename;
+	uint32_t _maxFileSize = 10485760;
+	uint32_t _maxFiles = 5;
+	uint64_t _fileSize = 0;
+
+	/**
+	 * Cleared for files that are not seekable, e. g. FIFOs. They are never rotated.
+	 */
+	bool _rotate = true;
+	std::ofstream _file;
+
+	void open();
+	void rotate();
+};
+
+/**
+ * Writes all records to syslog with the priority matching the record's level.
+ */
+class SyslogLogSink : public LogSink
+{
+public:
+	/**
+	 * Constructor. Calls "openlog".
+	 *
+	 * @param ident The identifier put before all messages.
+	 */
+	SyslogLogSink(std::string ident = "homegear-addon");
+	virtual ~SyslogLogSink();
+
+	virtual void write(const LogRecord& record);
+private:
+	//openlog keeps the pointer, so the string must live as long as the sink.
+	std::string _ident;
+};
+
+}
+#endif
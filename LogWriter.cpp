@@ -0,0 +1,217 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "LogWriter.h"
+#include "LogSinks.h"
+
+namespace HgAddonLib
+{
+LogWriter::LogWriter(uint32_t queueSize) : _dropPolicy(LogDropPolicy::infoAndDebug), _droppedRecords(0), _enqueuePosition(0), _dequeuePosition(0), _stopped(false), _writerWaiting(false)
+{
+	uint64_t size = 2;
+	while(size < queueSize) size <<= 1;
+	_mask = size - 1;
+	_slots.reset(new Slot[size]);
+	for(uint64_t i = 0; i < size; i++) _slots[i].sequence.store(i, std::memory_order_relaxed);
+	_sinks.reset(new std::vector<std::shared_ptr<LogSink>>{ std::shared_ptr<LogSink>(new StdoutLogSink()) });
+	_writerThread = std::thread(&LogWriter::writerThread, this);
+}
+
+LogWriter::~LogWriter()
+{
+	stop();
+}
+
+void LogWriter::stop()
+{
+	{
+		std::lock_guard<std::mutex> wakeGuard(_wakeMutex);
+		_stopThread = true;
+	}
+	_wakeConditionVariable.notify_all();
+	if(_writerThread.joinable()) _writerThread.join();
+	_stopped = true;
+	//Records pushed while the thread was exiting.
+	drain();
+}
+
+void LogWriter::drain()
+{
+	std::lock_guard<std::mutex> sinksGuard(_sinksMutex);
+	LogRecord record;
+	while(tryPop(record)) write(record);
+	std::shared_ptr<const std::vector<std::shared_ptr<LogSink>>> sinks = std::atomic_load(&_sinks);
+	for(std::vector<std::shared_ptr<LogSink>>::const_iterator i = sinks->begin(); i != sinks->end(); ++i) (*i)->flush();
+}
+
+void LogWriter::setSinks(std::vector<std::shared_ptr<LogSink>> sinks)
+{
+	std::shared_ptr<const std::vector<std::shared_ptr<LogSink>>> newSinks(new std::vector<std::shared_ptr<LogSink>>(sinks));
+	//Sinks must not be replaced while being used for synchronous writes.
+	std::lock_guard<std::mutex> sinksGuard(_sinksMutex);
+	std::atomic_store(&_sinks, newSinks);
+}
+
+bool LogWriter::tryPush(LogRecord& record)
+{
+	//Bounded MPMC queue by Dmitry Vyukov. Each slot's sequence tells producers and the consumer whose turn it is.
+	uint64_t position = _enqueuePosition.load(std::memory_order_relaxed);
+	Slot* slot = nullptr;
+	while(true)
+	{
+		slot = &_slots[position & _mask];
+		uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+		int64_t difference = (int64_t)sequence - (int64_t)position;
+		if(difference == 0)
+		{
+			if(_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+		}
+		else if(difference < 0) return false; //Full
+		else position = _enqueuePosition.load(std::memory_order_relaxed);
+	}
+	slot->record = std::move(record);
+	slot->sequence.store(position + 1, std::memory_order_release);
+	return true;
+}
+
+bool LogWriter::tryPop(LogRecord& record)
+{
+	//Only the writer thread (or "stop" after joining it) pops, so the dequeue position doesn't need a CAS.
+	uint64_t position = _dequeuePosition.load(std::memory_order_relaxed);
+	Slot& slot = _slots[position & _mask];
+	uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+	if((int64_t)sequence - (int64_t)(position + 1) < 0) return false;
+	record = std::move(slot.record);
+	slot.sequence.store(position + _mask + 1, std::memory_order_release);
+	_dequeuePosition.store(position + 1, std::memory_order_release);
+	return true;
+}
+
+bool LogWriter::empty()
+{
+	uint64_t position = _dequeuePosition.load(std::memory_order_acquire);
+	return (int64_t)_slots[position & _mask].sequence.load(std::memory_order_acquire) - (int64_t)(position + 1) < 0;
+}
+
+void LogWriter::wakeWriter()
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if(!_writerWaiting.load(std::memory_order_relaxed)) return;
+	std::lock_guard<std::mutex> wakeGuard(_wakeMutex);
+	_wakeConditionVariable.notify_one();
+}
+
+void LogWriter::push(LogRecord& record)
+{
+	if(!tryPush(record))
+	{
+		LogDropPolicy policy = _dropPolicy;
+		//Level "0" is used for messages printed regardless of the debug level, so they are kept like warnings.
+		if(policy == LogDropPolicy::all || (policy == LogDropPolicy::infoAndDebug && record.level > 3))
+		{
+			_droppedRecords++;
+			return;
+		}
+		while(!tryPush(record))
+		{
+			if(_stopped) drain();
+			else wakeWriter();
+			std::this_thread::yield();
+		}
+	}
+	wakeWriter();
+	//Without writer thread the record is written on the calling thread.
+	if(_stopped) drain();
+}
+
+void LogWriter::flush()
+{
+	uint64_t position = _enqueuePosition.load();
+	std::unique_lock<std::mutex> wakeGuard(_wakeMutex);
+	_wakeConditionVariable.notify_one();
+	_flushConditionVariable.wait(wakeGuard, [&]{ return _stopThread || _dequeuePosition.load() >= position; });
+}
+
+void LogWriter::write(const LogRecord& record)
+{
+	std::shared_ptr<const std::vector<std::shared_ptr<LogSink>>> sinks = std::atomic_load(&_sinks);
+	for(std::vector<std::shared_ptr<LogSink>>::const_iterator i = sinks->begin(); i != sinks->end(); ++i)
+	{
+		(*i)->write(record);
+	}
+}
+
+void LogWriter::writerThread()
+{
+	LogRecord record;
+	while(true)
+	{
+		bool written = false;
+		while(tryPop(record))
+		{
+			write(record);
+			written = true;
+		}
+		uint64_t droppedRecords = _droppedRecords;
+		if(droppedRecords != _reportedDroppedRecords)
+		{
+			LogRecord dropRecord;
+			dropRecord.level = 3;
+			dropRecord.message = "Warning: " + std::to_string(droppedRecords - _reportedDroppedRecords) + " log messages were dropped, because the log queue was full.";
+			_reportedDroppedRecords = droppedRecords;
+			write(dropRecord);
+			written = true;
+		}
+		if(written)
+		{
+			std::shared_ptr<const std::vector<std::shared_ptr<LogSink>>> sinks = std::atomic_load(&_sinks);
+			for(std::vector<std::shared_ptr<LogSink>>::const_iterator i = sinks->begin(); i != sinks->end(); ++i) (*i)->flush();
+		}
+
+		std::unique_lock<std::mutex> wakeGuard(_wakeMutex);
+		_flushConditionVariable.notify_all();
+		if(_stopThread && empty()) break;
+		_writerWaiting.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		//Producers check _writerWaiting after pushing, so check the queue again before going to sleep. The timeout is just a safety net.
+		if(!empty() || _stopThread)
+		{
+			_writerWaiting.store(false, std::memory_order_relaxed);
+			continue;
+		}
+		_wakeConditionVariable.wait_for(wakeGuard, std::chrono::milliseconds(100));
+		_writerWaiting.store(false, std::memory_order_relaxed);
+		if(_stopThread) continue;
+		wakeGuard.unlock();
+		//Give producers time to queue more records, so they don't wake us up for every single one.
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+}
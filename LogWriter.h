@@ -0,0 +1,162 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef LOGWRITER_H_
+#define LOGWRITER_H_
+
+#include "LogSink.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace HgAddonLib
+{
+/**
+ * What happens with new log records while the queue of the log writer is full.
+ */
+enum class LogDropPolicy
+{
+	/**
+	 * The calling thread waits until there is space in the queue. No records are lost.
+	 */
+	never,
+
+	/**
+	 * Info and debug records are dropped. Warnings, errors, critical messages and messages printed regardless of the debug level wait
+	 * for space (default).
+	 */
+	infoAndDebug,
+
+	/**
+	 * All records are dropped.
+	 */
+	all
+};
+
+/**
+ * Asynchronous log backend. Threads logging through Output put preformatted records into a bounded lock free multi producer single
+ * consumer ring. One writer thread takes them out and passes them to the sinks, so logging doesn't block the calling thread on I/O.
+ * The number of dropped records is logged as a warning.
+ */
+class LogWriter
+{
+public:
+	/**
+	 * Constructor. Starts the writer thread with a StdoutLogSink.
+	 *
+	 * @param queueSize The number of records the queue can hold. Rounded up to a power of two.
+	 */
+	LogWriter(uint32_t queueSize = 4096);
+
+	/**
+	 * Destructor. Writes all queued records and stops the writer thread.
+	 */
+	virtual ~LogWriter();
+
+	/**
+	 * Replaces all sinks.
+	 *
+	 * @param sinks The new sinks. Records are discarded, when the list is empty.
+	 */
+	void setSinks(std::vector<std::shared_ptr<LogSink>> sinks);
+
+	void setDropPolicy(LogDropPolicy policy) { _dropPolicy = policy; }
+	LogDropPolicy getDropPolicy() { return _dropPolicy; }
+
+	/**
+	 * Returns the number of records dropped since the writer was created.
+	 */
+	uint64_t getDroppedRecords() { return _droppedRecords; }
+
+	/**
+	 * Queues a record for writing. Depending on the drop policy the record is dropped or the method waits, when the queue is full.
+	 *
+	 * @param record The record. It is moved into the queue.
+	 */
+	void push(LogRecord& record);
+
+	/**
+	 * Waits until all records queued so far are written.
+	 */
+	void flush();
+
+	/**
+	 * Stops the writer thread after writing all queued records. Records pushed afterwards are written on the calling thread.
+	 */
+	void stop();
+private:
+	struct Slot
+	{
+		std::atomic<uint64_t> sequence;
+		LogRecord record;
+	};
+
+	std::atomic<LogDropPolicy> _dropPolicy;
+	std::atomic<uint64_t> _droppedRecords;
+	uint64_t _reportedDroppedRecords = 0;
+
+	std::unique_ptr<Slot[]> _slots;
+	uint64_t _mask = 0;
+	std::atomic<uint64_t> _enqueuePosition;
+	std::atomic<uint64_t> _dequeuePosition;
+
+	/**
+	 * Copy on write list of sinks. The writer uses std::atomic_load.
+	 */
+	std::shared_ptr<const std::vector<std::shared_ptr<LogSink>>> _sinks;
+
+	//Used to write synchronously after the writer thread is stopped.
+	std::mutex _sinksMutex;
+	std::atomic<bool> _stopped;
+
+	bool _stopThread = false;
+	std::atomic<bool> _writerWaiting;
+	std::mutex _wakeMutex;
+	std::condition_variable _wakeConditionVariable;
+	std::condition_variable _flushConditionVariable;
+	std::thread _writerThread;
+
+	bool tryPush(LogRecord& record);
+	bool tryPop(LogRecord& record);
+	bool empty();
+	void wakeWriter();
+	void drain();
+	void write(const LogRecord& record);
+	void writerThread();
+
+	LogWriter(const LogWriter&);
+	LogWriter& operator=(const LogWriter&);
+};
+
+}
+#endif
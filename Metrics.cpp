@@ -0,0 +1,219 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "Metrics.h"
+
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <new>
+#include <cstdlib>
+
+namespace HgAddonLib
+{
+MetricCounter::MetricCounter()
+{
+	for(uint32_t i = 0; i < _cellCount; i++) _cells[i].value.store(0, std::memory_order_relaxed);
+}
+
+void* MetricCounter::operator new(size_t size)
+{
+	void* pointer = nullptr;
+	if(posix_memalign(&pointer, alignof(MetricCounter), size) != 0) throw std::bad_alloc();
+	return pointer;
+}
+
+void MetricCounter::operator delete(void* pointer)
+{
+	free(pointer);
+}
+
+uint32_t MetricCounter::getCellIndex()
+{
+	//Threads get their cell round robin on first use, so up to "_cellCount" threads never share one.
+	static std::atomic<uint32_t> nextCellIndex(0);
+	thread_local uint32_t cellIndex = nextCellIndex.fetch_add(1, std::memory_order_relaxed) % _cellCount;
+	return cellIndex;
+}
+
+uint64_t MetricCounter::get() const
+{
+	uint64_t value = 0;
+	for(uint32_t i = 0; i < _cellCount; i++) value += _cells[i].value.load(std::memory_order_relaxed);
+	return value;
+}
+
+MetricHistogram::MetricHistogram() : _count(0), _sum(0), _max(0)
+{
+	for(uint32_t i = 0; i < _bucketCount; i++) _buckets[i].store(0, std::memory_order_relaxed);
+}
+
+uint32_t MetricHistogram::getBucketIndex(int64_t value)
+{
+	if(value < (int64_t)_subBucketCount) return value < 0 ? 0 : value;
+	uint32_t exponent = 63 - __builtin_clzll(value);
+	if(exponent >= _maxValueBits) return _bucketCount - 1;
+	//Bucket group 0 holds the values below _subBucketCount with a width of 1, each further group covers one power of two.
+	uint32_t group = exponent - _subBucketBits + 1;
+	uint32_t subBucket = (value >> (exponent - _subBucketBits)) - _subBucketCount;
+	return group * _subBucketCount + subBucket;
+}
+
+int64_t MetricHistogram::getBucketUpperBound(uint32_t index)
+{
+	uint32_t group = index / _subBucketCount;
+	uint32_t subBucket = index % _subBucketCount;
+	if(group == 0) return subBucket;
+	int64_t width = (int64_t)1 << (group - 1);
+	return ((int64_t)(_subBucketCount + subBucket) << (group - 1)) + width - 1;
+}
+
+void MetricHistogram::record(int64_t value)
+{
+	if(value < 0) value = 0;
+	_buckets[getBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+	_count.fetch_add(1, std::memory_order_relaxed);
+	_sum.fetch_add(value, std::memory_order_relaxed);
+	int64_t max = _max.load(std::memory_order_relaxed);
+	while(value > max && !_max.compare_exchange_weak(max, value, std::memory_order_relaxed));
+}
+
+void MetricHistogram::reset()
+{
+	for(uint32_t i = 0; i < _bucketCount; i++) _buckets[i].store(0, std::memory_order_relaxed);
+	_count.store(0, std::memory_order_relaxed);
+	_sum.store(0, std::memory_order_relaxed);
+	_max.store(0, std::memory_order_relaxed);
+}
+
+double MetricHistogram::getMean() const
+{
+	uint64_t count = getCount();
+	return count == 0 ? 0 : (double)_sum.load(std::memory_order_relaxed) / count;
+}
+
+int64_t MetricHistogram::getPercentile(double percentile) const
+{
+	//The buckets are summed up instead of using _count, so concurrent recording can't make the target unreachable.
+	uint64_t count = 0;
+	for(uint32_t i = 0; i < _bucketCount; i++) count += _buckets[i].load(std::memory_order_relaxed);
+	if(count == 0) return 0;
+	uint64_t target = std::ceil(std::min(std::max(percentile, 0.0), 100.0) / 100.0 * count);
+	if(target == 0) target = 1;
+	uint64_t cumulativeCount = 0;
+	for(uint32_t i = 0; i < _bucketCount; i++)
+	{
+		cumulativeCount += _buckets[i].load(std::memory_order_relaxed);
+		if(cumulativeCount >= target) return std::min(getBucketUpperBound(i), getMax());
+	}
+	return getMax();
+}
+
+Metrics::Metrics()
+{
+	clientInvokes = getCounter("client.invokes");
+	clientErrors = getCounter("client.errors");
+	clientRetries = getCounter("client.retries");
+	clientInvokeTime = getHistogram("client.invokeTime");
+	clientEncodeTime = getHistogram("client.encodeTime");
+	clientDecodeTime = getHistogram("client.decodeTime");
+	clientLockWaitTime = getHistogram("client.lockWaitTime");
+
+	serverRequests = getCounter("server.requests");
+	serverConnections = getCounter("server.connections");
+	serverInits = getCounter("server.inits");
+	serverConnected = getGauge("server.connected");
+	serverDecodeTime = getHistogram("server.decodeTime");
+	serverDecodeErrors = getCounter("server.decodeErrors");
+	serverDispatchTime = getHistogram("server.dispatchTime");
+	serverEncodeTime = getHistogram("server.encodeTime");
+
+	socketConnects = getCounter("socket.connects");
+	socketConnectErrors = getCounter("socket.connectErrors");
+	socketReadTimeouts = getCounter("socket.readTimeouts");
+	socketWriteTimeouts = getCounter("socket.writeTimeouts");
+	socketBytesRead = getCounter("socket.bytesRead");
+	socketBytesWritten = getCounter("socket.bytesWritten");
+}
+
+std::shared_ptr<MetricCounter> Metrics::getCounter(const std::string& name)
+{
+	std::lock_guard<std::mutex> metricsGuard(_metricsMutex);
+	std::shared_ptr<MetricCounter>& counter = _counters[name];
+	if(!counter) counter.reset(new MetricCounter());
+	return counter;
+}
+
+std::shared_ptr<MetricGauge> Metrics::getGauge(const std::string& name)
+{
+	std::lock_guard<std::mutex> metricsGuard(_metricsMutex);
+	std::shared_ptr<MetricGauge>& gauge = _gauges[name];
+	if(!gauge) gauge.reset(new MetricGauge());
+	return gauge;
+}
+
+std::shared_ptr<MetricHistogram> Metrics::getHistogram(const std::string& name)
+{
+	std::lock_guard<std::mutex> metricsGuard(_metricsMutex);
+	std::shared_ptr<MetricHistogram>& histogram = _histograms[name];
+	if(!histogram) histogram.reset(new MetricHistogram());
+	return histogram;
+}
+
+PVariable Metrics::getSnapshot()
+{
+	//RPC integers have 32 bits, larger values are passed as float.
+	auto toVariable = [](int64_t value) { return (value >= std::numeric_limits<int32_t>::min() && value <= std::numeric_limits<int32_t>::max()) ? PVariable(new Variable((int32_t)value)) : PVariable(new Variable((double)value)); };
+
+	PVariable snapshot(new Variable(VariableType::rpcStruct));
+	std::lock_guard<std::mutex> metricsGuard(_metricsMutex);
+	for(std::map<std::string, std::shared_ptr<MetricCounter>>::iterator i = _counters.begin(); i != _counters.end(); ++i)
+	{
+		snapshot->structValue->insert(RPCStructElement(i->first, toVariable(i->second->get())));
+	}
+	for(std::map<std::string, std::shared_ptr<MetricGauge>>::iterator i = _gauges.begin(); i != _gauges.end(); ++i)
+	{
+		snapshot->structValue->insert(RPCStructElement(i->first, toVariable(i->second->get())));
+	}
+	for(std::map<std::string, std::shared_ptr<MetricHistogram>>::iterator i = _histograms.begin(); i != _histograms.end(); ++i)
+	{
+		PVariable histogram(new Variable(VariableType::rpcStruct));
+		histogram->structValue->insert(RPCStructElement("count", toVariable(i->second->getCount())));
+		histogram->structValue->insert(RPCStructElement("mean", PVariable(new Variable(i->second->getMean() / 1000.0))));
+		histogram->structValue->insert(RPCStructElement("p50", PVariable(new Variable(i->second->getPercentile(50) / 1000.0))));
+		histogram->structValue->insert(RPCStructElement("p90", PVariable(new Variable(i->second->getPercentile(90) / 1000.0))));
+		histogram->structValue->insert(RPCStructElement("p99", PVariable(new Variable(i->second->getPercentile(99) / 1000.0))));
+		histogram->structValue->insert(RPCStructElement("p999", PVariable(new Variable(i->second->getPercentile(99.9) / 1000.0))));
+		histogram->structValue->insert(RPCStructElement("max", PVariable(new Variable(i->second->getMax() / 1000.0))));
+		snapshot->structValue->insert(RPCStructElement(i->first, histogram));
+	}
+	return snapshot;
+}
+
+}
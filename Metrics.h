@@ -0,0 +1,212 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include "Variable.h"
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <chrono>
+
+namespace HgAddonLib
+{
+/**
+ * A monotonically increasing counter. The value is split into cells, each thread increments its own cell, so threads counting the same
+ * event don't compete for one cache line. Reading sums up all cells.
+ */
+class MetricCounter
+{
+public:
+	MetricCounter();
+	virtual ~MetricCounter() {}
+
+	/**
+	 * Before C++17 "new" ignores alignments larger than the one of std::max_align_t, so counters are allocated with posix_memalign to
+	 * keep each cell on its own cache line.
+	 */
+	static void* operator new(size_t size);
+	static void operator delete(void* pointer);
+
+	void increment(uint64_t value = 1) { _cells[getCellIndex()].value.fetch_add(value, std::memory_order_relaxed); }
+	uint64_t get() const;
+private:
+	static const uint32_t _cellCount = 16;
+
+	struct alignas(64) Cell
+	{
+		std::atomic<uint64_t> value;
+	};
+
+	Cell _cells[_cellCount];
+
+	static uint32_t getCellIndex();
+};
+
+/**
+ * A value that can go up and down, e. g. the connection state or a queue size.
+ */
+class MetricGauge
+{
+public:
+	MetricGauge() : _value(0) {}
+	virtual ~MetricGauge() {}
+
+	void set(int64_t value) { _value.store(value, std::memory_order_relaxed); }
+	void add(int64_t value) { _value.fetch_add(value, std::memory_order_relaxed); }
+	int64_t get() const { return _value.load(std::memory_order_relaxed); }
+private:
+	std::atomic<int64_t> _value;
+};
+
+/**
+ * A latency histogram in the style of HdrHistogram. Values are sorted into buckets with a logarithmic scale, each power of two is split
+ * into 16 linear sub buckets, so every value is stored with a relative error below 6.25 %. Values are recorded in nanoseconds up to about
+ * 68 seconds, larger values are counted in the last bucket. Recording is lock free.
+ */
+class MetricHistogram
+{
+public:
+	MetricHistogram();
+	virtual ~MetricHistogram() {}
+
+	/**
+	 * Returns the current time of a monotonic clock in nanoseconds. Pass the difference of two calls to "record".
+	 */
+	static int64_t now() { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+	/**
+	 * Records one value.
+	 *
+	 * @param value The value in nanoseconds.
+	 */
+	void record(int64_t value);
+
+	/**
+	 * Records the time passed since "startTime".
+	 *
+	 * @param startTime A time returned by "now".
+	 */
+	void recordSince(int64_t startTime) { record(now() - startTime); }
+
+	uint64_t getCount() const { return _count.load(std::memory_order_relaxed); }
+	int64_t getMax() const { return _max.load(std::memory_order_relaxed); }
+	double getMean() const;
+
+	/**
+	 * Returns the value below or at which "percentile" percent of all recorded values are.
+	 *
+	 * @param percentile The percentile between 0 and 100.
+	 * @return Returns the upper bound of the bucket containing the percentile in nanoseconds.
+	 */
+	int64_t getPercentile(double percentile) const;
+
+	/**
+	 * Removes all recorded values, e. g. after the warm up of a benchmark. Values recorded concurrently may be partially kept.
+	 */
+	void reset();
+private:
+	static const uint32_t _subBucketBits = 4;
+	static const uint32_t _subBucketCount = 1 << _subBucketBits;
+	static const uint32_t _maxValueBits = 36;
+	static const uint32_t _bucketCount = (_maxValueBits - _subBucketBits + 1) * _subBucketCount;
+
+	std::atomic<uint64_t> _buckets[_bucketCount];
+	std::atomic<uint64_t> _count;
+	std::atomic<int64_t> _sum;
+	std::atomic<int64_t> _max;
+
+	static uint32_t getBucketIndex(int64_t value);
+	static int64_t getBucketUpperBound(uint32_t index);
+};
+
+/**
+ * The metrics registry of a library context. It holds the metrics the library records about itself and metrics added by the addon. Metrics
+ * are created on first request and exist as long as the context. Hold on to the returned pointer instead of requesting the metric for
+ * every update.
+ *
+ * Histograms are recorded in nanoseconds and reported in microseconds.
+ */
+class Metrics
+{
+public:
+	Metrics();
+	virtual ~Metrics() {}
+
+	std::shared_ptr<MetricCounter> getCounter(const std::string& name);
+	std::shared_ptr<MetricGauge> getGauge(const std::string& name);
+	std::shared_ptr<MetricHistogram> getHistogram(const std::string& name);
+
+	/**
+	 * Returns the current values of all metrics as a struct with the metric names as keys. Counters and gauges are integers (floats when
+	 * they exceed the 32 bit range of RPC integers), histograms are structs with the elements "count", "mean", "p50", "p90", "p99", "p999"
+	 * and "max" in microseconds.
+	 */
+	PVariable getSnapshot();
+
+	//The metrics recorded by the library. They are created by the constructor.
+	std::shared_ptr<MetricCounter> clientInvokes;
+	std::shared_ptr<MetricCounter> clientErrors;
+	std::shared_ptr<MetricCounter> clientRetries;
+	std::shared_ptr<MetricHistogram> clientInvokeTime;
+	std::shared_ptr<MetricHistogram> clientEncodeTime;
+	std::shared_ptr<MetricHistogram> clientDecodeTime;
+	std::shared_ptr<MetricHistogram> clientLockWaitTime;
+
+	std::shared_ptr<MetricCounter> serverRequests;
+	std::shared_ptr<MetricCounter> serverConnections;
+	std::shared_ptr<MetricCounter> serverInits;
+	std::shared_ptr<MetricGauge> serverConnected;
+	std::shared_ptr<MetricHistogram> serverDecodeTime;
+	std::shared_ptr<MetricCounter> serverDecodeErrors;
+	std::shared_ptr<MetricHistogram> serverDispatchTime;
+	std::shared_ptr<MetricHistogram> serverEncodeTime;
+
+	std::shared_ptr<MetricCounter> socketConnects;
+	std::shared_ptr<MetricCounter> socketConnectErrors;
+	std::shared_ptr<MetricCounter> socketReadTimeouts;
+	std::shared_ptr<MetricCounter> socketWriteTimeouts;
+	std::shared_ptr<MetricCounter> socketBytesRead;
+	std::shared_ptr<MetricCounter> socketBytesWritten;
+private:
+	std::mutex _metricsMutex;
+	std::map<std::string, std::shared_ptr<MetricCounter>> _counters;
+	std::map<std::string, std::shared_ptr<MetricGauge>> _gauges;
+	std::map<std::string, std::shared_ptr<MetricHistogram>> _histograms;
+
+	Metrics(const Metrics&);
+	Metrics& operator=(const Metrics&);
+};
+
+}
+#endif
@@ -28,7 +28,7 @@
  */
 
 #include "Output.h"
-#include "GD.h"
+#include "SharedObjects.h"
 
 namespace HgAddonLib
 {
@@ -38,27 +38,76 @@ Output::~Output()
 
 }
 
-std::string Output::getTimeString(int64_t time)
+const int32_t Output::_defaultDebugLevel = 3;
+
+void Output::init(SharedObjects* bl)
+{
+	_bl = bl;
+	_debugLevel = bl ? &bl->debugLevel : &_defaultDebugLevel;
+}
+
+int32_t Output::getDebugLevel()
 {
-	const char timeFormat[] = "%x %X";
-	std::time_t t;
-	int32_t milliseconds;
-	if(time > 0)
+	return *_debugLevel;
+}
+
+void Output::print(int32_t level, std::string message, bool printTime)
+{
+	LogRecord record;
+	record.level = level;
+	if(printTime) record.time = getLogTimeString();
+	record.message.swap(message);
+	if(_bl)
 	{
-		t = std::time_t(time / 1000);
-		milliseconds = time % 1000;
+		if(level == 1 || level == 2) _bl->flightRecorder.errorOccurred();
+		_bl->logWriter.push(record);
+		return;
 	}
-	else
+	//Without library context there is no log writer, so write directly.
+	if(printTime) std::cout << record.time << " ";
+	std::cout << record.message << std::endl;
+	if(level < 1 || level > 3) return;
+	if(printTime) std::cerr << record.time << " ";
+	std::cerr << record.message << std::endl;
+}
+
+std::string Output::getTimeString(int64_t time)
+{
+	//strftime and localtime are slow, so every thread keeps the date and time of the last second it formatted.
+	thread_local int64_t cachedSecond = -1;
+	thread_local char timeString[64];
+	thread_local uint32_t prefixLength = 0;
+
+	if(time <= 0) time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	int64_t second = time / 1000;
+	int32_t milliseconds = time % 1000;
+	if(second != cachedSecond)
 	{
-		const auto timePoint = std::chrono::system_clock::now();
-		t = std::chrono::system_clock::to_time_t(timePoint);
-		milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(timePoint.time_since_epoch()).count() % 1000;
+		std::time_t t = (std::time_t)second;
+		std::tm localTime;
+		localtime_r(&t, &localTime);
+		prefixLength = strftime(&timeString[0], sizeof(timeString) - 4, "%x %X", &localTime);
+		timeString[prefixLength] = '.';
+		cachedSecond = second;
 	}
-	char timeString[50];
-	strftime(&timeString[0], 50, &timeFormat[0], std::localtime(&t));
-	std::ostringstream timeStream;
-	timeStream << timeString << "." << std::setw(3) << std::setfill('0') << milliseconds;
-	return timeStream.str();
+	timeString[prefixLength + 1] = '0' + milliseconds / 100;
+	timeString[prefixLength + 2] = '0' + (milliseconds / 10) % 10;
+	timeString[prefixLength + 3] = '0' + milliseconds % 10;
+	return std::string(&timeString[0], prefixLength + 4);
+}
+
+std::string Output::getLogTimeString()
+{
+	if(!_bl || _bl->logTimeMode.load(std::memory_order_relaxed) == LogTimeMode::wallClock) return getTimeString();
+
+	int64_t time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _bl->startTime).count();
+	int32_t milliseconds = time % 1000;
+	std::string timeString = std::to_string(time / 1000);
+	timeString.push_back('.');
+	timeString.push_back('0' + milliseconds / 100);
+	timeString.push_back('0' + (milliseconds / 10) % 10);
+	timeString.push_back('0' + milliseconds % 10);
+	return timeString;
 }
 
 void Output::printThreadPriority()
@@ -97,7 +146,7 @@ void Output::printBinary(std::vector<unsigned char>& data)
 			stringstream << std::setw(2) << (int32_t)((uint8_t)(*i));
 		}
 		stringstream << std::dec;
-		std::cout << stringstream.str() << std::endl;
+		print(0, stringstream.str(), false);
 	}
 	catch(const std::exception& ex)
     {
@@ -125,7 +174,7 @@ void Output::printBinary(std::shared_ptr<std::vector<char>> data)
 			stringstream << std::setw(2) << (int32_t)((uint8_t)(*i));
 		}
 		stringstream << std::dec;
-		std::cout << stringstream.str() << std::endl;
+		print(0, stringstream.str(), false);
 	}
 	catch(const std::exception& ex)
     {
@@ -153,7 +202,7 @@ void Output::printBinary(std::vector<char>& data)
 			stringstream << std::setw(2) << (int32_t)((uint8_t)(*i));
 		}
 		stringstream << std::dec;
-		std::cout << stringstream.str() << std::endl;
+		print(0, stringstream.str(), false);
 	}
 	catch(const std::exception& ex)
     {
@@ -171,61 +220,44 @@ void Output::printBinary(std::vector<char>& data)
 
 void Output::printEx(std::string file, uint32_t line, std::string function, std::string what)
 {
-	std::string error;
-	if(!what.empty())
-	{
-		error = _prefix + "Error in file " + file + " line " + std::to_string(line) + " in function " + function + ": " + what;
-		std::cout << getTimeString() << " " << error << std::endl;
-		std::cerr << getTimeString() << " " << error << std::endl;
-	}
-	else
-	{
-		error = _prefix + "Unknown error in file " + file + " line " + std::to_string(line) + " in function " + function + ".";
-		std::cout << getTimeString() << " " << error << std::endl;
-		std::cerr << getTimeString() << " " << error << std::endl;
-	}
+	if(!what.empty()) print(2, _prefix + "Error in file " + file + " line " + std::to_string(line) + " in function " + function + ": " + what);
+	else print(2, _prefix + "Unknown error in file " + file + " line " + std::to_string(line) + " in function " + function + ".");
 }
 
 void Output::printCritical(std::string errorString, bool errorCallback)
 {
-	if(GD::debugLevel < 1) return;
-	std::string error = _prefix + errorString;
-	std::cout << getTimeString() << " " << error << std::endl;
-	std::cerr << getTimeString() << " " << error << std::endl;
+	if(getDebugLevel() < 1) return;
+	print(1, _prefix + errorString);
 }
 
 void Output::printError(std::string errorString)
 {
-	if(GD::debugLevel < 2) return;
-	std::string error = _prefix + errorString;
-	std::cout << getTimeString() << " " << error << std::endl;
-	std::cerr << getTimeString() << " " << error << std::endl;
+	if(getDebugLevel() < 2) return;
+	print(2, _prefix + errorString);
 }
 
 void Output::printWarning(std::string errorString)
 {
-	if(GD::debugLevel < 3) return;
-	std::string error = _prefix + errorString;
-	std::cout << getTimeString() << " " << error << std::endl;
-	std::cerr << getTimeString() << " " << error << std::endl;
+	if(getDebugLevel() < 3) return;
+	print(3, _prefix + errorString);
 }
 
 void Output::printInfo(std::string message)
 {
-	if(GD::debugLevel < 4) return;
-	std::cout << getTimeString() << " " << _prefix << message << std::endl;
+	if(getDebugLevel() < 4) return;
+	print(4, _prefix + message);
 }
 
 void Output::printDebug(std::string message, int32_t minDebugLevel)
 {
-	if(GD::debugLevel < minDebugLevel) return;
-	std::cout << getTimeString() << " " << _prefix << message << std::endl;
+	if(getDebugLevel() < minDebugLevel) return;
+	print(5, _prefix + message);
 }
 
 void Output::printMessage(std::string message, int32_t minDebugLevel)
 {
-	if(GD::debugLevel < minDebugLevel) return;
-	std::cout << getTimeString() << " " << _prefix << message << std::endl;
+	if(getDebugLevel() < minDebugLevel) return;
+	print(0, _prefix + message);
 }
 
 }
@@ -31,6 +31,7 @@
 #define OUTPUT_H_
 
 #include "Exception.h"
+#include "LogSink.h"
 
 #include <iostream>
 #include <iomanip>
@@ -43,11 +44,55 @@
 #include <ctime>
 #include <functional>
 
+/**
+ * Messages with a higher level than this are removed at compile time when they are printed with the HGADDON_PRINT macros. Possible values:
+ * 0 (none), 1 (critical), 2 (error), 3 (warning), 4 (info), 5 (debug) and higher for more verbose debug messages.
+ */
+#ifndef HGADDON_MAX_PRINT_LEVEL
+#define HGADDON_MAX_PRINT_LEVEL 10
+#endif
+
+/**
+ * Evaluates to true, when messages of the level are printed by the Output object. Use it to guard code only needed for output.
+ */
+#define HGADDON_PRINT_ENABLED(out, level) ((level) <= HGADDON_MAX_PRINT_LEVEL && (out).isEnabled(level))
+
+/**
+ * Level checked versions of the print methods of Output. The message expression is only evaluated when the message is printed, so
+ * disabled messages only cost one branch and no string is built. E. g.: HGADDON_PRINT_INFO(_out, "Info: Calling method " + methodName);
+ */
+#define HGADDON_PRINT_CRITICAL(out, message) do { if(HGADDON_PRINT_ENABLED(out, 1)) (out).printCritical(message); } while(0)
+#define HGADDON_PRINT_ERROR(out, message) do { if(HGADDON_PRINT_ENABLED(out, 2)) (out).printError(message); } while(0)
+#define HGADDON_PRINT_WARNING(out, message) do { if(HGADDON_PRINT_ENABLED(out, 3)) (out).printWarning(message); } while(0)
+#define HGADDON_PRINT_INFO(out, message) do { if(HGADDON_PRINT_ENABLED(out, 4)) (out).printInfo(message); } while(0)
+#define HGADDON_PRINT_DEBUG(out, message) do { if(HGADDON_PRINT_ENABLED(out, 5)) (out).printDebug(message); } while(0)
+#define HGADDON_PRINT_DEBUG_LEVEL(out, message, minDebugLevel) do { if(HGADDON_PRINT_ENABLED(out, minDebugLevel)) (out).printDebug(message, minDebugLevel); } while(0)
+
 namespace HgAddonLib
 {
+class SharedObjects;
+
+/**
+ * Selects the clock used for the time prefix of log messages.
+ */
+enum class LogTimeMode
+{
+	/**
+	 * The local date and time like "08/27/14 14:13:53.471" (default).
+	 */
+	wallClock,
+
+	/**
+	 * The seconds since the library context was created like "123.471". The time is taken from a monotonic clock, so it isn't affected
+	 * by changes of the system time.
+	 */
+	monotonic
+};
+
 /**
  * Class to print output of different kinds to the standard and error output.
- * The output is automatically prefixed with the date and filtered according to the current debug level.
+ * The output is automatically prefixed with the date and filtered according to the current debug level. With a library context the
+ * messages are passed to its log writer and written asynchronously.
  */
 class Output
 {
@@ -71,6 +116,20 @@ public:
 	 */
 	std::string getPrefix() { return _prefix; }
 
+	/**
+	 * Sets the library context, whose debug level is used to filter the output. Without a context only warnings, errors and
+	 * critical messages are printed.
+	 * @param bl The library context.
+	 */
+	void init(SharedObjects* bl);
+
+	/**
+	 * Returns true when messages of the provided level are printed.
+	 *
+	 * @param level The level of the message: 1 (critical), 2 (error), 3 (warning), 4 (info), 5 (debug)
+	 */
+	bool isEnabled(int32_t level) { return *_debugLevel >= level; }
+
 	/**
 	 * Sets a string, which will be used to prefix all output.
 	 * @see getPrefix()
@@ -84,11 +143,19 @@ public:
 	void printThreadPriority();
 
 	/**
-	 * Returns a time string like "08/27/14 14:13:53.471".
+	 * Returns a time string like "08/27/14 14:13:53.471". The date and time part is formatted at most once per second and thread, only
+	 * the milliseconds are updated for every call.
+	 * @param time The unix time in milliseconds or "0" for the current time.
 	 * @return Returns a time string like "08/27/14 14:13:53.471".
 	 */
 	std::string getTimeString(int64_t time = 0);
 
+	/**
+	 * Returns the time prefix of log messages according to the log time mode of the library context.
+	 * @see LogTimeMode
+	 */
+	std::string getLogTimeString();
+
 	/**
 	 * Prints the provided binary data as a hexadecimal string.
 	 *
@@ -199,10 +266,35 @@ public:
 	 * Calls the error callback function registered with the constructor.
 	 */
 private:
+	/**
+	 * The library context or nullptr.
+	 */
+	SharedObjects* _bl = nullptr;
+
+	/**
+	 * Points to the debug level of the library context or to _defaultDebugLevel, so the level check doesn't need the context.
+	 */
+	const int32_t* _debugLevel = &_defaultDebugLevel;
+	static const int32_t _defaultDebugLevel;
+
 	/**
 	 * A prefix put before all messages.
 	 */
 	std::string _prefix;
+
+	/**
+	 * Returns the debug level of the library context or "3" when no context is set.
+	 */
+	int32_t getDebugLevel();
+
+	/**
+	 * Passes a message to the log writer of the library context or prints it directly when no context is set.
+	 *
+	 * @param level The level of the message. See LogRecord.
+	 * @param message The message including the prefix.
+	 * @param printTime Set to false to print the message without time.
+	 */
+	void print(int32_t level, std::string message, bool printTime = true);
 };
 }
 #endif
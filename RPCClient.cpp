@@ -28,28 +28,31 @@
  */
 
 #include "RPCClient.h"
-#include "GD.h"
+#include "SharedObjects.h"
 
 namespace HgAddonLib
 {
 
-RPCClient::RPCClient()
+RPCClient::RPCClient(SharedObjects* bl) : _socket(bl), _interruptDescriptor(bl), _rpcDecoder(bl), _rpcEncoder(bl), _xmlRpcDecoder(bl), _xmlRpcEncoder(bl)
 {
+	_bl = bl;
+
 	try
 	{
 		signal(SIGPIPE, SIG_IGN);
+		_socket.setInterruptDescriptor(_interruptDescriptor.descriptor());
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
 }
 
@@ -61,15 +64,15 @@ RPCClient::~RPCClient()
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
 }
 
@@ -78,41 +81,108 @@ void RPCClient::setPort(int32_t port)
 	_port = port;
 }
 
+void RPCClient::reset()
+{
+	try
+	{
+		_interruptDescriptor.set();
+		std::lock_guard<std::mutex> sendGuard(_sendMutex);
+		_interruptDescriptor.reset();
+		_socket.close();
+	}
+	catch(const std::exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+}
+
 PVariable RPCClient::invoke(std::string methodName, PRPCList parameters)
 {
 	try
 	{
 		if(methodName.empty()) return Variable::createError(-32601, "Method name is empty");
-		GD::out.printInfo("Info: Calling XML RPC method \"" + methodName + "\".");
-		if(GD::debugLevel >= 5 && parameters)
+		HGADDON_TRACE_SPAN_DETAIL(_bl->tracer, "invoke", methodName.data(), methodName.size());
+		int64_t invokeStartTime = MetricHistogram::now();
+		_bl->metrics.clientInvokes->increment();
+		HGADDON_PRINT_INFO(_bl->out, "Info: Calling XML RPC method \"" + methodName + "\".");
+		if(HGADDON_PRINT_ENABLED(_bl->out, 5) && parameters)
 		{
-			GD::out.printDebug("Parameters:");
+			_bl->out.printDebug("Parameters:");
 			for(RPCList::iterator i = parameters->begin(); i != parameters->end(); ++i)
 			{
 				(*i)->print();
 			}
 		}
 		bool retry = false;
-		std::vector<char> requestData;
+		std::vector<char> requestData = _bl->bufferPool.get(1024);
 		std::vector<char> responseData;
-		_rpcEncoder.encodeRequest(methodName, parameters, requestData);
+		bool encoded = true;
+		int64_t startTime = MetricHistogram::now();
+		{
+			HGADDON_TRACE_SPAN(_bl->tracer, "encodeRequest");
+			if(_protocol == RPCProtocol::xmlRpc) encoded = _xmlRpcEncoder.encodeRequest(methodName, parameters, requestData);
+			else _rpcEncoder.encodeRequest(methodName, parameters, requestData);
+		}
+		_bl->metrics.clientEncodeTime->recordSince(startTime);
+		if(!encoded)
+		{
+			_bl->bufferPool.put(requestData);
+			_bl->metrics.clientErrors->increment();
+			_bl->out.printError("Error: Parameters of \"" + methodName + "\" contain values XML-RPC can't represent (control characters, NaN or infinity).");
+			return Variable::createError(-32602, "Parameters can't be encoded as XML-RPC.");
+		}
 		for(uint32_t i = 0; i < 3; ++i)
 		{
+			HGADDON_TRACE_SPAN(_bl->tracer, "sendRequest");
 			retry = false;
+			if(i > 0) _bl->metrics.clientRetries->increment();
 			if(i == 0) sendRequest(requestData, responseData, true, retry);
 			else sendRequest(requestData, responseData, false, retry);
 			if(!retry) break;
 		}
-		if(retry) return Variable::createError(-32300, "Request timed out.");
-		if(responseData.empty()) return Variable::createError(-32700, "No response data.");
+		_bl->bufferPool.put(requestData);
+		if(retry || responseData.empty())
+		{
+			_bl->metrics.clientErrors->increment();
+			_bl->metrics.clientInvokeTime->recordSince(invokeStartTime);
+			if(retry) return Variable::createError(-32300, "Request timed out.");
+			return Variable::createError(-32700, "No response data.");
+		}
 		PVariable returnValue;
-		returnValue = _rpcDecoder.decodeResponse(responseData);
-		if(returnValue->errorStruct) GD::out.printError("Error in RPC response: faultCode: " + std::to_string(returnValue->structValue->at("faultCode")->integerValue) + " faultString: " + returnValue->structValue->at("faultString")->stringValue);
+		DecodeStatus status = DecodeStatus::ok;
+		startTime = MetricHistogram::now();
+		{
+			HGADDON_TRACE_SPAN(_bl->tracer, "decodeResponse");
+			if(XMLRPCDecoder::isResponse(responseData.data(), responseData.size())) status = _xmlRpcDecoder.decodeResponse(responseData, returnValue);
+			else status = _rpcDecoder.decodeResponse(responseData.data(), responseData.size(), returnValue);
+		}
+		_bl->metrics.clientDecodeTime->recordSince(startTime);
+		_bl->bufferPool.put(responseData);
+		_bl->metrics.clientInvokeTime->recordSince(invokeStartTime);
+		if(status != DecodeStatus::ok)
+		{
+			_bl->metrics.clientErrors->increment();
+			_bl->out.printError("Error: Could not decode RPC response: " + RPCDecoder::getStatusString(status));
+			return Variable::createError(-32700, "Could not decode response: " + RPCDecoder::getStatusString(status));
+		}
+		if(returnValue->errorStruct)
+		{
+			_bl->metrics.clientErrors->increment();
+			_bl->out.printError("Error in RPC response: faultCode: " + std::to_string(returnValue->structValue->at("faultCode")->integerValue) + " faultString: " + returnValue->structValue->at("faultString")->stringValue);
+		}
 		else
 		{
-			if(GD::debugLevel >= 5)
+			if(HGADDON_PRINT_ENABLED(_bl->out, 5))
 			{
-				GD::out.printDebug("Response was:");
+				_bl->out.printDebug("Response was:");
 				returnValue->print();
 			}
 		}
@@ -120,22 +190,25 @@ PVariable RPCClient::invoke(std::string methodName, PRPCList parameters)
 	}
     catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
     return Variable::createError(-32700, "No response data.");
 }
 
 void RPCClient::sendRequest(std::vector<char>& data, std::vector<char>& responseData, bool insertHeader, bool& retry)
 {
+	//All requests share one connection, so concurrent invokes wait here for each other.
+	int64_t lockStartTime = MetricHistogram::now();
 	_sendMutex.lock();
+	_bl->metrics.clientLockWaitTime->recordSince(lockStartTime);
 	try
 	{
 		try
@@ -147,14 +220,21 @@ void RPCClient::sendRequest(std::vector<char>& data, std::vector<char>& response
 				_socket.open();
 			}
 		}
+		catch(const SocketInterruptedException& ex)
+		{
+			HGADDON_PRINT_INFO(_bl->out, "Info: Connecting to Homegear was interrupted.");
+			_sendMutex.unlock();
+			return;
+		}
 		catch(const SocketOperationException& ex)
 		{
-			GD::out.printError(ex.what());
+			_bl->out.printError(ex.what());
 			_sendMutex.unlock();
 			return;
 		}
 
-		if(GD::debugLevel >= 5) GD::out.printDebug("Sending packet: " + GD::hf.getHexString(data));
+		_bl->flightRecorder.record(FlightRecorder::Direction::clientRequest, data.data(), data.size());
+		HGADDON_PRINT_DEBUG(_bl->out, "Sending packet: " + _bl->hf.getHexString(data));
 
 		try
 		{
@@ -162,14 +242,21 @@ void RPCClient::sendRequest(std::vector<char>& data, std::vector<char>& response
 		}
 		catch(SocketDataLimitException& ex)
 		{
-			GD::out.printWarning("Warning: " + ex.what());
+			_bl->out.printWarning("Warning: " + ex.what());
+			_socket.close();
+			_sendMutex.unlock();
+			return;
+		}
+		catch(const SocketInterruptedException& ex)
+		{
+			HGADDON_PRINT_INFO(_bl->out, "Info: Sending data to Homegear was interrupted.");
 			_socket.close();
 			_sendMutex.unlock();
 			return;
 		}
 		catch(const SocketOperationException& ex)
 		{
-			GD::out.printError("Error: Could not send data to Homegear: " + ex.what() + ".");
+			_bl->out.printError("Error: Could not send data to Homegear: " + ex.what() + ".");
 			retry = true;
 			_socket.close();
 			_sendMutex.unlock();
@@ -183,6 +270,7 @@ void RPCClient::sendRequest(std::vector<char>& data, std::vector<char>& response
 		char buffer[bufferMax + 1];
 		uint32_t packetLength = 0;
 		uint32_t dataSize = 0;
+		bool httpResponse = false;
 
 		while(true) //This is equal to while(true) for binary packets
 		{
@@ -195,21 +283,29 @@ void RPCClient::sendRequest(std::vector<char>& data, std::vector<char>& response
 			}
 			catch(const SocketTimeOutException& ex)
 			{
-				GD::out.printInfo("Info: Reading from Homegear timed out.");
+				HGADDON_PRINT_INFO(_bl->out, "Info: Reading from Homegear timed out.");
 				retry = true;
 				_sendMutex.unlock();
 				return;
 			}
+			catch(const SocketInterruptedException& ex)
+			{
+				//The response of an interrupted request must not be read by the next request.
+				HGADDON_PRINT_INFO(_bl->out, "Info: Waiting for Homegear's response was interrupted.");
+				_socket.close();
+				_sendMutex.unlock();
+				return;
+			}
 			catch(const SocketClosedException& ex)
 			{
-				GD::out.printWarning("Warning: " + ex.what());
+				_bl->out.printWarning("Warning: " + ex.what());
 				retry = true;
 				_sendMutex.unlock();
 				return;
 			}
 			catch(const SocketOperationException& ex)
 			{
-				GD::out.printError(ex.what());
+				_bl->out.printError(ex.what());
 				retry = true;
 				_sendMutex.unlock();
 				return;
@@ -218,43 +314,68 @@ void RPCClient::sendRequest(std::vector<char>& data, std::vector<char>& response
 			//they don't do something in the memory after buffer, we add '\0'
 			buffer[receivedBytes] = '\0';
 
-			if(dataSize == 0)
+			if(httpResponse || (dataSize == 0 && XMLRPCDecoder::isResponse(buffer, receivedBytes)))
+			{
+				//XML-RPC response. It is complete, when the header and "Content-Length" bytes of body are received.
+				httpResponse = true;
+				responseData.insert(responseData.end(), buffer, buffer + receivedBytes);
+				uint32_t headerSize = 0;
+				uint32_t contentLength = 0;
+				DecodeStatus status = XMLRPCDecoder::getMessageSize(responseData.data(), responseData.size(), headerSize, contentLength);
+				if(status == DecodeStatus::truncated && responseData.size() <= 8192) continue;
+				if(status != DecodeStatus::ok || contentLength > 10485760 || responseData.size() > headerSize + contentLength)
+				{
+					_bl->out.printError("Error: RPC client received invalid HTTP response from Homegear.");
+					_socket.close();
+					_sendMutex.unlock();
+					return;
+				}
+				if(responseData.size() < headerSize + contentLength) continue;
+				break;
+			}
+			else if(dataSize == 0)
 			{
 				if(!(buffer[3] & 1) && buffer[3] != 0xFF)
 				{
 					responseData.insert(responseData.end(), buffer, buffer + receivedBytes);
-					GD::out.printError("Error: RPC client received binary request as response from Homegear. Packet was: " + GD::hf.getHexString(responseData));
+					_bl->out.printError("Error: RPC client received binary request as response from Homegear. Packet was: " + _bl->hf.getHexString(responseData));
 					_sendMutex.unlock();
 					return;
 				}
 				if(receivedBytes < 8)
 				{
-					GD::out.printError("Error: RPC client received binary packet smaller than 8 bytes from Homegear.");
+					_bl->out.printError("Error: RPC client received binary packet smaller than 8 bytes from Homegear.");
 					_sendMutex.unlock();
 					return;
 				}
-				GD::hf.memcpyBigEndian((char*)&dataSize, buffer + 4, 4);
-				GD::out.printDebug("RPC client receiving binary rpc packet with size: " + std::to_string(receivedBytes) + ". Payload size is: " + std::to_string(dataSize));
+				_bl->hf.memcpyBigEndian((char*)&dataSize, buffer + 4, 4);
+				HGADDON_PRINT_DEBUG(_bl->out, "RPC client receiving binary rpc packet with size: " + std::to_string(receivedBytes) + ". Payload size is: " + std::to_string(dataSize));
 				if(dataSize == 0)
 				{
-					GD::out.printError("Error: RPC client received binary packet without data from Homegear.");
+					_bl->out.printError("Error: RPC client received binary packet without data from Homegear.");
 					_sendMutex.unlock();
 					return;
 				}
 				if(dataSize > 10485760)
 				{
-					GD::out.printError("Error: RPC client received packet with data larger than 10 MiB.");
+					_bl->out.printError("Error: RPC client received packet with data larger than 10 MiB.");
 					_sendMutex.unlock();
 					return;
 				}
 				packetLength = receivedBytes - 8;
+				if(responseData.capacity() < dataSize + 9)
+				{
+					//Size the buffer once for the whole packet.
+					_bl->bufferPool.put(responseData);
+					responseData = _bl->bufferPool.get(dataSize + 9);
+				}
 				responseData.insert(responseData.end(), buffer, buffer + receivedBytes);
 			}
 			else
 			{
 				if(packetLength + receivedBytes > dataSize)
 				{
-					GD::out.printError("Error: RPC client received response packet larger than the expected data size.");
+					_bl->out.printError("Error: RPC client received response packet larger than the expected data size.");
 					_sendMutex.unlock();
 					return;
 				}
@@ -267,21 +388,22 @@ void RPCClient::sendRequest(std::vector<char>& data, std::vector<char>& response
 				break;
 			}
 		}
-		if(GD::debugLevel >= 5) GD::out.printDebug("Debug: Received packet from Homegear: " + GD::hf.getHexString(responseData));
+		_bl->flightRecorder.record(FlightRecorder::Direction::clientResponse, responseData.data(), httpResponse ? responseData.size() : dataSize + 8);
+		HGADDON_PRINT_DEBUG(_bl->out, "Debug: Received packet from Homegear: " + _bl->hf.getHexString(responseData));
 		_sendMutex.unlock();
 		return;
     }
     catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
     _socket.shutdown();
     _sendMutex.unlock();
@@ -34,6 +34,9 @@
 #include "SocketOperations.h"
 #include "Encoding/RPCDecoder.h"
 #include "Encoding/RPCEncoder.h"
+#include "Encoding/XMLRPCDecoder.h"
+#include "Encoding/XMLRPCEncoder.h"
+#include "Base.h"
 
 #include <iostream>
 #include <string>
@@ -43,6 +46,7 @@
 #include <list>
 #include <mutex>
 #include <map>
+#include <atomic>
 
 #include <unistd.h>
 #include <cstring>
@@ -55,24 +59,40 @@
 
 namespace HgAddonLib
 {
+class SharedObjects;
+
 class RPCClient
 {
 public:
-	RPCClient();
+	RPCClient(SharedObjects* bl);
 	virtual ~RPCClient();
 
 	void setPort(int32_t port);
+
+	/**
+	 * Sets the protocol used for requests.
+	 */
+	void setProtocol(RPCProtocol protocol) { _protocol = protocol; }
 	PVariable invoke(std::string methodName, PRPCList parameters);
 
+	/**
+	 * Aborts the request currently waiting for Homegear (if any) and closes the connection. Returns when the request has been aborted.
+	 * Later requests are not affected.
+	 */
 	void reset();
 protected:
+	SharedObjects* _bl = nullptr;
 	std::mutex _sendMutex;
 	int32_t _port = -1;
 	int32_t _socketDescriptor = -1;
 	SocketOperations _socket;
+	InterruptDescriptor _interruptDescriptor;
 
 	RPCDecoder _rpcDecoder;
 	RPCEncoder _rpcEncoder;
+	std::atomic<RPCProtocol> _protocol{RPCProtocol::binary};
+	XMLRPCDecoder _xmlRpcDecoder;
+	XMLRPCEncoder _xmlRpcEncoder;
 
 	void sendRequest(std::vector<char>& data, std::vector<char>& responseData, bool insertHeader, bool& retry);
 };
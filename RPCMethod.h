@@ -31,12 +31,14 @@
 #define RPCMETHOD_H_
 
 #include "Variable.h"
+#include "Output.h"
 
 #include <vector>
 #include <memory>
 
 namespace HgAddonLib
 {
+class SharedObjects;
 
 class RPCMethod
 {
@@ -47,6 +49,13 @@ public:
 	};
 
 	RPCMethod() {}
+
+	/**
+	 * Constructor used by methods that need the library context of the Base instance they belong to.
+	 *
+	 * @param bl The library context.
+	 */
+	RPCMethod(SharedObjects* bl) { _bl = bl; _out.init(bl); }
 	virtual ~RPCMethod() {}
 
 	ParameterError::Enum checkParameters(PRPCArray parameters, std::vector<VariableType> types);
@@ -56,6 +65,8 @@ public:
 	PVariable getSignature() { return _signatures; }
 	PVariable getHelp() { return _help; }
 protected:
+	SharedObjects* _bl = nullptr;
+	Output _out;
 	PVariable _signatures;
 	PVariable _help;
 
@@ -0,0 +1,103 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "RPCMethodTable.h"
+
+#include <cstring>
+
+namespace HgAddonLib
+{
+PVariable RPCMethodTable::Entry::invoke(PRPCArray parameters) const
+{
+	if(!callTime) return method->invoke(parameters);
+	int64_t startTime = MetricHistogram::now();
+	PVariable result = method->invoke(parameters);
+	callTime->recordSince(startTime);
+	return result;
+}
+
+RPCMethodTable::RPCMethodTable(const std::map<std::string, std::shared_ptr<RPCMethod>>& methods, Metrics* metrics)
+{
+	_entries.reserve(methods.size());
+	for(std::map<std::string, std::shared_ptr<RPCMethod>>::const_iterator i = methods.begin(); i != methods.end(); ++i)
+	{
+		if(!i->second) continue;
+		Entry entry;
+		entry.name = i->first;
+		entry.hash = getHash(i->first.data(), i->first.size());
+		entry.method = i->second;
+		if(metrics) entry.callTime = metrics->getHistogram("server.methods." + i->first + ".callTime");
+		_entries.push_back(entry);
+	}
+
+	//Keep the load factor at or below 0.5, so probe sequences stay short.
+	uint32_t slotCount = 8;
+	while(slotCount < _entries.size() * 2) slotCount <<= 1;
+	_slots.resize(slotCount, 0);
+	_mask = slotCount - 1;
+	for(uint32_t i = 0; i < _entries.size(); i++)
+	{
+		uint32_t slot = _entries[i].hash & _mask;
+		while(_slots[slot] != 0) slot = (slot + 1) & _mask;
+		_slots[slot] = i + 1;
+	}
+}
+
+uint32_t RPCMethodTable::getHash(const char* name, uint32_t size)
+{
+	//32 bit FNV-1a
+	uint32_t hash = 2166136261u;
+	for(uint32_t i = 0; i < size; i++)
+	{
+		hash ^= (uint8_t)name[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+RPCMethod* RPCMethodTable::find(const char* name, uint32_t size) const
+{
+	const Entry* entry = findEntry(name, size);
+	return entry ? entry->method.get() : nullptr;
+}
+
+const RPCMethodTable::Entry* RPCMethodTable::findEntry(const char* name, uint32_t size) const
+{
+	if(!name && size > 0) return nullptr;
+	uint32_t hash = getHash(name, size);
+	uint32_t slot = hash & _mask;
+	while(_slots[slot] != 0)
+	{
+		const Entry& entry = _entries[_slots[slot] - 1];
+		if(entry.hash == hash && entry.name.size() == size && (size == 0 || memcmp(entry.name.data(), name, size) == 0)) return &entry;
+		slot = (slot + 1) & _mask;
+	}
+	return nullptr;
+}
+}
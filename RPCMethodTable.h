@@ -0,0 +1,128 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef RPCMETHODTABLE_H_
+#define RPCMETHODTABLE_H_
+
+#include "RPCMethod.h"
+#include "Metrics.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+
+namespace HgAddonLib
+{
+/**
+ * Immutable hash table mapping RPC method names to their implementation. Lookups work directly on the method name bytes, so no string
+ * needs to be constructed when dispatching a decoded packet. To change the registered methods, a new table is created.
+ */
+class RPCMethodTable
+{
+public:
+	struct Entry
+	{
+		std::string name;
+		uint32_t hash = 0;
+		std::shared_ptr<RPCMethod> method;
+
+		/**
+		 * The execution times of the method. Only set when the table was created with a metrics registry.
+		 */
+		std::shared_ptr<MetricHistogram> callTime;
+
+		/**
+		 * Calls the method and records its execution time.
+		 */
+		PVariable invoke(PRPCArray parameters) const;
+	};
+
+	RPCMethodTable() : RPCMethodTable(std::map<std::string, std::shared_ptr<RPCMethod>>()) {}
+
+	/**
+	 * Constructor.
+	 *
+	 * @param methods The methods to put into the table.
+	 * @param metrics When set, the execution time of every method is recorded in the histogram "server.methods.METHODNAME.callTime".
+	 */
+	RPCMethodTable(const std::map<std::string, std::shared_ptr<RPCMethod>>& methods, Metrics* metrics = nullptr);
+	virtual ~RPCMethodTable() {}
+
+	/**
+	 * Searches for a method.
+	 *
+	 * @param name Pointer to the method name. Doesn't need to be null terminated.
+	 * @param size The length of the method name.
+	 * @return Returns the method or nullptr when the method is not registered. The pointer is valid as long as the table exists.
+	 */
+	RPCMethod* find(const char* name, uint32_t size) const;
+
+	/**
+	 * Searches for the entry of a method.
+	 *
+	 * @param name Pointer to the method name. Doesn't need to be null terminated.
+	 * @param size The length of the method name.
+	 * @return Returns the entry or nullptr when the method is not registered. The pointer is valid as long as the table exists.
+	 */
+	const Entry* findEntry(const char* name, uint32_t size) const;
+
+	/**
+	 * Searches for the entry of a method.
+	 *
+	 * @param name The method name.
+	 * @return Returns the entry or nullptr when the method is not registered. The pointer is valid as long as the table exists.
+	 */
+	const Entry* findEntry(const std::string& name) const { return findEntry(name.data(), name.size()); }
+
+	/**
+	 * Searches for a method.
+	 *
+	 * @param name The method name.
+	 * @return Returns the method or nullptr when the method is not registered. The pointer is valid as long as the table exists.
+	 */
+	RPCMethod* find(const std::string& name) const { return find(name.data(), name.size()); }
+
+	/**
+	 * Returns all entries sorted by method name.
+	 */
+	const std::vector<Entry>& getEntries() const { return _entries; }
+
+	static uint32_t getHash(const char* name, uint32_t size);
+private:
+	std::vector<Entry> _entries;
+
+	/**
+	 * Open addressing slots with linear probing. Each slot stores the index of the entry in _entries plus one, 0 marks an empty slot.
+	 */
+	std::vector<uint32_t> _slots;
+	uint32_t _mask = 0;
+};
+}
+#endif
@@ -28,11 +28,34 @@
  */
 
 #include "RPCMethods.h"
-#include "GD.h"
+#include "SharedObjects.h"
 
 namespace HgAddonLib
 {
 
+PVariable RPCSystemGetMetrics::invoke(PRPCArray parameters)
+{
+	try
+	{
+		if(!parameters->empty()) return getError(ParameterError::Enum::wrongCount);
+
+		return _bl->metrics.getSnapshot();
+	}
+	catch(const std::exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+    return Variable::createError(-32500, "Unknown application error.");
+}
+
 PVariable RPCSystemListMethods::invoke(PRPCArray parameters)
 {
 	try
@@ -41,24 +64,25 @@ PVariable RPCSystemListMethods::invoke(PRPCArray parameters)
 
 		PVariable methods(new Variable(VariableType::rpcArray));
 
-		for(std::map<std::string, std::unique_ptr<RPCMethod>>::iterator i = GD::rpcServer.getMethods()->begin(); i != GD::rpcServer.getMethods()->end(); ++i)
+		std::shared_ptr<const RPCMethodTable> methodTable = _bl->rpcServer.getMethods();
+		for(std::vector<RPCMethodTable::Entry>::const_iterator i = methodTable->getEntries().begin(); i != methodTable->getEntries().end(); ++i)
 		{
-			methods->arrayValue->push_back(PVariable(new Variable(i->first)));
+			methods->arrayValue->push_back(PVariable(new Variable(i->name)));
 		}
 
 		return methods;
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
     return Variable::createError(-32500, "Unknown application error.");
 }
@@ -70,12 +94,11 @@ PVariable RPCSystemMethodHelp::invoke(PRPCArray parameters)
 		ParameterError::Enum error = checkParameters(parameters, std::vector<VariableType>({ VariableType::rpcString }));
 		if(error != ParameterError::Enum::noError) return getError(error);
 
-		if(GD::rpcServer.getMethods()->find(parameters->at(0)->stringValue) == GD::rpcServer.getMethods()->end())
-		{
-			return Variable::createError(-32602, "Method not found.");
-		}
+		std::shared_ptr<const RPCMethodTable> methods = _bl->rpcServer.getMethods();
+		RPCMethod* method = methods->find(parameters->at(0)->stringValue);
+		if(!method) return Variable::createError(-32602, "Method not found.");
 
-		PVariable help = GD::rpcServer.getMethods()->at(parameters->at(0)->stringValue)->getHelp();
+		PVariable help = method->getHelp();
 
 		if(!help) help.reset(new Variable(VariableType::rpcString));
 
@@ -83,15 +106,15 @@ PVariable RPCSystemMethodHelp::invoke(PRPCArray parameters)
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
     return Variable::createError(-32500, "Unknown application error.");
 }
@@ -103,12 +126,11 @@ PVariable RPCSystemMethodSignature::invoke(PRPCArray parameters)
 		ParameterError::Enum error = checkParameters(parameters, std::vector<VariableType>({ VariableType::rpcString }));
 		if(error != ParameterError::Enum::noError) return getError(error);
 
-		if(GD::rpcServer.getMethods()->find(parameters->at(0)->stringValue) == GD::rpcServer.getMethods()->end())
-		{
-			return Variable::createError(-32602, "Method not found.");
-		}
+		std::shared_ptr<const RPCMethodTable> methods = _bl->rpcServer.getMethods();
+		RPCMethod* method = methods->find(parameters->at(0)->stringValue);
+		if(!method) return Variable::createError(-32602, "Method not found.");
 
-		PVariable signature = GD::rpcServer.getMethods()->at(parameters->at(0)->stringValue)->getSignature();
+		PVariable signature = method->getSignature();
 
 		if(!signature) signature.reset(new Variable(VariableType::rpcArray));
 
@@ -122,19 +144,28 @@ PVariable RPCSystemMethodSignature::invoke(PRPCArray parameters)
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
     return Variable::createError(-32500, "Unknown application error.");
 }
 
+bool RPCSystemMulticall::getPeerId(std::string& methodName, PRPCArray& parameters, uint64_t& peerId)
+{
+	//Only methods which are known to have the peer id as their second parameter are ordered by peer.
+	if(methodName != "event" && methodName != "updateDevice") return false;
+	if(parameters->size() < 2 || parameters->at(1)->type != VariableType::rpcInteger) return false;
+	peerId = (uint32_t)parameters->at(1)->integerValue;
+	return true;
+}
+
 PVariable RPCSystemMulticall::invoke(PRPCArray parameters)
 {
 	try
@@ -142,51 +173,176 @@ PVariable RPCSystemMulticall::invoke(PRPCArray parameters)
 		ParameterError::Enum error = checkParameters(parameters, std::vector<VariableType>({ VariableType::rpcArray }));
 		if(error != ParameterError::Enum::noError) return getError(error);
 
-		std::map<std::string, std::unique_ptr<RPCMethod>>* methods = GD::rpcServer.getMethods();
+		std::shared_ptr<const RPCMethodTable> methods = _bl->rpcServer.getMethods();
 		PVariable returns(new Variable(VariableType::rpcArray));
-		for(RPCArray::iterator i = parameters->at(0)->arrayValue->begin(); i != parameters->at(0)->arrayValue->end(); ++i)
+		returns->arrayValue->resize(parameters->at(0)->arrayValue->size());
+
+		//Entries which need to be executed. The index is the position of the result in "returns".
+		std::vector<std::pair<uint32_t, const RPCMethodTable::Entry*>> calls;
+		std::vector<PRPCArray> callParameters;
+		std::vector<std::string> callMethodNames;
+		uint32_t index = 0;
+		for(RPCArray::iterator i = parameters->at(0)->arrayValue->begin(); i != parameters->at(0)->arrayValue->end(); ++i, ++index)
 		{
 			if((*i)->type != VariableType::rpcStruct)
 			{
-				returns->arrayValue->push_back(Variable::createError(-32602, "Array element is no struct."));
+				returns->arrayValue->at(index) = Variable::createError(-32602, "Array element is no struct.");
 				continue;
 			}
 			if((*i)->structValue->size() != 2)
 			{
-				returns->arrayValue->push_back(Variable::createError(-32602, "Struct has wrong size."));
+				returns->arrayValue->at(index) = Variable::createError(-32602, "Struct has wrong size.");
 				continue;
 			}
 			if((*i)->structValue->find("methodName") == (*i)->structValue->end() || (*i)->structValue->at("methodName")->type != VariableType::rpcString)
 			{
-				returns->arrayValue->push_back(Variable::createError(-32602, "No method name provided."));
+				returns->arrayValue->at(index) = Variable::createError(-32602, "No method name provided.");
 				continue;
 			}
 			if((*i)->structValue->find("params") == (*i)->structValue->end() || (*i)->structValue->at("params")->type != VariableType::rpcArray)
 			{
-				returns->arrayValue->push_back(Variable::createError(-32602, "No parameters provided."));
+				returns->arrayValue->at(index) = Variable::createError(-32602, "No parameters provided.");
 				continue;
 			}
 			std::string methodName = (*i)->structValue->at("methodName")->stringValue;
 			PRPCArray parameters = (*i)->structValue->at("params")->arrayValue;
 
-			if(methodName == "system.multicall") returns->arrayValue->push_back(Variable::createError(-32602, "Recursive calls to system.multicall are not allowed."));
-			else if(methods->find(methodName) == methods->end()) returns->arrayValue->push_back(Variable::createError(-32601, "Requested method not found."));
-			else returns->arrayValue->push_back(methods->at(methodName)->invoke(parameters));
+			const RPCMethodTable::Entry* method = nullptr;
+			if(methodName == "system.multicall") returns->arrayValue->at(index) = Variable::createError(-32602, "Recursive calls to system.multicall are not allowed.");
+			else if(!(method = methods->findEntry(methodName))) returns->arrayValue->at(index) = Variable::createError(-32601, "Requested method not found.");
+			else
+			{
+				calls.push_back(std::pair<uint32_t, const RPCMethodTable::Entry*>(index, method));
+				callParameters.push_back(parameters);
+				callMethodNames.push_back(methodName);
+			}
+		}
+
+		std::shared_ptr<ThreadPool> threadPool;
+		MulticallMode mode = _bl->rpcServer.getMulticallMode(threadPool);
+		if(mode == MulticallMode::sequential || !threadPool || calls.size() < 2)
+		{
+			for(uint32_t i = 0; i < calls.size(); i++)
+			{
+				returns->arrayValue->at(calls[i].first) = calls[i].second->invoke(callParameters[i]);
+			}
+			return returns;
+		}
+
+		//Each group is executed sequentially by one task. With "peerOrdered" all entries for one peer and all entries without a
+		//peer are put into the same group, with "unordered" every entry gets its own group.
+		std::vector<std::vector<uint32_t>> groups;
+		if(mode == MulticallMode::peerOrdered)
+		{
+			std::map<uint64_t, uint32_t> peerGroups;
+			int32_t unorderedGroup = -1;
+			for(uint32_t i = 0; i < calls.size(); i++)
+			{
+				uint64_t peerId = 0;
+				if(getPeerId(callMethodNames[i], callParameters[i], peerId))
+				{
+					std::map<uint64_t, uint32_t>::iterator peerGroup = peerGroups.find(peerId);
+					if(peerGroup == peerGroups.end())
+					{
+						peerGroups[peerId] = groups.size();
+						groups.push_back(std::vector<uint32_t>{ i });
+					}
+					else groups.at(peerGroup->second).push_back(i);
+				}
+				else
+				{
+					if(unorderedGroup == -1)
+					{
+						unorderedGroup = groups.size();
+						groups.push_back(std::vector<uint32_t>());
+					}
+					groups.at(unorderedGroup).push_back(i);
+				}
+			}
+		}
+		else
+		{
+			groups.reserve(calls.size());
+			for(uint32_t i = 0; i < calls.size(); i++) groups.push_back(std::vector<uint32_t>{ i });
+		}
+
+		std::vector<std::future<void>> futures;
+		futures.reserve(groups.size());
+		for(std::vector<std::vector<uint32_t>>::iterator i = groups.begin(); i != groups.end(); ++i)
+		{
+			std::vector<uint32_t>* group = &(*i);
+			futures.push_back(threadPool->enqueue([&, group]()
+			{
+				for(std::vector<uint32_t>::iterator j = group->begin(); j != group->end(); ++j)
+				{
+					//Every task only writes to its own elements, so no locking is needed.
+					returns->arrayValue->at(calls[*j].first) = calls[*j].second->invoke(callParameters[*j]);
+				}
+			}));
+		}
+		//All tasks reference local variables, so we need to wait for every single one of them.
+		for(std::vector<std::future<void>>::iterator i = futures.begin(); i != futures.end(); ++i)
+		{
+			try
+			{
+				i->get();
+			}
+			catch(const std::exception& ex)
+			{
+				_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+			}
+			catch(Exception& ex)
+			{
+				_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+			}
+			catch(...)
+			{
+				_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+			}
+		}
+		for(RPCArray::iterator i = returns->arrayValue->begin(); i != returns->arrayValue->end(); ++i)
+		{
+			if(!*i) *i = Variable::createError(-32500, "Unknown application error.");
 		}
 
 		return returns;
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+    return Variable::createError(-32500, "Unknown application error.");
+}
+
+PVariable RPCUserFunction::invoke(PRPCArray parameters)
+{
+	try
+	{
+		if(!_function) return PVariable(new Variable());
+		HGADDON_TRACE_SPAN(_bl->tracer, "callback");
+		PVariable result = _function(parameters);
+		if(!result) result.reset(new Variable());
+		return result;
+	}
+	catch(const std::exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
     return Variable::createError(-32500, "Unknown application error.");
 }
@@ -198,25 +354,25 @@ PVariable RPCDeleteDevices::invoke(PRPCArray parameters)
 		ParameterError::Enum error = checkParameters(parameters, std::vector<VariableType>({ VariableType::rpcString, VariableType::rpcArray }));
 		if(error != ParameterError::Enum::noError) return getError(error);
 
-		if(!_base) return PVariable(new Variable());
-
 		for(RPCArray::iterator i = parameters->at(1)->arrayValue->begin(); i != parameters->at(1)->arrayValue->end(); ++i)
 		{
-			if((*i)->structValue->find("ID") != (*i)->structValue->end()) _base->deleteDevice((*i)->structValue->at("ID")->integerValue);
+			if((*i)->structValue->find("ID") == (*i)->structValue->end()) continue;
+			uint64_t peerId = (*i)->structValue->at("ID")->integerValue;
+			_bl->rpcServer.callBases(peerId, CallbackMonitor::CallbackType::deleteDevice, [&](Base* base) { base->deleteDevice(peerId); });
 		}
 		return PVariable(new Variable());
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
     return Variable::createError(-32500, "Unknown application error.");
 }
@@ -228,21 +384,21 @@ PVariable RPCError::invoke(PRPCArray parameters)
 		ParameterError::Enum error = checkParameters(parameters, std::vector<VariableType>({ VariableType::rpcString, VariableType::rpcInteger, VariableType::rpcString }));
 		if(error != ParameterError::Enum::noError) return getError(error);
 
-		if(_base) _base->error(parameters->at(1)->integerValue, parameters->at(2)->stringValue);
+		_bl->rpcServer.callAllBases(0, CallbackMonitor::CallbackType::error, [&](Base* base) { base->error(parameters->at(1)->integerValue, parameters->at(2)->stringValue); });
 
 		return PVariable(new Variable());
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
     return Variable::createError(-32500, "Unknown application error.");
 }
@@ -254,21 +410,22 @@ PVariable RPCEvent::invoke(PRPCArray parameters)
 		ParameterError::Enum error = checkParameters(parameters, std::vector<VariableType>({ VariableType::rpcString, VariableType::rpcInteger, VariableType::rpcInteger, VariableType::rpcString, VariableType::rpcVariant }));
 		if(error != ParameterError::Enum::noError) return getError(error);
 
-		if(_base) _base->event(parameters->at(1)->integerValue, parameters->at(2)->integerValue, parameters->at(3)->stringValue, parameters->at(4));
+		//The event is decoded once and passed to all instances subscribed to the peer.
+		_bl->rpcServer.callBases(parameters->at(1)->integerValue, CallbackMonitor::CallbackType::event, [&](Base* base) { base->event(parameters->at(1)->integerValue, parameters->at(2)->integerValue, parameters->at(3)->stringValue, parameters->at(4)); });
 
 		return PVariable(new Variable());
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
     return Variable::createError(-32500, "Unknown application error.");
 }
@@ -280,25 +437,26 @@ PVariable RPCNewDevices::invoke(PRPCArray parameters)
 		ParameterError::Enum error = checkParameters(parameters, std::vector<VariableType>({ VariableType::rpcString, VariableType::rpcArray }));
 		if(error != ParameterError::Enum::noError) return getError(error);
 
-		if(!_base) return PVariable(new Variable());
-
 		for(RPCArray::iterator i = parameters->at(1)->arrayValue->begin(); i != parameters->at(1)->arrayValue->end(); ++i)
 		{
-			if((*i)->structValue->find("ID") != (*i)->structValue->end()) _base->newDevice((*i)->structValue->at("ID")->integerValue);
+			if((*i)->structValue->find("ID") == (*i)->structValue->end()) continue;
+			//Nobody can be subscribed to a new peer yet, so all instances are informed.
+			uint64_t peerId = (*i)->structValue->at("ID")->integerValue;
+			_bl->rpcServer.callAllBases(peerId, CallbackMonitor::CallbackType::newDevice, [&](Base* base) { base->newDevice(peerId); });
 		}
 		return PVariable(new Variable());
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
     return Variable::createError(-32500, "Unknown application error.");
 }
@@ -310,21 +468,21 @@ PVariable RPCUpdateDevice::invoke(PRPCArray parameters)
 		ParameterError::Enum error = checkParameters(parameters, std::vector<VariableType>({ VariableType::rpcString, VariableType::rpcInteger, VariableType::rpcInteger, VariableType::rpcInteger }));
 		if(error != ParameterError::Enum::noError) return getError(error);
 
-		if(_base) _base->updateDevice(parameters->at(1)->integerValue, parameters->at(2)->integerValue, parameters->at(3)->integerValue);
+		_bl->rpcServer.callBases(parameters->at(1)->integerValue, CallbackMonitor::CallbackType::updateDevice, [&](Base* base) { base->updateDevice(parameters->at(1)->integerValue, parameters->at(2)->integerValue, parameters->at(3)->integerValue); });
 
 		return PVariable(new Variable());
 	}
 	catch(const std::exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(Exception& ex)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
     }
     catch(...)
     {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
     return Variable::createError(-32500, "Unknown application error.");
 }
@@ -36,16 +36,28 @@
 
 #include <vector>
 #include <memory>
+#include <functional>
 #include <cstdlib>
 
 namespace HgAddonLib
 {
-class Base;
+class SharedObjects;
+
+class RPCSystemGetMetrics : public RPCMethod
+{
+public:
+	RPCSystemGetMetrics(SharedObjects* bl) : RPCMethod(bl)
+	{
+		setHelp("Returns the metrics of the addon library. See Metrics::getSnapshot() for a description of the values.");
+		addSignature(VariableType::rpcStruct, std::vector<VariableType>());
+	}
+	PVariable invoke(PRPCArray parameters);
+};
 
 class RPCSystemListMethods : public RPCMethod
 {
 public:
-	RPCSystemListMethods()
+	RPCSystemListMethods(SharedObjects* bl) : RPCMethod(bl)
 	{
 		setHelp("Lists all XML RPC methods.");
 		addSignature(VariableType::rpcArray, std::vector<VariableType>());
@@ -56,7 +68,7 @@ public:
 class RPCSystemMethodHelp : public RPCMethod
 {
 public:
-	RPCSystemMethodHelp()
+	RPCSystemMethodHelp(SharedObjects* bl) : RPCMethod(bl)
 	{
 		setHelp("Returns a description of the method.");
 		addSignature(VariableType::rpcString, std::vector<VariableType>{VariableType::rpcString});
@@ -67,7 +79,7 @@ public:
 class RPCSystemMethodSignature : public RPCMethod
 {
 public:
-	RPCSystemMethodSignature()
+	RPCSystemMethodSignature(SharedObjects* bl) : RPCMethod(bl)
 	{
 		setHelp("Returns the method's signature.");
 		addSignature(VariableType::rpcArray, std::vector<VariableType>{VariableType::rpcString});
@@ -78,77 +90,76 @@ public:
 class RPCSystemMulticall : public RPCMethod
 {
 public:
-	RPCSystemMulticall()
+	RPCSystemMulticall(SharedObjects* bl) : RPCMethod(bl)
 	{
 		setHelp("Calls multiple XML RPC methods.");
 		addSignature(VariableType::rpcArray, std::vector<VariableType>{VariableType::rpcArray});
 	}
 	PVariable invoke(PRPCArray parameters);
+protected:
+	bool getPeerId(std::string& methodName, PRPCArray& parameters, uint64_t& peerId);
+};
+
+class RPCUserFunction : public RPCMethod
+{
+public:
+	RPCUserFunction(SharedObjects* bl, std::function<PVariable(PRPCArray parameters)> function) : RPCMethod(bl)
+	{
+		_function = function;
+	}
+	PVariable invoke(PRPCArray parameters);
+protected:
+	std::function<PVariable(PRPCArray parameters)> _function;
 };
 
 class RPCDeleteDevices : public RPCMethod
 {
 public:
-	RPCDeleteDevices(Base* base)
+	RPCDeleteDevices(SharedObjects* bl) : RPCMethod(bl)
 	{
-		_base = base;
 		addSignature(VariableType::rpcArray, std::vector<VariableType>{VariableType::rpcString, VariableType::rpcArray});
 	}
 	PVariable invoke(PRPCArray parameters);
-protected:
-	Base* _base = nullptr;
 };
 
 class RPCError : public RPCMethod
 {
 public:
-	RPCError(Base* base)
+	RPCError(SharedObjects* bl) : RPCMethod(bl)
 	{
-		_base = base;
 		addSignature(VariableType::rpcArray, std::vector<VariableType>{VariableType::rpcString, VariableType::rpcInteger, VariableType::rpcString});
 	}
 	PVariable invoke(PRPCArray parameters);
-protected:
-	Base* _base = nullptr;
 };
 
 class RPCEvent : public RPCMethod
 {
 public:
-	RPCEvent(Base* base)
+	RPCEvent(SharedObjects* bl) : RPCMethod(bl)
 	{
-		_base = base;
 		addSignature(VariableType::rpcVoid, std::vector<VariableType>{VariableType::rpcString, VariableType::rpcInteger, VariableType::rpcInteger, VariableType::rpcString, VariableType::rpcVariant});
 	}
 	PVariable invoke(PRPCArray parameters);
-protected:
-	Base* _base = nullptr;
 };
 
 class RPCNewDevices : public RPCMethod
 {
 public:
-	RPCNewDevices(Base* base)
+	RPCNewDevices(SharedObjects* bl) : RPCMethod(bl)
 	{
-		_base = base;
 		addSignature(VariableType::rpcArray, std::vector<VariableType>{VariableType::rpcString, VariableType::rpcArray});
 	}
 	PVariable invoke(PRPCArray parameters);
-protected:
-	Base* _base = nullptr;
 };
 
 class RPCUpdateDevice : public RPCMethod
 {
 public:
-	RPCUpdateDevice(Base* base)
+	RPCUpdateDevice(SharedObjects* bl) : RPCMethod(bl)
 	{
-		_base = base;
 		addSignature(VariableType::rpcArray, std::vector<VariableType>{VariableType::rpcString, VariableType::rpcInteger, VariableType::rpcInteger, VariableType::rpcInteger});
 	}
 	PVariable invoke(PRPCArray parameters);
-protected:
-	Base* _base = nullptr;
 };
 }
 #endif
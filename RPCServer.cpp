@@ -28,14 +28,22 @@
  */
 
 #include "RPCServer.h"
-#include "GD.h"
+#include "SharedObjects.h"
 #include "RPCMethods.h"
 
 namespace HgAddonLib
 {
-RPCServer::RPCServer()
+thread_local std::vector<Base*> RPCServer::_callingBases;
+
+RPCServer::RPCServer(SharedObjects* bl) : _stopDescriptor(bl), _rpcDecoder(bl), _rpcEncoder(bl), _xmlRpcDecoder(bl), _xmlRpcEncoder(bl)
 {
+	_bl = bl;
+	_out.init(bl);
 	_out.setPrefix("RPC Server: ");
+	_rpcMethods.reset(new RPCMethodTable());
+	_subscribedPeers.reset(new std::set<uint64_t>());
+	_bases.reset(new std::vector<Base*>());
+	_peerIndex.reset(new std::map<uint64_t, std::vector<Base*>>());
 }
 
 RPCServer::~RPCServer()
@@ -43,30 +51,49 @@ RPCServer::~RPCServer()
 	stop();
 }
 
-void RPCServer::start(Base* base, uint64_t myPeerId)
+void RPCServer::start()
 {
 	try
 	{
-		if(myPeerId == 0)
+		stop();
 		{
-			GD::out.printCritical("Critical: Could not start. myPeerId is \"0\".");
-			return;
+			//No delta is needed, the full list is sent by "sendInit".
+			std::lock_guard<std::mutex> subscribedPeersGuard(_subscribedPeersMutex);
+			_peersToSubscribe.clear();
+			_peersToUnsubscribe.clear();
+			_stopMaintenanceThread = false;
+			_initDue = false;
+			_keepAliveDue = false;
+			_subscriptionsDue = false;
+			_initRetryDelay = _minInitRetryDelay;
 		}
-		_myPeerId = myPeerId;
-		if(_myPeerId != 0) _subscribedPeers.insert(_myPeerId);
-		stop();
 		_stopServer = false;
-		registerMethods(base);
+		_stopDescriptor.reset();
+		registerMethods();
 		getSocketDescriptor();
 		_mainThread = std::thread(&RPCServer::mainThread, this);
-		std::string id = GD::rpcServer.getId();
+		_maintenanceThread = std::thread(&RPCServer::maintenanceThread, this);
+		std::string id = getId();
 		if(id.empty())
 		{
-			GD::out.printCritical("Critical: Could not get server id. Aborting start.");
+			_bl->out.printCritical("Critical: Could not get server id. Aborting start.");
 			stop();
 			return;
 		}
-		sendInit();
+		_keepAliveTimer = _bl->timers.add(_keepAliveInterval, [this]
+		{
+			{
+				std::lock_guard<std::mutex> subscribedPeersGuard(_subscribedPeersMutex);
+				_keepAliveDue = true;
+			}
+			_maintenanceConditionVariable.notify_all();
+		}, _keepAliveInterval);
+		{
+			//The handshake runs on the maintenance thread, so start doesn't depend on Homegear being available.
+			std::lock_guard<std::mutex> subscribedPeersGuard(_subscribedPeersMutex);
+			_initDue = true;
+		}
+		_maintenanceConditionVariable.notify_all();
 	}
 	catch(const std::exception& ex)
     {
@@ -86,9 +113,418 @@ void RPCServer::stop()
 {
 	try
 	{
-		_stopServer = true;
-		if(_mainThread.joinable()) _mainThread.join();
-		_rpcMethods.clear();
+		std::vector<uint64_t> timers;
+		{
+			std::lock_guard<std::mutex> subscribedPeersGuard(_subscribedPeersMutex);
+			_stopServer = true;
+			_stopMaintenanceThread = true;
+			timers = std::vector<uint64_t>{ _keepAliveTimer, _initTimer, _subscriptionTimer };
+			_keepAliveTimer = 0;
+			_initTimer = 0;
+			_subscriptionTimer = 0;
+		}
+		{
+			//Makes sure, waitForConnection sees _stopServer.
+			std::lock_guard<std::mutex> connectedGuard(_connectedMutex);
+		}
+		_connectedConditionVariable.notify_all();
+		//Removing waits for running callbacks, so _subscribedPeersMutex must not be locked here.
+		for(std::vector<uint64_t>::iterator i = timers.begin(); i != timers.end(); ++i)
+		{
+			if(*i != 0) _bl->timers.remove(*i);
+		}
+		if(_maintenanceThread.joinable() || _mainThread.joinable())
+		{
+			//Wake up all threads blocking in socket operations.
+			_stopDescriptor.set();
+			_bl->rpcClient.reset();
+		}
+		_maintenanceConditionVariable.notify_all();
+		if(_maintenanceThread.joinable()) _maintenanceThread.join();
+		if(_mainThread.joinable())
+		{
+			_mainThread.join();
+			std::string id = getId();
+			if(!id.empty() && isConnected()) _bl->rpcClient.invoke("init", RPCCLIENTPARAMETERS(id, std::string("")));
+		}
+		setConnected(false);
+		if(_serverSocketDescriptor != -1)
+		{
+			::close(_serverSocketDescriptor);
+			_serverSocketDescriptor = -1;
+		}
+		std::lock_guard<std::mutex> methodsGuard(_methodsMutex);
+		_builtinMethods.clear();
+		updateMethodTable();
+	}
+	catch(const std::exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+}
+
+bool RPCServer::isConnected()
+{
+	std::lock_guard<std::mutex> connectedGuard(_connectedMutex);
+	return _connected;
+}
+
+bool RPCServer::waitForConnection(uint32_t timeout)
+{
+	try
+	{
+		std::unique_lock<std::mutex> connectedGuard(_connectedMutex);
+		_connectedConditionVariable.wait_for(connectedGuard, std::chrono::milliseconds(timeout), [&]{ return _connected || _stopServer; });
+		return _connected;
+	}
+	catch(const std::exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+	return false;
+}
+
+void RPCServer::setConnected(bool connected)
+{
+	try
+	{
+		{
+			std::lock_guard<std::mutex> connectedGuard(_connectedMutex);
+			if(_connected == connected) return;
+			_connected = connected;
+		}
+		_bl->metrics.serverConnected->set(connected ? 1 : 0);
+		_connectedConditionVariable.notify_all();
+		if(connected) HGADDON_PRINT_INFO(_out, "Info: Connection to Homegear is established.");
+		else HGADDON_PRINT_INFO(_out, "Info: Connection to Homegear is lost.");
+		callAllBases(0, CallbackMonitor::CallbackType::connectionStateChanged, [&](Base* base) { base->connectionStateChanged(connected); });
+	}
+	catch(const std::exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+}
+
+void RPCServer::addBase(Base* base)
+{
+	try
+	{
+		if(!base) return;
+		std::lock_guard<std::mutex> subscribedPeersGuard(_subscribedPeersMutex);
+		if(std::find(_bases->begin(), _bases->end(), base) != _bases->end()) return;
+		{
+			std::lock_guard<std::mutex> runningCallbacksGuard(_runningCallbacksMutex);
+			_runningCallbacks[base] = RunningCallbacks();
+		}
+		std::shared_ptr<std::vector<Base*>> bases(new std::vector<Base*>(*_bases));
+		bases->push_back(base);
+		std::atomic_store(&_bases, std::shared_ptr<const std::vector<Base*>>(bases));
+	}
+	catch(const std::exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+}
+
+void RPCServer::removeBase(Base* base)
+{
+	try
+	{
+		{
+			std::lock_guard<std::mutex> subscribedPeersGuard(_subscribedPeersMutex);
+			std::shared_ptr<std::vector<Base*>> bases(new std::vector<Base*>(*_bases));
+			bases->erase(std::remove(bases->begin(), bases->end(), base), bases->end());
+			std::atomic_store(&_bases, std::shared_ptr<const std::vector<Base*>>(bases));
+
+			std::shared_ptr<std::map<uint64_t, std::vector<Base*>>> peerIndex(new std::map<uint64_t, std::vector<Base*>>(*_peerIndex));
+			std::shared_ptr<std::set<uint64_t>> subscribedPeers(new std::set<uint64_t>(*_subscribedPeers));
+			for(std::map<uint64_t, std::vector<Base*>>::iterator i = peerIndex->begin(); i != peerIndex->end();)
+			{
+				i->second.erase(std::remove(i->second.begin(), i->second.end(), base), i->second.end());
+				if(!i->second.empty())
+				{
+					++i;
+					continue;
+				}
+				//No other instance is interested in the peer anymore.
+				subscribedPeers->erase(i->first);
+				if(_peersToSubscribe.erase(i->first) == 0) _peersToUnsubscribe.insert(i->first);
+				i = peerIndex->erase(i);
+			}
+			std::atomic_store(&_peerIndex, std::shared_ptr<const std::map<uint64_t, std::vector<Base*>>>(peerIndex));
+			std::atomic_store(&_subscribedPeers, std::shared_ptr<const std::set<uint64_t>>(subscribedPeers));
+			scheduleSubscriptions(_subscriptionDelay);
+		}
+		//Callbacks starting from now skip the instance. Wait for the ones still running on other threads. Callbacks of the instance on
+		//this thread can't finish before we return, so they are not waited for.
+		uint32_t ownCallbacks = std::count(_callingBases.begin(), _callingBases.end(), base);
+		std::unique_lock<std::mutex> runningCallbacksGuard(_runningCallbacksMutex);
+		std::map<Base*, RunningCallbacks>::iterator runningCallbacks = _runningCallbacks.find(base);
+		if(runningCallbacks == _runningCallbacks.end()) return;
+		runningCallbacks->second.removed = true;
+		_runningCallbacksConditionVariable.wait(runningCallbacksGuard, [&]{ return runningCallbacks->second.count <= ownCallbacks; });
+		_runningCallbacks.erase(runningCallbacks);
+	}
+	catch(const std::exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+}
+
+void RPCServer::addPeers(Base* base, std::vector<uint64_t>& peerIds)
+{
+	try
+	{
+		{
+			std::lock_guard<std::mutex> subscribedPeersGuard(_subscribedPeersMutex);
+			std::shared_ptr<std::map<uint64_t, std::vector<Base*>>> peerIndex(new std::map<uint64_t, std::vector<Base*>>(*_peerIndex));
+			std::shared_ptr<std::set<uint64_t>> subscribedPeers(new std::set<uint64_t>(*_subscribedPeers));
+			for(std::vector<uint64_t>::iterator i = peerIds.begin(); i != peerIds.end(); ++i)
+			{
+				std::vector<Base*>& bases = (*peerIndex)[*i];
+				if(std::find(bases.begin(), bases.end(), base) != bases.end()) continue;
+				bases.push_back(base);
+				//Only the first instance interested in the peer changes the subscription.
+				if(!subscribedPeers->insert(*i).second) continue;
+				if(_peersToUnsubscribe.erase(*i) == 0) _peersToSubscribe.insert(*i);
+			}
+			std::atomic_store(&_peerIndex, std::shared_ptr<const std::map<uint64_t, std::vector<Base*>>>(peerIndex));
+			std::atomic_store(&_subscribedPeers, std::shared_ptr<const std::set<uint64_t>>(subscribedPeers));
+			//Collect all changes made within the delay, so they are sent to Homegear in one call.
+			scheduleSubscriptions(_subscriptionDelay);
+		}
+	}
+	catch(const std::exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+}
+
+void RPCServer::removePeers(Base* base, std::vector<uint64_t>& peerIds)
+{
+	try
+	{
+		{
+			std::lock_guard<std::mutex> subscribedPeersGuard(_subscribedPeersMutex);
+			std::shared_ptr<std::map<uint64_t, std::vector<Base*>>> peerIndex(new std::map<uint64_t, std::vector<Base*>>(*_peerIndex));
+			std::shared_ptr<std::set<uint64_t>> subscribedPeers(new std::set<uint64_t>(*_subscribedPeers));
+			for(std::vector<uint64_t>::iterator i = peerIds.begin(); i != peerIds.end(); ++i)
+			{
+				std::map<uint64_t, std::vector<Base*>>::iterator peerIterator = peerIndex->find(*i);
+				if(peerIterator == peerIndex->end()) continue;
+				std::vector<Base*>& bases = peerIterator->second;
+				bases.erase(std::remove(bases.begin(), bases.end(), base), bases.end());
+				//Only the last instance interested in the peer changes the subscription.
+				if(!bases.empty()) continue;
+				peerIndex->erase(peerIterator);
+				if(subscribedPeers->erase(*i) == 0) continue;
+				if(_peersToSubscribe.erase(*i) == 0) _peersToUnsubscribe.insert(*i);
+			}
+			std::atomic_store(&_peerIndex, std::shared_ptr<const std::map<uint64_t, std::vector<Base*>>>(peerIndex));
+			std::atomic_store(&_subscribedPeers, std::shared_ptr<const std::set<uint64_t>>(subscribedPeers));
+			//Collect all changes made within the delay, so they are sent to Homegear in one call.
+			scheduleSubscriptions(_subscriptionDelay);
+		}
+	}
+	catch(const std::exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+}
+
+void RPCServer::callBases(uint64_t peerId, CallbackMonitor::CallbackType type, std::function<void(Base*)> callback)
+{
+	try
+	{
+		std::shared_ptr<const std::map<uint64_t, std::vector<Base*>>> peerIndex = std::atomic_load(&_peerIndex);
+		std::map<uint64_t, std::vector<Base*>>::const_iterator peerIterator = peerIndex->find(peerId);
+		if(peerIterator != peerIndex->end()) callBaseList(peerIterator->second, peerId, type, callback);
+		else
+		{
+			std::shared_ptr<const std::vector<Base*>> bases = std::atomic_load(&_bases);
+			callBaseList(*bases, peerId, type, callback);
+		}
+	}
+	catch(const std::exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+}
+
+void RPCServer::callAllBases(uint64_t peerId, CallbackMonitor::CallbackType type, std::function<void(Base*)> callback)
+{
+	try
+	{
+		std::shared_ptr<const std::vector<Base*>> bases = std::atomic_load(&_bases);
+		callBaseList(*bases, peerId, type, callback);
+	}
+	catch(const std::exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+}
+
+void RPCServer::callBaseList(const std::vector<Base*>& bases, uint64_t peerId, CallbackMonitor::CallbackType type, std::function<void(Base*)>& callback)
+{
+	for(std::vector<Base*>::const_iterator i = bases.begin(); i != bases.end(); ++i)
+	{
+		{
+			//The list may have been loaded before the instance was removed.
+			std::lock_guard<std::mutex> runningCallbacksGuard(_runningCallbacksMutex);
+			std::map<Base*, RunningCallbacks>::iterator runningCallbacks = _runningCallbacks.find(*i);
+			if(runningCallbacks == _runningCallbacks.end() || runningCallbacks->second.removed) continue;
+			runningCallbacks->second.count++;
+		}
+		_callingBases.push_back(*i);
+		try
+		{
+			HGADDON_TRACE_SPAN(_bl->tracer, "callback");
+			CallbackMonitor::Scope monitorScope(_bl->callbackMonitor, type, peerId);
+			callback(*i);
+		}
+		catch(const std::exception& ex)
+		{
+			_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+		}
+		catch(Exception& ex)
+		{
+			_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+		}
+		catch(...)
+		{
+			_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+		}
+		_callingBases.pop_back();
+		{
+			std::lock_guard<std::mutex> runningCallbacksGuard(_runningCallbacksMutex);
+			std::map<Base*, RunningCallbacks>::iterator runningCallbacks = _runningCallbacks.find(*i);
+			if(runningCallbacks != _runningCallbacks.end()) runningCallbacks->second.count--;
+		}
+		_runningCallbacksConditionVariable.notify_all();
+	}
+}
+
+void RPCServer::scheduleInit(bool retry)
+{
+	try
+	{
+		if(_initTimer != 0 || _stopMaintenanceThread) return;
+		int32_t delay = 0;
+		if(retry)
+		{
+			delay = _initRetryDelay;
+			_initRetryDelay = std::min(_initRetryDelay * 2, _maxInitRetryDelay);
+		}
+		_initTimer = _bl->timers.add(delay, [this]
+		{
+			{
+				std::lock_guard<std::mutex> subscribedPeersGuard(_subscribedPeersMutex);
+				_initTimer = 0;
+				_initDue = true;
+			}
+			_maintenanceConditionVariable.notify_all();
+		});
+	}
+	catch(const std::exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+}
+
+void RPCServer::scheduleSubscriptions(int32_t delay)
+{
+	try
+	{
+		if(_subscriptionTimer != 0 || _stopMaintenanceThread) return;
+		_subscriptionTimer = _bl->timers.add(delay, [this]
+		{
+			{
+				std::lock_guard<std::mutex> subscribedPeersGuard(_subscribedPeersMutex);
+				_subscriptionTimer = 0;
+				_subscriptionsDue = true;
+			}
+			_maintenanceConditionVariable.notify_all();
+		});
 	}
 	catch(const std::exception& ex)
     {
@@ -104,14 +540,60 @@ void RPCServer::stop()
     }
 }
 
-void RPCServer::addPeers(std::vector<uint64_t>& peerIds)
+void RPCServer::maintenanceThread()
 {
 	try
 	{
-		//Mutex does not need to be locked, as no iterators are invalidated
-		for(std::vector<uint64_t>::iterator i = peerIds.begin(); i != peerIds.end(); ++i)
+		std::unique_lock<std::mutex> subscribedPeersGuard(_subscribedPeersMutex);
+		while(!_stopMaintenanceThread)
 		{
-			_subscribedPeers.insert(*i);
+			_maintenanceConditionVariable.wait(subscribedPeersGuard, [&]{ return _stopMaintenanceThread || _initDue || _keepAliveDue || _subscriptionsDue; });
+			if(_stopMaintenanceThread) break;
+			if(_initDue)
+			{
+				//"init" also sends the complete list of subscribed peers and makes the keep alive check unnecessary.
+				_initDue = false;
+				_keepAliveDue = false;
+				subscribedPeersGuard.unlock();
+				_bl->metrics.serverInits->increment();
+				bool success = sendInit();
+				setConnected(success);
+				subscribedPeersGuard.lock();
+				if(success) _initRetryDelay = _minInitRetryDelay;
+				else scheduleInit(true);
+				continue;
+			}
+			if(_keepAliveDue)
+			{
+				_keepAliveDue = false;
+				subscribedPeersGuard.unlock();
+				keepAlive();
+				subscribedPeersGuard.lock();
+				continue;
+			}
+			_subscriptionsDue = false;
+			std::set<uint64_t> peersToSubscribe;
+			std::set<uint64_t> peersToUnsubscribe;
+			peersToSubscribe.swap(_peersToSubscribe);
+			peersToUnsubscribe.swap(_peersToUnsubscribe);
+
+			subscribedPeersGuard.unlock();
+			bool success = sendSubscriptions(peersToSubscribe, peersToUnsubscribe);
+			subscribedPeersGuard.lock();
+
+			if(!success)
+			{
+				//Put back all changes, which have not been superseded in the meantime.
+				for(std::set<uint64_t>::iterator i = peersToSubscribe.begin(); i != peersToSubscribe.end(); ++i)
+				{
+					if(_peersToUnsubscribe.find(*i) == _peersToUnsubscribe.end()) _peersToSubscribe.insert(*i);
+				}
+				for(std::set<uint64_t>::iterator i = peersToUnsubscribe.begin(); i != peersToUnsubscribe.end(); ++i)
+				{
+					if(_peersToSubscribe.find(*i) == _peersToSubscribe.end()) _peersToUnsubscribe.insert(*i);
+				}
+				scheduleSubscriptions(_subscriptionRetryDelay);
+			}
 		}
 	}
 	catch(const std::exception& ex)
@@ -128,15 +610,59 @@ void RPCServer::addPeers(std::vector<uint64_t>& peerIds)
     }
 }
 
-void RPCServer::removePeers(std::vector<uint64_t>& peerIds)
+bool RPCServer::sendSubscriptions(std::set<uint64_t>& peersToSubscribe, std::set<uint64_t>& peersToUnsubscribe)
 {
 	try
 	{
-		_subscribedPeersMutex.lock();
-		for(std::vector<uint64_t>::iterator i = peerIds.begin(); i != peerIds.end(); ++i)
+		std::string id = getId();
+		//Without a server id we are not initialized. The complete list is sent on the next "init" anyway.
+		if(id.empty()) return true;
+		if(!peersToSubscribe.empty())
 		{
-			_subscribedPeers.erase(*i);
+			std::shared_ptr<RPCArray> peers(new RPCArray());
+			peers->reserve(peersToSubscribe.size());
+			for(std::set<uint64_t>::iterator i = peersToSubscribe.begin(); i != peersToSubscribe.end(); ++i)
+			{
+				peers->push_back(PVariable(new Variable((uint32_t)*i)));
+			}
+			if(_bl->rpcClient.invoke("subscribePeers", RPCCLIENTPARAMETERS(id, peers))->errorStruct) return false;
+			peersToSubscribe.clear();
+		}
+		if(!peersToUnsubscribe.empty())
+		{
+			std::shared_ptr<RPCArray> peers(new RPCArray());
+			peers->reserve(peersToUnsubscribe.size());
+			for(std::set<uint64_t>::iterator i = peersToUnsubscribe.begin(); i != peersToUnsubscribe.end(); ++i)
+			{
+				peers->push_back(PVariable(new Variable((uint32_t)*i)));
+			}
+			if(_bl->rpcClient.invoke("unsubscribePeers", RPCCLIENTPARAMETERS(id, peers))->errorStruct) return false;
+			peersToUnsubscribe.clear();
 		}
+		return true;
+	}
+	catch(const std::exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+    return false;
+}
+
+void RPCServer::setMulticallMode(MulticallMode mode, uint32_t threadCount)
+{
+	try
+	{
+		std::shared_ptr<ThreadPool> threadPool;
+		if(mode != MulticallMode::sequential) threadPool.reset(new ThreadPool(threadCount));
+		setMulticallMode(mode, threadPool);
 	}
 	catch(const std::exception& ex)
     {
@@ -150,23 +676,27 @@ void RPCServer::removePeers(std::vector<uint64_t>& peerIds)
     {
     	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
-    _subscribedPeersMutex.unlock();
 }
 
-void RPCServer::registerMethods(Base* base)
+void RPCServer::setMulticallMode(MulticallMode mode, std::shared_ptr<ThreadPool> threadPool)
 {
 	try
 	{
-		_rpcMethods.clear();
-		_rpcMethods.insert(std::pair<std::string, std::unique_ptr<RPCMethod>>("system.listMethods", std::unique_ptr<RPCMethod>(new RPCSystemListMethods())));
-		_rpcMethods.insert(std::pair<std::string, std::unique_ptr<RPCMethod>>("system.methodHelp", std::unique_ptr<RPCMethod>(new RPCSystemMethodHelp())));
-		_rpcMethods.insert(std::pair<std::string, std::unique_ptr<RPCMethod>>("system.methodSignature", std::unique_ptr<RPCMethod>(new RPCSystemMethodSignature())));
-		_rpcMethods.insert(std::pair<std::string, std::unique_ptr<RPCMethod>>("system.multicall", std::unique_ptr<RPCMethod>(new RPCSystemMulticall())));
-		_rpcMethods.insert(std::pair<std::string, std::unique_ptr<RPCMethod>>("deleteDevices", std::unique_ptr<RPCMethod>(new RPCDeleteDevices(base))));
-		_rpcMethods.insert(std::pair<std::string, std::unique_ptr<RPCMethod>>("error", std::unique_ptr<RPCMethod>(new RPCError(base))));
-		_rpcMethods.insert(std::pair<std::string, std::unique_ptr<RPCMethod>>("event", std::unique_ptr<RPCMethod>(new RPCEvent(base))));
-		_rpcMethods.insert(std::pair<std::string, std::unique_ptr<RPCMethod>>("newDevices", std::unique_ptr<RPCMethod>(new RPCNewDevices(base))));
-		_rpcMethods.insert(std::pair<std::string, std::unique_ptr<RPCMethod>>("updateDevice", std::unique_ptr<RPCMethod>(new RPCUpdateDevice(base))));
+		if(mode == MulticallMode::sequential) threadPool.reset();
+		else if(!threadPool)
+		{
+			_out.printError("Error: Can't set multicall mode. No thread pool was given.");
+			return;
+		}
+		std::shared_ptr<ThreadPool> oldThreadPool;
+		{
+			std::lock_guard<std::mutex> threadPoolGuard(_threadPoolMutex);
+			oldThreadPool = _threadPool;
+			_threadPool = threadPool;
+			_multicallMode = mode;
+		}
+		//The old pool is released outside of the lock, as destroying it waits for running multicalls to finish.
+		oldThreadPool.reset();
 	}
 	catch(const std::exception& ex)
     {
@@ -182,22 +712,134 @@ void RPCServer::registerMethods(Base* base)
     }
 }
 
+MulticallMode RPCServer::getMulticallMode(std::shared_ptr<ThreadPool>& threadPool)
+{
+	std::lock_guard<std::mutex> threadPoolGuard(_threadPoolMutex);
+	threadPool = _threadPool;
+	return _multicallMode;
+}
+
+void RPCServer::registerMethods()
+{
+	try
+	{
+		std::lock_guard<std::mutex> methodsGuard(_methodsMutex);
+		_builtinMethods.clear();
+		_builtinMethods.insert(std::pair<std::string, std::shared_ptr<RPCMethod>>("system.listMethods", std::shared_ptr<RPCMethod>(new RPCSystemListMethods(_bl))));
+		_builtinMethods.insert(std::pair<std::string, std::shared_ptr<RPCMethod>>("system.methodHelp", std::shared_ptr<RPCMethod>(new RPCSystemMethodHelp(_bl))));
+		_builtinMethods.insert(std::pair<std::string, std::shared_ptr<RPCMethod>>("system.methodSignature", std::shared_ptr<RPCMethod>(new RPCSystemMethodSignature(_bl))));
+		_builtinMethods.insert(std::pair<std::string, std::shared_ptr<RPCMethod>>("system.multicall", std::shared_ptr<RPCMethod>(new RPCSystemMulticall(_bl))));
+		_builtinMethods.insert(std::pair<std::string, std::shared_ptr<RPCMethod>>("system.getMetrics", std::shared_ptr<RPCMethod>(new RPCSystemGetMetrics(_bl))));
+		_builtinMethods.insert(std::pair<std::string, std::shared_ptr<RPCMethod>>("deleteDevices", std::shared_ptr<RPCMethod>(new RPCDeleteDevices(_bl))));
+		_builtinMethods.insert(std::pair<std::string, std::shared_ptr<RPCMethod>>("error", std::shared_ptr<RPCMethod>(new RPCError(_bl))));
+		_builtinMethods.insert(std::pair<std::string, std::shared_ptr<RPCMethod>>("event", std::shared_ptr<RPCMethod>(new RPCEvent(_bl))));
+		_builtinMethods.insert(std::pair<std::string, std::shared_ptr<RPCMethod>>("newDevices", std::shared_ptr<RPCMethod>(new RPCNewDevices(_bl))));
+		_builtinMethods.insert(std::pair<std::string, std::shared_ptr<RPCMethod>>("updateDevice", std::shared_ptr<RPCMethod>(new RPCUpdateDevice(_bl))));
+		updateMethodTable();
+	}
+	catch(const std::exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+}
+
+void RPCServer::updateMethodTable()
+{
+	//_methodsMutex needs to be locked by the caller. Readers keep using the old table until they are done with it.
+	std::map<std::string, std::shared_ptr<RPCMethod>> methods = _userMethods;
+	for(std::map<std::string, std::shared_ptr<RPCMethod>>::iterator i = _builtinMethods.begin(); i != _builtinMethods.end(); ++i)
+	{
+		methods[i->first] = i->second;
+	}
+	std::shared_ptr<const RPCMethodTable> table(new RPCMethodTable(methods, &_bl->metrics));
+	std::atomic_store(&_rpcMethods, table);
+}
+
+bool RPCServer::registerMethod(std::string methodName, std::shared_ptr<RPCMethod> method)
+{
+	try
+	{
+		if(methodName.empty() || !method) return false;
+		if(methodName.compare(0, 7, "system.") == 0)
+		{
+			_out.printError("Error: Could not register RPC method \"" + methodName + "\". Method names starting with \"system.\" are reserved.");
+			return false;
+		}
+		std::lock_guard<std::mutex> methodsGuard(_methodsMutex);
+		if(_builtinMethods.find(methodName) != _builtinMethods.end())
+		{
+			_out.printError("Error: Could not register RPC method \"" + methodName + "\". The method is provided by the library.");
+			return false;
+		}
+		_userMethods[methodName] = method;
+		updateMethodTable();
+		return true;
+	}
+	catch(const std::exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+    return false;
+}
+
+bool RPCServer::unregisterMethod(std::string methodName)
+{
+	try
+	{
+		std::lock_guard<std::mutex> methodsGuard(_methodsMutex);
+		if(_userMethods.erase(methodName) == 0) return false;
+		updateMethodTable();
+		return true;
+	}
+	catch(const std::exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+    return false;
+}
+
 void RPCServer::mainThread()
 {
 	try
 	{
 		std::string address;
 		int32_t clientSocketDescriptor = -1;
-		SocketOperations socket;
+		SocketOperations socket(_bl);
 		while(!_stopServer)
 		{
 			try
 			{
-				sendInit();
 				if(_serverSocketDescriptor == -1)
 				{
+					{
+						std::unique_lock<std::mutex> subscribedPeersGuard(_subscribedPeersMutex);
+						_maintenanceConditionVariable.wait_for(subscribedPeersGuard, std::chrono::milliseconds(5000), [&]{ return _stopServer; });
+					}
 					if(_stopServer) break;
-					std::this_thread::sleep_for(std::chrono::milliseconds(5000));
 					getSocketDescriptor();
 					continue;
 				}
@@ -207,9 +849,18 @@ void RPCServer::mainThread()
 					if(clientSocketDescriptor != -1 || _stopServer) break;
 				}
 				if(clientSocketDescriptor == -1) continue;
+				_bl->metrics.serverConnections->increment();
 
-				socket = SocketOperations(clientSocketDescriptor);
+				socket = SocketOperations(_bl, clientSocketDescriptor);
+				socket.setInterruptDescriptor(_stopDescriptor.descriptor());
 				readClient(socket);
+				if(!_stopServer)
+				{
+					//Homegear closed the connection. Probably it was restarted.
+					setConnected(false);
+					std::lock_guard<std::mutex> subscribedPeersGuard(_subscribedPeersMutex);
+					scheduleInit(true);
+				}
 			}
 			catch(const std::exception& ex)
 			{
@@ -224,9 +875,6 @@ void RPCServer::mainThread()
 				_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
 			}
 		}
-		std::string id = GD::rpcServer.getId();
-		if(!id.empty()) GD::rpcClient.invoke("init", RPCCLIENTPARAMETERS(id, std::string("")));
-		shutdown(_serverSocketDescriptor, 0);
 	}
 	catch(const std::exception& ex)
     {
@@ -247,11 +895,10 @@ void RPCServer::sendRPCResponseToClient(SocketOperations& socket, std::vector<ch
 	try
 	{
 		if(data.empty()) return;
+		_bl->flightRecorder.record(FlightRecorder::Direction::serverResponse, data.data(), data.size());
 		bool error = false;
 		try
 		{
-			//Sleep a tiny little bit.
-			std::this_thread::sleep_for(std::chrono::milliseconds(2));
 			socket.proofwrite(data);
 		}
 		catch(SocketDataLimitException& ex)
@@ -279,24 +926,129 @@ void RPCServer::sendRPCResponseToClient(SocketOperations& socket, std::vector<ch
     }
 }
 
+void RPCServer::processPacket(std::vector<char>& packet, std::vector<char>& response)
+{
+	try
+	{
+		response.clear();
+		_bl->metrics.serverRequests->increment();
+		std::shared_ptr<Variable> ret = analyzeRPC(packet);
+		if(!ret) return;
+		int64_t startTime = MetricHistogram::now();
+		{
+			HGADDON_TRACE_SPAN(_bl->tracer, "encodeResponse");
+			_rpcEncoder.encodeResponse(ret, response);
+		}
+		_bl->metrics.serverEncodeTime->recordSince(startTime);
+	}
+	catch(const std::exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+}
+
 void RPCServer::analyzeRPC(SocketOperations& socket, std::vector<char>& packet)
+{
+	_bl->metrics.serverRequests->increment();
+	std::shared_ptr<Variable> ret = analyzeRPC(packet);
+	if(ret) sendRPCResponseToClient(socket, ret);
+}
+
+std::shared_ptr<Variable> RPCServer::analyzeRPC(std::vector<char>& packet)
+{
+	try
+	{
+		uint32_t methodNameOffset = 0;
+		uint32_t methodNameSize = 0;
+		std::shared_ptr<std::vector<std::shared_ptr<Variable>>> parameters;
+		DecodeStatus status = DecodeStatus::ok;
+		int64_t startTime = MetricHistogram::now();
+		{
+			HGADDON_TRACE_SPAN(_bl->tracer, "decodeRequest");
+			status = _rpcDecoder.decodeRequest(packet.data(), packet.size(), methodNameOffset, methodNameSize, parameters);
+		}
+		_bl->metrics.serverDecodeTime->recordSince(startTime);
+		if(status != DecodeStatus::ok)
+		{
+			_bl->metrics.serverDecodeErrors->increment();
+			_out.printWarning("Warning: Could not decode RPC packet: " + RPCDecoder::getStatusString(status));
+			return Variable::createError(-32700, ": Could not decode request: " + RPCDecoder::getStatusString(status));
+		}
+		if(!parameters->empty() && parameters->at(0)->errorStruct) return parameters->at(0);
+		startTime = MetricHistogram::now();
+		std::shared_ptr<Variable> ret;
+		{
+			HGADDON_TRACE_SPAN_DETAIL(_bl->tracer, "callMethod", packet.data() + methodNameOffset, methodNameSize);
+			ret = callMethod(packet.data() + methodNameOffset, methodNameSize, parameters);
+		}
+		_bl->metrics.serverDispatchTime->recordSince(startTime);
+		return ret;
+	}
+	catch(const std::exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+    return Variable::createError(-32500, ": Unknown application error.");
+}
+
+void RPCServer::analyzeXmlRpc(SocketOperations& socket, std::vector<char>& packet)
 {
 	try
 	{
+		_bl->metrics.serverRequests->increment();
 		std::string methodName;
 		std::shared_ptr<std::vector<std::shared_ptr<Variable>>> parameters;
-		parameters = _rpcDecoder.decodeRequest(packet, methodName);
-		if(!parameters)
+		DecodeStatus status = DecodeStatus::ok;
+		int64_t startTime = MetricHistogram::now();
 		{
-			_out.printWarning("Warning: Could not decode RPC packet.");
-			return;
+			HGADDON_TRACE_SPAN(_bl->tracer, "decodeRequest");
+			status = _xmlRpcDecoder.decodeRequest(packet, methodName, parameters);
 		}
-		if(!parameters->empty() && parameters->at(0)->errorStruct)
+		_bl->metrics.serverDecodeTime->recordSince(startTime);
+		std::shared_ptr<Variable> ret;
+		if(status != DecodeStatus::ok)
 		{
-			sendRPCResponseToClient(socket, parameters->at(0));
-			return;
+			_bl->metrics.serverDecodeErrors->increment();
+			_out.printWarning("Warning: Could not decode XML-RPC packet: " + RPCDecoder::getStatusString(status));
+			ret = Variable::createError(-32700, ": Could not decode request: " + RPCDecoder::getStatusString(status));
+		}
+		else
+		{
+			startTime = MetricHistogram::now();
+			{
+				HGADDON_TRACE_SPAN_DETAIL(_bl->tracer, "callMethod", methodName.data(), methodName.size());
+				ret = callMethod(methodName.data(), methodName.size(), parameters);
+			}
+			_bl->metrics.serverDispatchTime->recordSince(startTime);
 		}
-		callMethod(socket, methodName, parameters);
+		//Unlike binary RPC, HTTP requires a response for every request.
+		if(!ret) ret.reset(new Variable(VariableType::rpcVoid));
+
+		std::vector<char> data = _bl->bufferPool.get(1024);
+		startTime = MetricHistogram::now();
+		{
+			HGADDON_TRACE_SPAN(_bl->tracer, "encodeResponse");
+			_xmlRpcEncoder.encodeResponse(ret, data);
+		}
+		_bl->metrics.serverEncodeTime->recordSince(startTime);
+		sendRPCResponseToClient(socket, data);
+		_bl->bufferPool.put(data);
 	}
 	catch(const std::exception& ex)
     {
@@ -316,14 +1068,20 @@ void RPCServer::sendRPCResponseToClient(SocketOperations& socket, std::shared_pt
 {
 	try
 	{
-		std::vector<char> data;
-		_rpcEncoder.encodeResponse(variable, data);
-		if(GD::debugLevel >= 5)
+		std::vector<char> data = _bl->bufferPool.get(1024);
+		int64_t startTime = MetricHistogram::now();
+		{
+			HGADDON_TRACE_SPAN(_bl->tracer, "encodeResponse");
+			_rpcEncoder.encodeResponse(variable, data);
+		}
+		_bl->metrics.serverEncodeTime->recordSince(startTime);
+		if(HGADDON_PRINT_ENABLED(_out, 5))
 		{
 			_out.printDebug("Response binary:");
 			_out.printBinary(data);
 		}
 		sendRPCResponseToClient(socket, data);
+		_bl->bufferPool.put(data);
 	}
 	catch(const std::exception& ex)
     {
@@ -344,12 +1102,14 @@ std::shared_ptr<Variable> RPCServer::callMethod(std::string& methodName, std::sh
 	try
 	{
 		if(!parameters) parameters = std::shared_ptr<Variable>(new Variable(VariableType::rpcArray));
-		if(_rpcMethods.find(methodName) == _rpcMethods.end())
+		std::shared_ptr<const RPCMethodTable> methods = getMethods();
+		const RPCMethodTable::Entry* method = methods->findEntry(methodName);
+		if(!method)
 		{
 			_out.printError("Warning: RPC method not found: " + methodName);
 			return Variable::createError(-32601, ": Requested method not found.");
 		}
-		if(GD::debugLevel >= 4)
+		if(HGADDON_PRINT_ENABLED(_out, 4))
 		{
 			_out.printInfo("Info: RPC Method called: " + methodName + " Parameters:");
 			for(std::vector<std::shared_ptr<Variable>>::iterator i = parameters->arrayValue->begin(); i != parameters->arrayValue->end(); ++i)
@@ -357,8 +1117,8 @@ std::shared_ptr<Variable> RPCServer::callMethod(std::string& methodName, std::sh
 				(*i)->print();
 			}
 		}
-		std::shared_ptr<Variable> ret = _rpcMethods.at(methodName)->invoke(parameters->arrayValue);
-		if(GD::debugLevel >= 5)
+		std::shared_ptr<Variable> ret = method->invoke(parameters->arrayValue);
+		if(HGADDON_PRINT_ENABLED(_out, 5))
 		{
 			_out.printDebug("Response: ");
 			ret->print();
@@ -380,30 +1140,28 @@ std::shared_ptr<Variable> RPCServer::callMethod(std::string& methodName, std::sh
     return Variable::createError(-32500, ": Unknown application error.");
 }
 
-void RPCServer::callMethod(SocketOperations& socket, std::string methodName, std::shared_ptr<std::vector<std::shared_ptr<Variable>>> parameters)
+std::shared_ptr<Variable> RPCServer::callMethod(const char* methodName, uint32_t methodNameSize, std::shared_ptr<std::vector<std::shared_ptr<Variable>>> parameters)
 {
 	try
 	{
-		if(_rpcMethods.find(methodName) == _rpcMethods.end())
-		{
-			sendRPCResponseToClient(socket, Variable::createError(-32601, ": Requested method not found."));
-			return;
-		}
-		if(GD::debugLevel >= 4)
+		std::shared_ptr<const RPCMethodTable> methods = getMethods();
+		const RPCMethodTable::Entry* method = methods->findEntry(methodName, methodNameSize);
+		if(!method) return Variable::createError(-32601, ": Requested method not found.");
+		if(HGADDON_PRINT_ENABLED(_out, 4))
 		{
-			_out.printInfo("Info: Client is calling RPC method: " + methodName + " Parameters:");
+			_out.printInfo("Info: Client is calling RPC method: " + std::string(methodName, methodNameSize) + " Parameters:");
 			for(std::vector<std::shared_ptr<Variable>>::iterator i = parameters->begin(); i != parameters->end(); ++i)
 			{
 				(*i)->print();
 			}
 		}
-		std::shared_ptr<Variable> ret = _rpcMethods.at(methodName)->invoke(parameters);
-		if(GD::debugLevel >= 5)
+		std::shared_ptr<Variable> ret = method->invoke(parameters);
+		if(HGADDON_PRINT_ENABLED(_out, 5))
 		{
 			_out.printDebug("Response: ");
 			ret->print();
 		}
-		sendRPCResponseToClient(socket, ret);
+		return ret;
 	}
 	catch(const std::exception& ex)
     {
@@ -417,27 +1175,82 @@ void RPCServer::callMethod(SocketOperations& socket, std::string methodName, std
     {
     	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
+    return Variable::createError(-32500, ": Unknown application error.");
 }
 
-void RPCServer::sendInit()
+bool RPCServer::sendInit()
 {
 	try
 	{
-		_lastKeepAlive = GD::hf.getTimeSeconds();
-		std::string id = GD::rpcServer.getId();
-		if(id.empty()) return;
-		if(GD::hf.getTimeSeconds() - _lastInit < 30) return;
-		_lastInit = GD::hf.getTimeSeconds();
-		if(GD::rpcClient.invoke("init", RPCCLIENTPARAMETERS(id, id + "-AddonLib", 15))->errorStruct) return;
+		std::string id = getId();
+		if(id.empty()) return false;
+		std::shared_ptr<const std::set<uint64_t>> peers;
+		{
+			//Pending changes are part of the complete list.
+			std::lock_guard<std::mutex> subscribedPeersGuard(_subscribedPeersMutex);
+			_peersToSubscribe.clear();
+			_peersToUnsubscribe.clear();
+			peers = _subscribedPeers;
+		}
 		std::shared_ptr<RPCArray> subscribedPeers(new RPCArray());
-		_subscribedPeersMutex.lock();
-		for(std::set<uint64_t>::const_iterator i = _subscribedPeers.begin(); i != _subscribedPeers.end(); ++i)
+		subscribedPeers->reserve(peers->size());
+		for(std::set<uint64_t>::const_iterator i = peers->begin(); i != peers->end(); ++i)
 		{
 			subscribedPeers->push_back(PVariable(new Variable((uint32_t)*i)));
 		}
-		_subscribedPeersMutex.unlock();
-		GD::rpcClient.invoke("setClientType", RPCCLIENTPARAMETERS(1));
-		GD::rpcClient.invoke("subscribePeers", RPCCLIENTPARAMETERS(id, subscribedPeers));
+
+		//All three calls are sent in one "system.multicall", so the handshake only needs one round trip. Homegear executes them in order.
+		std::vector<std::pair<std::string, PRPCList>> calls
+		{
+			{ "init", RPCCLIENTPARAMETERS(id, id + "-AddonLib", 15) },
+			{ "setClientType", RPCCLIENTPARAMETERS(1) },
+			{ "subscribePeers", RPCCLIENTPARAMETERS(id, subscribedPeers) }
+		};
+		PVariable multicallParameters(new Variable(VariableType::rpcArray));
+		for(std::vector<std::pair<std::string, PRPCList>>::iterator i = calls.begin(); i != calls.end(); ++i)
+		{
+			PVariable call(new Variable(VariableType::rpcStruct));
+			call->structValue->insert(RPCStructElement("methodName", PVariable(new Variable(i->first))));
+			PVariable callParameters(new Variable(VariableType::rpcArray));
+			callParameters->arrayValue->insert(callParameters->arrayValue->end(), i->second->begin(), i->second->end());
+			call->structValue->insert(RPCStructElement("params", callParameters));
+			multicallParameters->arrayValue->push_back(call);
+		}
+		PVariable result = _bl->rpcClient.invoke("system.multicall", PRPCList(new RPCList{ multicallParameters }));
+		RPCArray results;
+		if(result->errorStruct && result->structValue->find("faultCode") != result->structValue->end() && result->structValue->at("faultCode")->integerValue == -32601)
+		{
+			//Fallback for servers without "system.multicall". Like in the multicall all calls are executed and their results are checked
+			//together, so both ways report the same errors.
+			for(std::vector<std::pair<std::string, PRPCList>>::iterator i = calls.begin(); i != calls.end(); ++i)
+			{
+				results.push_back(_bl->rpcClient.invoke(i->first, i->second));
+			}
+		}
+		else if(result->errorStruct) return false; //Already logged by the RPC client.
+		else results.swap(*result->arrayValue);
+
+		std::string errors;
+		for(uint32_t i = 0; i < calls.size(); i++)
+		{
+			PVariable callResult = (i < results.size()) ? results.at(i) : PVariable();
+			if(!callResult)
+			{
+				errors += (errors.empty() ? "" : ", ") + calls.at(i).first + ": No response";
+				continue;
+			}
+			if(callResult->type != VariableType::rpcStruct) continue;
+			RPCStruct::iterator faultCode = callResult->structValue->find("faultCode");
+			if(faultCode == callResult->structValue->end()) continue;
+			RPCStruct::iterator faultString = callResult->structValue->find("faultString");
+			errors += (errors.empty() ? "" : ", ") + calls.at(i).first + ": " + (faultString == callResult->structValue->end() ? std::string("") : faultString->second->stringValue) + " (" + std::to_string(faultCode->second->integerValue) + ")";
+		}
+		if(!errors.empty())
+		{
+			_out.printError("Error: Initialization of the connection to Homegear failed: " + errors);
+			return false;
+		}
+		return true;
 	}
 	catch(const std::exception& ex)
     {
@@ -451,17 +1264,21 @@ void RPCServer::sendInit()
     {
     	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
     }
+    return false;
 }
 
 void RPCServer::keepAlive()
 {
 	try
 	{
-		if(GD::hf.getTimeSeconds() - _lastKeepAlive >= 30)
+		std::string id = getId();
+		if(id.empty()) return;
+		bool result = _bl->rpcClient.invoke("clientServerInitialized", RPCCLIENTPARAMETERS(id + "-AddonLib"))->booleanValue;
+		if(!result)
 		{
-			_lastKeepAlive = GD::hf.getTimeSeconds();
-			bool result = GD::rpcClient.invoke("clientServerInitialized", RPCCLIENTPARAMETERS(getId() + "-AddonLib"))->booleanValue;
-			if(!result) sendInit();
+			setConnected(false);
+			std::lock_guard<std::mutex> subscribedPeersGuard(_subscribedPeersMutex);
+			scheduleInit(false);
 		}
 	}
 	catch(const std::exception& ex)
@@ -487,9 +1304,11 @@ void RPCServer::readClient(SocketOperations& socket)
 		//Make sure the buffer is null terminated.
 		buffer[bufferMax] = '\0';
 		std::vector<char> packet;
+		std::vector<char> httpPacket;
 		uint32_t packetLength = 0;
 		int32_t bytesRead;
 		uint32_t dataSize = 0;
+		int64_t receiveStartTime = 0;
 
 		while(!_stopServer)
 		{
@@ -502,12 +1321,15 @@ void RPCServer::readClient(SocketOperations& socket)
 			}
 			catch(const SocketTimeOutException& ex)
 			{
-				keepAlive();
 				continue;
 			}
+			catch(const SocketInterruptedException& ex)
+			{
+				break;
+			}
 			catch(const SocketClosedException& ex)
 			{
-				_out.printInfo("Info: " + ex.what());
+				HGADDON_PRINT_INFO(_out, "Info: " + ex.what());
 				break;
 			}
 			catch(const SocketOperationException& ex)
@@ -516,28 +1338,87 @@ void RPCServer::readClient(SocketOperations& socket)
 				break;
 			}
 
-			if(GD::debugLevel >= 5)
+			if(HGADDON_PRINT_ENABLED(_out, 5))
 			{
 				std::vector<uint8_t> rawPacket(buffer, buffer + bytesRead);
 				_out.printDebug("Debug: Packet received: " + HelperFunctions::getHexString(rawPacket));
 			}
-			if(packetLength == 0 && !strncmp(&buffer[0], "Bin", 3))
+			if(!httpPacket.empty() || (packetLength == 0 && XMLRPCDecoder::isRequest(buffer, bytesRead)))
+			{
+				//XML-RPC over HTTP. The packet is parsed in place, so it is collected in one buffer until header and body are complete.
+				if(httpPacket.empty())
+				{
+					httpPacket = _bl->bufferPool.get(2048);
+					receiveStartTime = HGADDON_TRACE_NOW();
+				}
+				httpPacket.insert(httpPacket.end(), buffer, buffer + bytesRead);
+				//The buffer might contain more than one request, when the client doesn't wait for the responses.
+				bool closeConnection = false;
+				while(!httpPacket.empty())
+				{
+					if(httpPacket.size() >= 5 && !XMLRPCDecoder::isRequest(httpPacket.data(), httpPacket.size()))
+					{
+						_out.printError("Error: Uninterpretable data following an XML-RPC request received. Closing connection.");
+						closeConnection = true;
+						break;
+					}
+					uint32_t headerSize = 0;
+					uint32_t contentLength = 0;
+					DecodeStatus status = XMLRPCDecoder::getMessageSize(httpPacket.data(), httpPacket.size(), headerSize, contentLength);
+					if(status == DecodeStatus::truncated)
+					{
+						if(httpPacket.size() <= 8192) break;
+						_out.printError("Error: HTTP packet with header larger than 8 KiB received. Closing connection.");
+						closeConnection = true;
+						break;
+					}
+					if(status != DecodeStatus::ok)
+					{
+						_out.printError("Error: HTTP packet without \"Content-Length\" or with chunked transfer encoding received. Closing connection.");
+						closeConnection = true;
+						break;
+					}
+					if(contentLength > 10485760)
+					{
+						_out.printError("Error: Packet with data larger than 10 MiB received. Closing connection.");
+						closeConnection = true;
+						break;
+					}
+					uint32_t messageSize = headerSize + contentLength;
+					if(httpPacket.size() < messageSize) break;
+					//The decoder removes everything after the message, so the start of the next request is moved to its own buffer first.
+					std::vector<char> nextPacket;
+					if(httpPacket.size() > messageSize)
+					{
+						nextPacket = _bl->bufferPool.get(httpPacket.size() - messageSize);
+						nextPacket.insert(nextPacket.end(), httpPacket.begin() + messageSize, httpPacket.end());
+					}
+					HGADDON_TRACE_COMPLETE(_bl->tracer, "receive", receiveStartTime);
+					_bl->flightRecorder.record(FlightRecorder::Direction::serverRequest, httpPacket.data(), messageSize);
+					analyzeXmlRpc(socket, httpPacket);
+					_bl->bufferPool.put(httpPacket);
+					httpPacket.swap(nextPacket);
+					receiveStartTime = HGADDON_TRACE_NOW();
+				}
+				if(closeConnection) break;
+			}
+			else if(packetLength == 0 && !strncmp(&buffer[0], "Bin", 3))
 			{
 				if(bytesRead < 8) continue;
 				uint32_t headerSize = 0;
 				if(buffer[3] & 0x40)
 				{
-					GD::hf.memcpyBigEndian((char*)&headerSize, buffer + 4, 4);
+					_bl->hf.memcpyBigEndian((char*)&headerSize, buffer + 4, 4);
 					if(bytesRead < (signed)headerSize + 12)
 					{
 						_out.printError("Error: Binary rpc packet has invalid header size.");
 						continue;
 					}
-					GD::hf.memcpyBigEndian((char*)&dataSize, buffer + 8 + headerSize, 4);
+					_bl->hf.memcpyBigEndian((char*)&dataSize, buffer + 8 + headerSize, 4);
 					dataSize += headerSize + 4;
 				}
-				else GD::hf.memcpyBigEndian((char*)&dataSize, buffer + 4, 4);
-				_out.printDebug("Receiving binary rpc packet with size: " + std::to_string(dataSize), 6);
+				else _bl->hf.memcpyBigEndian((char*)&dataSize, buffer + 4, 4);
+				HGADDON_PRINT_DEBUG_LEVEL(_out, "Receiving binary rpc packet with size: " + std::to_string(dataSize), 6);
 				if(dataSize == 0) continue;
 				if(headerSize > 1024)
 				{
@@ -549,16 +1430,22 @@ void RPCServer::readClient(SocketOperations& socket)
 					_out.printError("Error: Packet with data larger than 10 MiB received.");
 					continue;
 				}
-				packet.clear();
-				packet.reserve(dataSize + 9);
+				//The buffer is taken from the pool for every packet and returned after processing, so receiving doesn't allocate.
+				_bl->bufferPool.put(packet);
+				packet = _bl->bufferPool.get(dataSize + 9);
 				packet.insert(packet.end(), buffer, buffer + bytesRead);
 				std::shared_ptr<RPCHeader> header = _rpcDecoder.decodeHeader(packet);
+				//The receive span starts with the first chunk of the packet, waiting for a packet is not part of it.
+				receiveStartTime = HGADDON_TRACE_NOW();
 
 				if(dataSize > (unsigned)bytesRead - 8) packetLength = bytesRead - 8;
 				else
 				{
 					packetLength = 0;
+					HGADDON_TRACE_COMPLETE(_bl->tracer, "receive", receiveStartTime);
+					_bl->flightRecorder.record(FlightRecorder::Direction::serverRequest, packet.data(), dataSize + 8);
 					analyzeRPC(socket, packet);
+					_bl->bufferPool.put(packet);
 				}
 			}
 			else if(packetLength > 0)
@@ -574,7 +1461,10 @@ void RPCServer::readClient(SocketOperations& socket)
 				if(packetLength == dataSize)
 				{
 					packet.push_back('\0');
+					HGADDON_TRACE_COMPLETE(_bl->tracer, "receive", receiveStartTime);
+					_bl->flightRecorder.record(FlightRecorder::Direction::serverRequest, packet.data(), dataSize + 8);
 					analyzeRPC(socket, packet);
+					_bl->bufferPool.put(packet);
 					packetLength = 0;
 				}
 			}
@@ -606,19 +1496,17 @@ int32_t RPCServer::getClientSocketDescriptor()
 	int32_t socketDescriptor = -1;
 	try
 	{
-		timeval timeout;
-		timeout.tv_sec = 5;
-		timeout.tv_usec = 0;
-		fd_set readFileDescriptor;
-		FD_ZERO(&readFileDescriptor);
-		int32_t nfds = _serverSocketDescriptor + 1;
-		if(nfds <= 0)
+		if(_serverSocketDescriptor < 0)
 		{
-			GD::out.printError("Error: Server file descriptor is invalid.");
+			_bl->out.printError("Error: Server file descriptor is invalid.");
 			return socketDescriptor;
 		}
-		FD_SET(_serverSocketDescriptor, &readFileDescriptor);
-		if(!select(nfds, &readFileDescriptor, NULL, NULL, &timeout))
+		pollfd pollstructs[2]
+		{
+			{ (int)_serverSocketDescriptor, (short)POLLIN, (short)0 },
+			{ (int)_stopDescriptor.descriptor(), (short)POLLIN, (short)0 }
+		};
+		if(poll(pollstructs, 2, 5000) <= 0 || (pollstructs[1].revents & POLLIN) || !(pollstructs[0].revents & POLLIN))
 		{
 			return socketDescriptor;
 		}
@@ -639,7 +1527,7 @@ int32_t RPCServer::getClientSocketDescriptor()
 			inet_ntop(AF_INET6, &s->sin6_addr, ipString, sizeof(ipString));
 		}
 
-		_out.printInfo("Info: Connection from " + std::string(&ipString[0]) + " accepted.");
+		HGADDON_PRINT_INFO(_out, "Info: Connection from " + std::string(&ipString[0]) + " accepted.");
 	}
     catch(const std::exception& ex)
     {
@@ -706,7 +1594,7 @@ void RPCServer::getSocketDescriptor()
 			memset(&address, 0, sizeof(address));
 			getsockname(_serverSocketDescriptor, (sockaddr*)(&address), &addrLength);
 			_id = std::string("binary://127.0.0.1:") + std::to_string(ntohs(address.sin_port));
-			_out.printInfo("Info: RPC Server started listening.");
+			HGADDON_PRINT_INFO(_out, "Info: RPC Server started listening.");
 			bound = true;
 			break;
 		}
@@ -32,22 +32,31 @@
 #define RPCSERVER_H_
 
 #include "RPCMethod.h"
+#include "RPCMethodTable.h"
 #include "Output.h"
 #include "Encoding/RPCDecoder.h"
 #include "Encoding/RPCEncoder.h"
+#include "Encoding/XMLRPCDecoder.h"
+#include "Encoding/XMLRPCEncoder.h"
 #include "SocketOperations.h"
+#include "ThreadPool.h"
+#include "CallbackMonitor.h"
 #include "Base.h"
 
 #include <thread>
+#include <condition_variable>
 #include <iostream>
 #include <iomanip>
 #include <string>
 #include <vector>
 #include <list>
 #include <set>
+#include <map>
+#include <functional>
 #include <iterator>
 #include <sstream>
 #include <utility>
+#include <algorithm>
 #include <cstring>
 
 #include <fcntl.h>
@@ -56,38 +65,153 @@
 #include <netdb.h>
 #include <sys/socket.h>
 #include <errno.h>
+#include <poll.h>
 
 namespace HgAddonLib
 {
+	class SharedObjects;
+
 	class RPCServer {
 		public:
-			RPCServer();
+			RPCServer(SharedObjects* bl);
 			virtual ~RPCServer();
 
-			void start(Base* base, uint64_t myPeerId);
+			void start();
 			void stop();
-			std::map<std::string, std::unique_ptr<RPCMethod>>* getMethods() { return &_rpcMethods; }
+			std::shared_ptr<const RPCMethodTable> getMethods() { return std::atomic_load(&_rpcMethods); }
+			bool registerMethod(std::string methodName, std::shared_ptr<RPCMethod> method);
+			bool unregisterMethod(std::string methodName);
 			std::shared_ptr<Variable> callMethod(std::string& methodName, std::shared_ptr<Variable>& parameters);
 			std::string getId() { return (_serverSocketDescriptor != -1) ? _id : ""; }
+			bool isConnected();
+			bool waitForConnection(uint32_t timeout);
+
+			/**
+			 * Executes a binary RPC request like one received from Homegear and encodes the response, without a connection. Used to replay
+			 * recorded traffic. Can be called from any thread.
+			 *
+			 * @param packet The request including the binary RPC header.
+			 * @param response The encoded response. A fault with code -32700 when the request could not be decoded. Empty when the called
+			 * method returned no value.
+			 */
+			void processPacket(std::vector<char>& packet, std::vector<char>& response);
+
+			/**
+			 * Attaches a Base instance to the server. All attached instances share the server, the connection to Homegear and one
+			 * subscription.
+			 */
+			void addBase(Base* base);
+
+			/**
+			 * Detaches a Base instance and removes all of its subscriptions. The instance gets no new callbacks. Returns when no callback
+			 * of the instance is executing on another thread anymore, so the instance can be destroyed safely. Callbacks of other
+			 * instances are not waited for, so an instance can be removed from a callback, e. g. when one addon of a host unloads another.
+			 * Callbacks of the instance executing on the calling thread must not access the instance after it was destroyed.
+			 */
+			void removeBase(Base* base);
 
-			void addPeers(std::vector<uint64_t>& peerIds);
-			void removePeers(std::vector<uint64_t>& peerIds);
+			void addPeers(Base* base, std::vector<uint64_t>& peerIds);
+			void removePeers(Base* base, std::vector<uint64_t>& peerIds);
+
+			/**
+			 * Calls "callback" for every Base instance subscribed to the peer. When no instance subscribed to the peer (e. g. for system
+			 * variables with peer id "0"), all instances are called. Exceptions thrown by the callback are printed and don't stop the
+			 * other instances from being called. Every call is timed by the CallbackMonitor of the context.
+			 */
+			void callBases(uint64_t peerId, CallbackMonitor::CallbackType type, std::function<void(Base*)> callback);
+
+			/**
+			 * Calls "callback" for all attached Base instances.
+			 *
+			 * @param peerId The peer the callback is executed for or "0". Only used in the warnings of the CallbackMonitor.
+			 */
+			void callAllBases(uint64_t peerId, CallbackMonitor::CallbackType type, std::function<void(Base*)> callback);
+			std::shared_ptr<const std::set<uint64_t>> getSubscribedPeers() { return std::atomic_load(&_subscribedPeers); }
+
+			void setMulticallMode(MulticallMode mode, uint32_t threadCount);
+			void setMulticallMode(MulticallMode mode, std::shared_ptr<ThreadPool> threadPool);
+			MulticallMode getMulticallMode(std::shared_ptr<ThreadPool>& threadPool);
 		protected:
 		private:
+			SharedObjects* _bl = nullptr;
 			Output _out;
 			bool _stopServer = false;
 			std::thread _mainThread;
 			int32_t _backlog = 2;
 			int32_t _serverSocketDescriptor = -1;
-			std::map<std::string, std::unique_ptr<RPCMethod>> _rpcMethods;
+			InterruptDescriptor _stopDescriptor;
+			std::mutex _methodsMutex;
+			std::map<std::string, std::shared_ptr<RPCMethod>> _builtinMethods;
+			std::map<std::string, std::shared_ptr<RPCMethod>> _userMethods;
+			std::shared_ptr<const RPCMethodTable> _rpcMethods;
 			RPCDecoder _rpcDecoder;
 			RPCEncoder _rpcEncoder;
+			XMLRPCDecoder _xmlRpcDecoder;
+			XMLRPCEncoder _xmlRpcEncoder;
 			std::string _id;
-			int32_t _lastInit = 0;
-			int32_t _lastKeepAlive = 0;
-			uint64_t _myPeerId = 0;
-			std::mutex _subscribedPeersMutex;
-			std::set<uint64_t> _subscribedPeers;
+			bool _connected = false;
+			std::mutex _connectedMutex;
+			std::condition_variable _connectedConditionVariable;
+
+			/**
+			 * Copy on write set of all subscribed peers. Readers use std::atomic_load, writers additionally need to lock _subscribedPeersMutex.
+			 */
+			std::shared_ptr<const std::set<uint64_t>> _subscribedPeers;
+			std::mutex _subscribedPeersMutex; //Also guards the members used by the maintenance thread and the Base instances.
+
+			/**
+			 * Copy on write list of all attached Base instances and index of the instances subscribed to each peer. Both are guarded by
+			 * _subscribedPeersMutex like _subscribedPeers.
+			 */
+			std::shared_ptr<const std::vector<Base*>> _bases;
+			std::shared_ptr<const std::map<uint64_t, std::vector<Base*>>> _peerIndex;
+
+			struct RunningCallbacks
+			{
+				uint32_t count = 0;
+
+				/**
+				 * Set by removeBase. No new callbacks are started for the instance.
+				 */
+				bool removed = false;
+			};
+
+			/**
+			 * The number of callbacks currently executing per attached Base instance. Used by removeBase to wait for the running callbacks
+			 * of one instance. Guarded by _runningCallbacksMutex.
+			 */
+			std::map<Base*, RunningCallbacks> _runningCallbacks;
+
+			/**
+			 * The instances whose callbacks the current thread is executing, innermost last.
+			 */
+			static thread_local std::vector<Base*> _callingBases;
+			std::mutex _runningCallbacksMutex;
+			std::condition_variable _runningCallbacksConditionVariable;
+			std::set<uint64_t> _peersToSubscribe;
+			std::set<uint64_t> _peersToUnsubscribe;
+			int32_t _subscriptionDelay = 100;
+			int32_t _subscriptionRetryDelay = 5000;
+
+			/**
+			 * The maintenance thread talks to Homegear when one of the timers of the library context requests it, so timer callbacks never block.
+			 */
+			std::thread _maintenanceThread;
+			bool _stopMaintenanceThread = false;
+			std::condition_variable _maintenanceConditionVariable;
+			bool _initDue = false;
+			bool _keepAliveDue = false;
+			bool _subscriptionsDue = false;
+			uint64_t _initTimer = 0;
+			uint64_t _keepAliveTimer = 0;
+			uint64_t _subscriptionTimer = 0;
+			int32_t _keepAliveInterval = 30000;
+			int32_t _minInitRetryDelay = 1000;
+			int32_t _maxInitRetryDelay = 30000;
+			int32_t _initRetryDelay = 1000;
+			MulticallMode _multicallMode = MulticallMode::sequential;
+			std::mutex _threadPoolMutex;
+			std::shared_ptr<ThreadPool> _threadPool;
 
 			void getSocketDescriptor();
 			int32_t getClientSocketDescriptor();
@@ -96,10 +220,28 @@ namespace HgAddonLib
 			void sendRPCResponseToClient(SocketOperations& socket, std::shared_ptr<Variable> error);
 			void sendRPCResponseToClient(SocketOperations& socket, std::vector<char>& data);
 			void analyzeRPC(SocketOperations& socket, std::vector<char>& packet);
-			void callMethod(SocketOperations& socket, std::string methodName, std::shared_ptr<std::vector<std::shared_ptr<Variable>>> parameters);
-			void registerMethods(Base* base);
+
+			/**
+			 * Decodes and executes an XML-RPC request and sends the XML-RPC response.
+			 */
+			void analyzeXmlRpc(SocketOperations& socket, std::vector<char>& packet);
+
+			/**
+			 * Decodes and executes a request. Returns the response, a fault with code -32700 when the packet could not be decoded or nullptr,
+			 * when the called method returned no value.
+			 */
+			std::shared_ptr<Variable> analyzeRPC(std::vector<char>& packet);
+			std::shared_ptr<Variable> callMethod(const char* methodName, uint32_t methodNameSize, std::shared_ptr<std::vector<std::shared_ptr<Variable>>> parameters);
+			void registerMethods();
+			void callBaseList(const std::vector<Base*>& bases, uint64_t peerId, CallbackMonitor::CallbackType type, std::function<void(Base*)>& callback);
+			void updateMethodTable();
 			void keepAlive();
-			void sendInit();
+			void setConnected(bool connected);
+			bool sendInit();
+			void scheduleInit(bool retry);
+			void scheduleSubscriptions(int32_t delay);
+			void maintenanceThread();
+			bool sendSubscriptions(std::set<uint64_t>& peersToSubscribe, std::set<uint64_t>& peersToUnsubscribe);
 	};
 }
 #endif
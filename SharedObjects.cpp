@@ -27,13 +27,12 @@
  * files in the program, then also delete it here.
  */
 
-#include "GD.h"
+#include "SharedObjects.h"
 
 namespace HgAddonLib
 {
-int32_t GD::debugLevel = 3;
-Output GD::out;
-HelperFunctions GD::hf;
-RPCServer GD::rpcServer;
-RPCClient GD::rpcClient;
+SharedObjects::SharedObjects() : logTimeMode(LogTimeMode::wallClock), startTime(std::chrono::steady_clock::now()), timers(this), flightRecorder(this), tracer(this), callbackMonitor(this), rpcClient(this), rpcServer(this)
+{
+	out.init(this);
+}
 }
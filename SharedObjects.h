@@ -0,0 +1,94 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef SHAREDOBJECTS_H_
+#define SHAREDOBJECTS_H_
+
+#include "Exception.h"
+#include "Metrics.h"
+#include "LogWriter.h"
+#include "Output.h"
+#include "HelperFunctions/HelperFunctions.h"
+#include "HelperFunctions/Math.h"
+#include "TimerWheel.h"
+#include "BufferPool.h"
+#include "FlightRecorder.h"
+#include "Tracer.h"
+#include "CallbackMonitor.h"
+#include "RPCClient.h"
+#include "RPCServer.h"
+
+namespace HgAddonLib
+{
+/**
+ * The library context. It owns everything one addon instance needs to talk to Homegear, so multiple independent instances can exist
+ * in one process. The objects get a pointer to their context on construction.
+ */
+class SharedObjects
+{
+public:
+	/**
+	 * The debug level of this instance. Possible values: 1 (critical), 2 (error), 3 (warning), 4 (info), 5 (debug)
+	 */
+	int32_t debugLevel = 3;
+
+	/**
+	 * The clock used for the time prefix of log messages.
+	 */
+	std::atomic<LogTimeMode> logTimeMode;
+
+	/**
+	 * The time the context was created. Log times are relative to it in LogTimeMode::monotonic.
+	 */
+	const std::chrono::steady_clock::time_point startTime;
+
+	Metrics metrics;
+
+	//Everything below logs through the writer, so it must be destroyed last.
+	LogWriter logWriter;
+	Output out;
+	HelperFunctions hf;
+	TimerWheel timers;
+	BufferPool bufferPool;
+	FlightRecorder flightRecorder;
+	Tracer tracer;
+	CallbackMonitor callbackMonitor;
+
+	//The server uses the client, so the client must be destroyed last.
+	RPCClient rpcClient;
+	RPCServer rpcServer;
+
+	SharedObjects();
+	virtual ~SharedObjects() {}
+private:
+	SharedObjects(const SharedObjects&);
+	SharedObjects& operator=(const SharedObjects&);
+};
+}
+#endif
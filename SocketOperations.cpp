@@ -28,23 +28,53 @@
  */
 
 #include "SocketOperations.h"
-#include "GD.h"
+#include "SharedObjects.h"
 
 namespace HgAddonLib
 {
-SocketOperations::SocketOperations()
+InterruptDescriptor::InterruptDescriptor(SharedObjects* bl)
 {
+	_bl = bl;
+	_descriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(_descriptor == -1) _bl->out.printError("Error: Could not create event descriptor: " + std::string(strerror(errno)));
+}
+
+InterruptDescriptor::~InterruptDescriptor()
+{
+	if(_descriptor != -1) ::close(_descriptor);
+}
+
+void InterruptDescriptor::set()
+{
+	if(_descriptor == -1) return;
+	uint64_t value = 1;
+	if(write(_descriptor, &value, sizeof(value)) != sizeof(value)) _bl->out.printError("Error: Could not write to event descriptor: " + std::string(strerror(errno)));
+}
+
+void InterruptDescriptor::reset()
+{
+	if(_descriptor == -1) return;
+	uint64_t value = 0;
+	//Reading resets the counter. Fails with EAGAIN when not set.
+	if(read(_descriptor, &value, sizeof(value)) == -1 && errno != EAGAIN) _bl->out.printError("Error: Could not read from event descriptor: " + std::string(strerror(errno)));
+}
+
+SocketOperations::SocketOperations(SharedObjects* bl)
+{
+	_bl = bl;
 	_autoConnect = false;
 }
 
-SocketOperations::SocketOperations(int32_t socketDescriptor)
+SocketOperations::SocketOperations(SharedObjects* bl, int32_t socketDescriptor)
 {
+	_bl = bl;
 	_autoConnect = false;
 	if(socketDescriptor) _socketDescriptor = socketDescriptor;
 }
 
-SocketOperations::SocketOperations(std::string hostname, std::string port)
+SocketOperations::SocketOperations(SharedObjects* bl, std::string hostname, std::string port)
 {
+	_bl = bl;
 	signal(SIGPIPE, SIG_IGN);
 
 	_hostname = hostname;
@@ -90,32 +120,44 @@ void SocketOperations::shutdown()
 	_socketDescriptor = -1;
 }
 
+int32_t SocketOperations::waitForSocket(short events, int32_t timeout)
+{
+	pollfd pollstructs[2]
+	{
+		{ (int)_socketDescriptor, events, (short)0 },
+		{ (int)_interruptDescriptor, (short)POLLIN, (short)0 }
+	};
+	int32_t pollResult;
+	do
+	{
+		pollResult = poll(pollstructs, (_interruptDescriptor == -1) ? 1 : 2, timeout);
+	} while(pollResult == -1 && errno == EINTR);
+	if(pollResult > 0 && (pollstructs[1].revents & POLLIN)) throw SocketInterruptedException("Socket operation was interrupted.");
+	return pollResult;
+}
+
 
 int32_t SocketOperations::proofread(char* buffer, int32_t bufferSize)
 {
 	if(!_socketDescriptor) throw SocketOperationException("Socket descriptor is nullptr.");
 	if(!connected()) autoConnect();
-	//Timeout needs to be set every time, so don't put it outside of the while loop
-	timeval timeout;
-	int32_t seconds = _readTimeout / 1000000;
-	timeout.tv_sec = seconds;
-	timeout.tv_usec = _readTimeout - (1000000 * seconds);
-	fd_set readFileDescriptor;
-	FD_ZERO(&readFileDescriptor);
-	int32_t nfds = _socketDescriptor + 1;
-	if(nfds <= 0)
+	if(_socketDescriptor < 0)
 	{
 		throw SocketClosedException("Connection closed (1).");
 	}
-	FD_SET(_socketDescriptor, &readFileDescriptor);
-	int32_t bytesRead = select(nfds, &readFileDescriptor, NULL, NULL, &timeout);
-	if(bytesRead == 0) throw SocketTimeOutException("Reading from socket timed out.");
+	int32_t bytesRead = waitForSocket(POLLIN, _readTimeout / 1000);
+	if(bytesRead == 0)
+	{
+		_bl->metrics.socketReadTimeouts->increment();
+		throw SocketTimeOutException("Reading from socket timed out.");
+	}
 	if(bytesRead != 1) throw SocketClosedException("Connection closed (2).");
 	do
 	{
 		bytesRead = read(_socketDescriptor, buffer, bufferSize);
 	} while(bytesRead < 0 && errno == EAGAIN);
 	if(bytesRead <= 0) throw SocketClosedException("Connection to client number closed (3).");
+	_bl->metrics.socketBytesRead->increment(bytesRead);
 	return bytesRead;
 }
 
@@ -128,29 +170,26 @@ int32_t SocketOperations::proofwrite(const std::shared_ptr<std::vector<char>> da
 
 int32_t SocketOperations::proofwrite(const std::vector<char>& data)
 {
-
+	HGADDON_TRACE_SPAN(_bl->tracer, "proofwrite");
 	if(!_socketDescriptor) throw SocketOperationException("Socket descriptor is nullptr.");
 	if(!connected()) autoConnect();
 	if(data.empty()) return 0;
 	if(data.size() > 10485760) throw SocketDataLimitException("Data size is larger than 10 MiB.");
-	GD::out.printDebug("Debug: ... data size is " + std::to_string(data.size()), 6);
+	HGADDON_PRINT_DEBUG_LEVEL(_bl->out, "Debug: ... data size is " + std::to_string(data.size()), 6);
 
 	int32_t totalBytesWritten = 0;
 	while (totalBytesWritten < (signed)data.size())
 	{
-		timeval timeout;
-		timeout.tv_sec = 5;
-		timeout.tv_usec = 0;
-		fd_set writeFileDescriptor;
-		FD_ZERO(&writeFileDescriptor);
-		int32_t nfds = _socketDescriptor + 1;
-		if(nfds <= 0)
+		if(_socketDescriptor < 0)
 		{
 			throw SocketClosedException("Connection to client number closed (4).");
 		}
-		FD_SET(_socketDescriptor, &writeFileDescriptor);
-		int32_t readyFds = select(nfds, NULL, &writeFileDescriptor, NULL, &timeout);
-		if(readyFds == 0) throw SocketTimeOutException("Writing to socket timed out.");
+		int32_t readyFds = waitForSocket(POLLOUT, 5000);
+		if(readyFds == 0)
+		{
+			_bl->metrics.socketWriteTimeouts->increment();
+			throw SocketTimeOutException("Writing to socket timed out.");
+		}
 		if(readyFds != 1) throw SocketClosedException("Connection to client number closed (5).");
 
 		int32_t bytesWritten = send(_socketDescriptor, &data.at(totalBytesWritten), data.size() - totalBytesWritten, MSG_NOSIGNAL);
@@ -161,48 +200,47 @@ int32_t SocketOperations::proofwrite(const std::vector<char>& data)
 		}
 		totalBytesWritten += bytesWritten;
 	}
+	_bl->metrics.socketBytesWritten->increment(totalBytesWritten);
 	return totalBytesWritten;
 }
 
 int32_t SocketOperations::proofwrite(const std::string& data)
 {
-
-	GD::out.printDebug("Debug: Calling proofwrite ...", 6);
+	HGADDON_TRACE_SPAN(_bl->tracer, "proofwrite");
+	HGADDON_PRINT_DEBUG_LEVEL(_bl->out, "Debug: Calling proofwrite ...", 6);
 	if(!_socketDescriptor) throw SocketOperationException("Socket descriptor is nullptr.");
 	if(!connected()) autoConnect();
 	if(data.empty()) return 0;
 	if(data.size() > 10485760) throw SocketDataLimitException("Data size is larger than 10 MiB.");
-	GD::out.printDebug("Debug: ... data size is " + std::to_string(data.size()), 6);
+	HGADDON_PRINT_DEBUG_LEVEL(_bl->out, "Debug: ... data size is " + std::to_string(data.size()), 6);
 
 	int32_t bytesSentSoFar = 0;
 	while (bytesSentSoFar < (signed)data.size())
 	{
-		timeval timeout;
-		timeout.tv_sec = 5;
-		timeout.tv_usec = 0;
-		fd_set writeFileDescriptor;
-		FD_ZERO(&writeFileDescriptor);
-		int32_t nfds = _socketDescriptor + 1;
-		if(nfds <= 0)
+		if(_socketDescriptor < 0)
 		{
 			throw SocketClosedException("Connection to client number closed (6).");
 		}
-		FD_SET(_socketDescriptor, &writeFileDescriptor);
-		int32_t readyFds = select(nfds, NULL, &writeFileDescriptor, NULL, &timeout);
-		if(readyFds == 0) throw SocketTimeOutException("Writing to socket timed out.");
+		int32_t readyFds = waitForSocket(POLLOUT, 5000);
+		if(readyFds == 0)
+		{
+			_bl->metrics.socketWriteTimeouts->increment();
+			throw SocketTimeOutException("Writing to socket timed out.");
+		}
 		if(readyFds != 1) throw SocketClosedException("Connection to client number closed (7).");
 
 		int32_t bytesToSend = data.size() - bytesSentSoFar;
 		int32_t bytesSentInStep = send(_socketDescriptor, &data.at(bytesSentSoFar), bytesToSend, MSG_NOSIGNAL);
 		if(bytesSentInStep <= 0)
 		{
-			GD::out.printDebug("Debug: ... exception at " + std::to_string(bytesSentSoFar) + " error is " + strerror(errno));
+			HGADDON_PRINT_DEBUG(_bl->out, "Debug: ... exception at " + std::to_string(bytesSentSoFar) + " error is " + strerror(errno));
 			close();
 			throw SocketOperationException(strerror(errno));
 		}
 		bytesSentSoFar += bytesSentInStep;
 	}
-	GD::out.printDebug("Debug: ... sent " + std::to_string(bytesSentSoFar), 6);
+	HGADDON_PRINT_DEBUG_LEVEL(_bl->out, "Debug: ... sent " + std::to_string(bytesSentSoFar), 6);
+	_bl->metrics.socketBytesWritten->increment(bytesSentSoFar);
 	return bytesSentSoFar;
 }
 
@@ -216,11 +254,24 @@ bool SocketOperations::connected()
 
 void SocketOperations::getSocketDescriptor()
 {
-	GD::out.printDebug("Debug: Calling getFileDescriptor...");
+	HGADDON_PRINT_DEBUG(_bl->out, "Debug: Calling getFileDescriptor...");
 	shutdown();
 
-	getConnection();
-	if(_socketDescriptor < 0) throw SocketOperationException("Could not connect to server.");
+	try
+	{
+		getConnection();
+	}
+	catch(...)
+	{
+		_bl->metrics.socketConnectErrors->increment();
+		throw;
+	}
+	if(_socketDescriptor < 0)
+	{
+		_bl->metrics.socketConnectErrors->increment();
+		throw SocketOperationException("Could not connect to server.");
+	}
+	_bl->metrics.socketConnects->increment();
 }
 
 void SocketOperations::getConnection()
@@ -228,147 +279,122 @@ void SocketOperations::getConnection()
 	if(_hostname.empty()) throw SocketInvalidParametersException("Hostname is empty");
 	if(_port.empty()) throw SocketInvalidParametersException("Port is empty");
 
-	GD::out.printInfo("Info: Connecting to host " + _hostname + " on port " + _port + "...");
+	HGADDON_PRINT_INFO(_bl->out, "Info: Connecting to host " + _hostname + " on port " + _port + "...");
 
-	//Retry for two minutes
-	for(uint32_t i = 0; i < 6; ++i)
-	{
-		struct addrinfo *serverInfo = nullptr;
-		struct addrinfo hostInfo;
-		memset(&hostInfo, 0, sizeof hostInfo);
+	struct addrinfo *serverInfo = nullptr;
+	struct addrinfo hostInfo;
+	memset(&hostInfo, 0, sizeof hostInfo);
 
-		hostInfo.ai_family = AF_UNSPEC;
-		hostInfo.ai_socktype = SOCK_STREAM;
+	hostInfo.ai_family = AF_UNSPEC;
+	hostInfo.ai_socktype = SOCK_STREAM;
 
-		if(getaddrinfo(_hostname.c_str(), _port.c_str(), &hostInfo, &serverInfo) != 0)
-		{
-			freeaddrinfo(serverInfo);
-			throw SocketOperationException("Could not get address information: " + std::string(strerror(errno)));
-		}
+	if(getaddrinfo(_hostname.c_str(), _port.c_str(), &hostInfo, &serverInfo) != 0)
+	{
+		freeaddrinfo(serverInfo);
+		throw SocketOperationException("Could not get address information: " + std::string(strerror(errno)));
+	}
 
-		char ipStringBuffer[INET6_ADDRSTRLEN];
-		if (serverInfo->ai_family == AF_INET) {
-			struct sockaddr_in *s = (struct sockaddr_in *)serverInfo->ai_addr;
-			inet_ntop(AF_INET, &s->sin_addr, ipStringBuffer, sizeof(ipStringBuffer));
-		} else { // AF_INET6
-			struct sockaddr_in6 *s = (struct sockaddr_in6 *)serverInfo->ai_addr;
-			inet_ntop(AF_INET6, &s->sin6_addr, ipStringBuffer, sizeof(ipStringBuffer));
-		}
-		std::string ipAddress = std::string(&ipStringBuffer[0]);
+	char ipStringBuffer[INET6_ADDRSTRLEN];
+	if (serverInfo->ai_family == AF_INET) {
+		struct sockaddr_in *s = (struct sockaddr_in *)serverInfo->ai_addr;
+		inet_ntop(AF_INET, &s->sin_addr, ipStringBuffer, sizeof(ipStringBuffer));
+	} else { // AF_INET6
+		struct sockaddr_in6 *s = (struct sockaddr_in6 *)serverInfo->ai_addr;
+		inet_ntop(AF_INET6, &s->sin6_addr, ipStringBuffer, sizeof(ipStringBuffer));
+	}
+	std::string ipAddress = std::string(&ipStringBuffer[0]);
 
-		_socketDescriptor = socket(serverInfo->ai_family, serverInfo->ai_socktype, serverInfo->ai_protocol);
-		if(_socketDescriptor == -1)
-		{
-			freeaddrinfo(serverInfo);
-			throw SocketOperationException("Could not create socket for server " + ipAddress + " on port " + _port + ": " + strerror(errno));
-		}
-		int32_t optValue = 1;
-		if(setsockopt(_socketDescriptor, SOL_SOCKET, SO_KEEPALIVE, (void*)&optValue, sizeof(int32_t)) == -1)
+	_socketDescriptor = socket(serverInfo->ai_family, serverInfo->ai_socktype, serverInfo->ai_protocol);
+	if(_socketDescriptor == -1)
+	{
+		freeaddrinfo(serverInfo);
+		throw SocketOperationException("Could not create socket for server " + ipAddress + " on port " + _port + ": " + strerror(errno));
+	}
+	int32_t optValue = 1;
+	if(setsockopt(_socketDescriptor, SOL_SOCKET, SO_KEEPALIVE, (void*)&optValue, sizeof(int32_t)) == -1)
+	{
+		freeaddrinfo(serverInfo);
+		shutdown();
+		throw SocketOperationException("Could not set socket options for server " + ipAddress + " on port " + _port + ": " + strerror(errno));
+	}
+	optValue = 30;
+	if(setsockopt(_socketDescriptor, SOL_TCP, TCP_KEEPIDLE, (void*)&optValue, sizeof(int32_t)) == -1)
+	{
+		freeaddrinfo(serverInfo);
+		shutdown();
+		throw SocketOperationException("Could not set socket options for server " + ipAddress + " on port " + _port + ": " + strerror(errno));
+	}
+	optValue = 4;
+	if(setsockopt(_socketDescriptor, SOL_TCP, TCP_KEEPCNT, (void*)&optValue, sizeof(int32_t)) == -1)
+	{
+		freeaddrinfo(serverInfo);
+		shutdown();
+		throw SocketOperationException("Could not set socket options for server " + ipAddress + " on port " + _port + ": " + strerror(errno));
+	}
+	optValue = 15;
+	if(setsockopt(_socketDescriptor, SOL_TCP, TCP_KEEPINTVL, (void*)&optValue, sizeof(int32_t)) == -1)
+	{
+		freeaddrinfo(serverInfo);
+		shutdown();
+		throw SocketOperationException("Could not set socket options for server " + ipAddress + " on port " + _port + ": " + strerror(errno));
+	}
+
+	if(!(fcntl(_socketDescriptor, F_GETFL) & O_NONBLOCK))
+	{
+		if(fcntl(_socketDescriptor, F_SETFL, fcntl(_socketDescriptor, F_GETFL) | O_NONBLOCK) < 0)
 		{
 			freeaddrinfo(serverInfo);
 			shutdown();
 			throw SocketOperationException("Could not set socket options for server " + ipAddress + " on port " + _port + ": " + strerror(errno));
 		}
-		optValue = 30;
-		if(setsockopt(_socketDescriptor, SOL_TCP, TCP_KEEPIDLE, (void*)&optValue, sizeof(int32_t)) == -1)
+	}
+
+	int32_t connectResult;
+	if((connectResult = connect(_socketDescriptor, serverInfo->ai_addr, serverInfo->ai_addrlen)) == -1 && errno != EINPROGRESS)
+	{
+		freeaddrinfo(serverInfo);
+		shutdown();
+		throw SocketTimeOutException("Connecting to server " + ipAddress + " on port " + _port + " timed out: " + strerror(errno));
+	}
+	freeaddrinfo(serverInfo);
+
+	if(connectResult != 0) //We have to wait for the connection
+	{
+		int32_t pollResult;
+		try
 		{
-			freeaddrinfo(serverInfo);
-			shutdown();
-			throw SocketOperationException("Could not set socket options for server " + ipAddress + " on port " + _port + ": " + strerror(errno));
+			pollResult = waitForSocket(POLLOUT, 5000);
 		}
-		optValue = 4;
-		if(setsockopt(_socketDescriptor, SOL_TCP, TCP_KEEPCNT, (void*)&optValue, sizeof(int32_t)) == -1)
+		catch(const SocketInterruptedException& ex)
 		{
-			freeaddrinfo(serverInfo);
 			shutdown();
-			throw SocketOperationException("Could not set socket options for server " + ipAddress + " on port " + _port + ": " + strerror(errno));
+			throw;
 		}
-		optValue = 15;
-		if(setsockopt(_socketDescriptor, SOL_TCP, TCP_KEEPINTVL, (void*)&optValue, sizeof(int32_t)) == -1)
+		if(pollResult < 0)
 		{
-			freeaddrinfo(serverInfo);
 			shutdown();
-			throw SocketOperationException("Could not set socket options for server " + ipAddress + " on port " + _port + ": " + strerror(errno));
-		}
-
-		if(!(fcntl(_socketDescriptor, F_GETFL) & O_NONBLOCK))
-		{
-			if(fcntl(_socketDescriptor, F_SETFL, fcntl(_socketDescriptor, F_GETFL) | O_NONBLOCK) < 0)
-			{
-				freeaddrinfo(serverInfo);
-				shutdown();
-				throw SocketOperationException("Could not set socket options for server " + ipAddress + " on port " + _port + ": " + strerror(errno));
-			}
+			throw SocketTimeOutException("Could not connect to server " + ipAddress + " on port " + _port + ". Poll failed with error code: " + std::to_string(pollResult) + ".");
 		}
-
-		int32_t connectResult;
-		if((connectResult = connect(_socketDescriptor, serverInfo->ai_addr, serverInfo->ai_addrlen)) == -1 && errno != EINPROGRESS)
+		else if(pollResult > 0)
 		{
-			if(i < 5)
+			socklen_t resultLength = sizeof(connectResult);
+			if(getsockopt(_socketDescriptor, SOL_SOCKET, SO_ERROR, &connectResult, &resultLength) < 0)
 			{
-				freeaddrinfo(serverInfo);
 				shutdown();
-				std::this_thread::sleep_for(std::chrono::milliseconds(3000));
-				continue;
+				throw SocketOperationException("Could not connect to server " + ipAddress + " on port " + _port + ": " + strerror(errno) + ".");
 			}
-			else
+			if(connectResult != 0)
 			{
-				freeaddrinfo(serverInfo);
 				shutdown();
-				throw SocketTimeOutException("Connecting to server " + ipAddress + " on port " + _port + " timed out: " + strerror(errno));
+				throw SocketOperationException("Could not connect to server " + ipAddress + " on port " + _port + ": " + strerror(connectResult) + ".");
 			}
 		}
-		freeaddrinfo(serverInfo);
-
-		if(connectResult != 0) //We have to wait for the connection
+		else if(pollResult == 0)
 		{
-			pollfd pollstruct
-			{
-				(int)_socketDescriptor,
-				(short)(POLLIN | POLLOUT | POLLERR),
-				(short)0
-			};
-
-			int32_t pollResult = poll(&pollstruct, 1, 5000);
-			if(pollResult < 0 || (pollstruct.revents & POLLERR))
-			{
-				if(i < 5)
-				{
-					shutdown();
-					std::this_thread::sleep_for(std::chrono::milliseconds(3000));
-					continue;
-				}
-				else
-				{
-					shutdown();
-					throw SocketTimeOutException("Could not connect to server " + ipAddress + " on port " + _port + ". Poll failed with error code: " + std::to_string(pollResult) + ".");
-				}
-			}
-			else if(pollResult > 0)
-			{
-				socklen_t resultLength = sizeof(connectResult);
-				if(getsockopt(_socketDescriptor, SOL_SOCKET, SO_ERROR, &connectResult, &resultLength) < 0)
-				{
-					shutdown();
-					throw SocketOperationException("Could not connect to server " + ipAddress + " on port " + _port + ": " + strerror(errno) + ".");
-				}
-				break;
-			}
-			else if(pollResult == 0)
-			{
-				if(i < 5)
-				{
-					shutdown();
-					continue;
-				}
-				else
-				{
-					shutdown();
-					throw SocketTimeOutException("Connecting to server " + ipAddress + " on port " + _port + " timed out.");
-				}
-			}
+			shutdown();
+			throw SocketTimeOutException("Connecting to server " + ipAddress + " on port " + _port + " timed out.");
 		}
 	}
-	GD::out.printInfo("Info: Connected to host " + _hostname + " on port " + _port + ".");
+	HGADDON_PRINT_INFO(_bl->out, "Info: Connected to host " + _hostname + " on port " + _port + ".");
 }
 }
@@ -56,10 +56,13 @@
 #include <sys/socket.h>
 #include <errno.h>
 #include <poll.h>
+#include <sys/eventfd.h>
 #include <signal.h>
 
 namespace HgAddonLib
 {
+class SharedObjects;
+
 class SocketOperationException : public Exception
 {
 public:
@@ -84,6 +87,12 @@ public:
 	SocketClosedException(std::string message) : SocketOperationException(message) {}
 };
 
+class SocketInterruptedException : public SocketOperationException
+{
+public:
+	SocketInterruptedException(std::string message) : SocketOperationException(message) {}
+};
+
 class SocketInvalidParametersException : public SocketOperationException
 {
 public:
@@ -96,18 +105,39 @@ public:
 	SocketDataLimitException(std::string message) : SocketOperationException(message) {}
 };
 
+/**
+ * Wakes up blocking socket operations. While set, all waits of sockets using the descriptor are aborted with SocketInterruptedException.
+ */
+class InterruptDescriptor
+{
+public:
+	InterruptDescriptor(SharedObjects* bl);
+	virtual ~InterruptDescriptor();
+
+	int32_t descriptor() { return _descriptor; }
+	void set();
+	void reset();
+private:
+	SharedObjects* _bl = nullptr;
+	int32_t _descriptor = -1;
+
+	InterruptDescriptor(const InterruptDescriptor&);
+	InterruptDescriptor& operator=(const InterruptDescriptor&);
+};
+
 class SocketOperations
 {
 public:
-	SocketOperations();
-	SocketOperations(int32_t socketDescriptor);
-	SocketOperations(std::string hostname, std::string port);
+	SocketOperations(SharedObjects* bl);
+	SocketOperations(SharedObjects* bl, int32_t socketDescriptor);
+	SocketOperations(SharedObjects* bl, std::string hostname, std::string port);
 	virtual ~SocketOperations();
 
 	void setReadTimeout(int64_t timeout) { _readTimeout = timeout; }
 	void setAutoConnect(bool autoConnect) { _autoConnect = autoConnect; }
 	void setHostname(std::string hostname) { close(); _hostname = hostname; }
 	void setPort(std::string port) { close(); _port = port; }
+	void setInterruptDescriptor(int32_t descriptor) { _interruptDescriptor = descriptor; }
 
 	bool connected();
 	int32_t proofread(char* buffer, int32_t bufferSize);
@@ -118,14 +148,17 @@ public:
 	void close();
 	void shutdown();
 protected:
+	SharedObjects* _bl = nullptr;
 	int64_t _readTimeout = 15000000;
 	bool _autoConnect = true;
 	std::string _hostname;
 	std::string _port;
 
 	int32_t _socketDescriptor = -1;
+	int32_t _interruptDescriptor = -1;
 
 	void getSocketDescriptor();
+	int32_t waitForSocket(short events, int32_t timeout);
 	void getConnection();
 	void autoConnect();
 };
@@ -0,0 +1,99 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "ThreadPool.h"
+
+namespace HgAddonLib
+{
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+	if(threadCount == 0) threadCount = 1;
+	for(uint32_t i = 0; i < threadCount; i++)
+	{
+		_threads.push_back(std::thread(&ThreadPool::worker, this));
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	try
+	{
+		{
+			std::lock_guard<std::mutex> queueGuard(_queueMutex);
+			_stop = true;
+		}
+		_queueConditionVariable.notify_all();
+		for(std::vector<std::thread>::iterator i = _threads.begin(); i != _threads.end(); ++i)
+		{
+			if(i->joinable()) i->join();
+		}
+	}
+	catch(const std::exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+}
+
+std::future<void> ThreadPool::enqueue(std::function<void()> function)
+{
+	std::shared_ptr<std::packaged_task<void()>> task(new std::packaged_task<void()>(function));
+	std::future<void> future = task->get_future();
+	{
+		std::lock_guard<std::mutex> queueGuard(_queueMutex);
+		_queue.push(task);
+	}
+	_queueConditionVariable.notify_one();
+	return future;
+}
+
+void ThreadPool::worker()
+{
+	while(true)
+	{
+		std::shared_ptr<std::packaged_task<void()>> task;
+		{
+			std::unique_lock<std::mutex> queueGuard(_queueMutex);
+			_queueConditionVariable.wait(queueGuard, [&]{ return _stop || !_queue.empty(); });
+			if(_queue.empty()) return; //_stop is true and all queued functions are done
+			task = _queue.front();
+			_queue.pop();
+		}
+		//Exceptions are stored in the future by packaged_task.
+		(*task)();
+	}
+}
+}
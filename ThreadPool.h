@@ -0,0 +1,87 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <vector>
+#include <queue>
+
+#include "Output.h"
+
+namespace HgAddonLib
+{
+/**
+ * Fixed size pool of worker threads executing queued functions in FIFO order.
+ */
+class ThreadPool
+{
+public:
+	/**
+	 * Constructor. Starts the worker threads.
+	 *
+	 * @param threadCount The number of worker threads. At least one thread is started.
+	 */
+	ThreadPool(uint32_t threadCount);
+
+	/**
+	 * Destructor. Finishes all queued functions and joins the worker threads.
+	 */
+	virtual ~ThreadPool();
+
+	/**
+	 * Returns the number of worker threads.
+	 */
+	uint32_t size() { return _threads.size(); }
+
+	/**
+	 * Queues a function for execution.
+	 *
+	 * @param function The function to execute.
+	 * @return Returns a future, which becomes ready when the function has been executed.
+	 */
+	std::future<void> enqueue(std::function<void()> function);
+private:
+	Output _out;
+	bool _stop = false;
+	std::mutex _queueMutex;
+	std::condition_variable _queueConditionVariable;
+	std::queue<std::shared_ptr<std::packaged_task<void()>>> _queue;
+	std::vector<std::thread> _threads;
+
+	void worker();
+};
+}
+#endif
@@ -0,0 +1,311 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "TimerWheel.h"
+#include "SharedObjects.h"
+
+namespace HgAddonLib
+{
+TimerWheel::TimerWheel(SharedObjects* bl)
+{
+	_bl = bl;
+	_startTime = std::chrono::steady_clock::now();
+}
+
+TimerWheel::~TimerWheel()
+{
+	stop();
+}
+
+uint64_t TimerWheel::getTick()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _startTime).count();
+}
+
+uint64_t TimerWheel::add(uint32_t delay, std::function<void()> callback, uint32_t interval)
+{
+	try
+	{
+		if(!callback) return 0;
+		PTimer timer(new Timer());
+		timer->expires = getTick() + delay;
+		timer->interval = interval;
+		timer->callback = callback;
+		{
+			std::lock_guard<std::mutex> timersGuard(_timersMutex);
+			timer->id = ++_currentId;
+			_timers[timer->id] = timer;
+			insert(timer);
+			if(!_thread.joinable())
+			{
+				_stop = false;
+				_thread = std::thread(&TimerWheel::timerThread, this);
+			}
+		}
+		_timersConditionVariable.notify_one();
+		return timer->id;
+	}
+	catch(const std::exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+	return 0;
+}
+
+bool TimerWheel::remove(uint64_t id)
+{
+	try
+	{
+		//"0" is returned by "add" on failure and is the value of "_runningId" while no callback is executing.
+		if(id == 0) return false;
+		std::unique_lock<std::mutex> timersGuard(_timersMutex);
+		bool removed = false;
+		std::unordered_map<uint64_t, PTimer>::iterator timerIterator = _timers.find(id);
+		if(timerIterator != _timers.end())
+		{
+			//The timer stays in its slot until the slot is processed.
+			timerIterator->second->callback = std::function<void()>();
+			_timers.erase(timerIterator);
+			removed = true;
+		}
+		//Expired non repeating timers are not in "_timers" anymore, but their callback might still be executing.
+		else if(_runningId != id) return false;
+		if(_runningId == id && std::this_thread::get_id() != _thread.get_id())
+		{
+			_callbackConditionVariable.wait(timersGuard, [&]{ return _runningId != id; });
+		}
+		return removed;
+	}
+	catch(const std::exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+	return false;
+}
+
+void TimerWheel::stop()
+{
+	try
+	{
+		{
+			std::lock_guard<std::mutex> timersGuard(_timersMutex);
+			_stop = true;
+			_timers.clear();
+			for(uint32_t level = 0; level < _levelCount; level++)
+			{
+				for(uint32_t slot = 0; slot < _slotCount; slot++)
+				{
+					_wheel[level][slot].clear();
+				}
+			}
+		}
+		_timersConditionVariable.notify_one();
+		if(!_thread.joinable()) return;
+		if(std::this_thread::get_id() == _thread.get_id()) _thread.detach();
+		else _thread.join();
+	}
+	catch(const std::exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+}
+
+void TimerWheel::insert(PTimer& timer)
+{
+	if(timer->expires <= _currentTick) timer->expires = _currentTick + 1;
+	uint64_t difference = timer->expires - _currentTick;
+	uint64_t tick = timer->expires;
+	uint32_t level = 0;
+	while(level < _levelCount - 1 && difference >= (1ull << (_levelBits * (level + 1)))) level++;
+	//Timers beyond the range of the wheel are put into the last slot reachable and reinserted when that slot is cascaded.
+	if(difference >= (1ull << (_levelBits * _levelCount))) tick = _currentTick + (1ull << (_levelBits * _levelCount)) - 1;
+	_wheel[level][(tick >> (_levelBits * level)) & _slotMask].push_back(timer);
+}
+
+void TimerWheel::cascade(uint32_t level)
+{
+	std::vector<PTimer> timers;
+	timers.swap(_wheel[level][(_currentTick >> (_levelBits * level)) & _slotMask]);
+	for(std::vector<PTimer>::iterator i = timers.begin(); i != timers.end(); ++i)
+	{
+		if((*i)->callback) insert(*i);
+	}
+}
+
+uint64_t TimerWheel::getNextTick()
+{
+	uint64_t nextTick = (uint64_t)-1;
+	for(uint32_t i = 1; i <= _slotCount; i++)
+	{
+		uint64_t tick = _currentTick + i;
+		if(!_wheel[0][tick & _slotMask].empty())
+		{
+			nextTick = tick;
+			break;
+		}
+	}
+	//Slots of higher levels need to be cascaded when the lower levels wrap around.
+	for(uint32_t level = 1; level < _levelCount; level++)
+	{
+		uint32_t shift = _levelBits * level;
+		for(uint32_t i = 1; i <= _slotCount; i++)
+		{
+			uint64_t tick = ((_currentTick >> shift) + i) << shift;
+			if(tick >= nextTick) break;
+			if(!_wheel[level][(tick >> shift) & _slotMask].empty())
+			{
+				nextTick = tick;
+				break;
+			}
+		}
+	}
+	return nextTick;
+}
+
+void TimerWheel::collect(uint64_t now, std::vector<PTimer>& expiredTimers)
+{
+	while(_currentTick < now)
+	{
+		uint64_t nextTick = getNextTick();
+		if(nextTick > now)
+		{
+			//Nothing happens in between, so empty ticks are skipped.
+			_currentTick = now;
+			break;
+		}
+		_currentTick = nextTick;
+		for(uint32_t level = _levelCount - 1; level > 0; level--)
+		{
+			if((_currentTick & ((1ull << (_levelBits * level)) - 1)) == 0) cascade(level);
+		}
+		std::vector<PTimer> timers;
+		timers.swap(_wheel[0][_currentTick & _slotMask]);
+		for(std::vector<PTimer>::iterator i = timers.begin(); i != timers.end(); ++i)
+		{
+			if(!(*i)->callback) continue;
+			expiredTimers.push_back(*i);
+			if((*i)->interval > 0)
+			{
+				//Based on the planned time, so repeating timers don't drift.
+				(*i)->expires += (*i)->interval;
+				insert(*i);
+			}
+			else _timers.erase((*i)->id);
+		}
+	}
+}
+
+void TimerWheel::timerThread()
+{
+	std::unique_lock<std::mutex> timersGuard(_timersMutex);
+	while(!_stop)
+	{
+		try
+		{
+			std::vector<PTimer> expiredTimers;
+			collect(getTick(), expiredTimers);
+			if(!expiredTimers.empty())
+			{
+				for(std::vector<PTimer>::iterator i = expiredTimers.begin(); i != expiredTimers.end(); ++i)
+				{
+					//Removed in the meantime?
+					if(_stop || !(*i)->callback) continue;
+					std::function<void()> callback = (*i)->callback;
+					_runningId = (*i)->id;
+					timersGuard.unlock();
+					try
+					{
+						callback();
+					}
+					catch(const std::exception& ex)
+					{
+						_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+					}
+					catch(Exception& ex)
+					{
+						_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+					}
+					catch(...)
+					{
+						_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+					}
+					timersGuard.lock();
+					_runningId = 0;
+					_callbackConditionVariable.notify_all();
+				}
+				continue;
+			}
+			uint64_t nextTick = getNextTick();
+			if(nextTick == (uint64_t)-1) _timersConditionVariable.wait(timersGuard);
+			else _timersConditionVariable.wait_until(timersGuard, _startTime + std::chrono::milliseconds(nextTick));
+		}
+		//The timers are unlocked while logging, because logging an error can add a timer (see FlightRecorder::errorOccurred).
+		catch(const std::exception& ex)
+		{
+			if(timersGuard.owns_lock()) timersGuard.unlock();
+			_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+		}
+		catch(Exception& ex)
+		{
+			if(timersGuard.owns_lock()) timersGuard.unlock();
+			_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+		}
+		catch(...)
+		{
+			if(timersGuard.owns_lock()) timersGuard.unlock();
+			_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+		}
+		if(!timersGuard.owns_lock()) timersGuard.lock();
+	}
+}
+}
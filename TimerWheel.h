@@ -0,0 +1,119 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef TIMERWHEEL_H_
+#define TIMERWHEEL_H_
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+namespace HgAddonLib
+{
+class SharedObjects;
+
+/**
+ * Hierarchical timer wheel on the monotonic clock. One thread executes all timers, so callbacks should return quickly. Adding and removing
+ * timers is O(1). The resolution is one millisecond.
+ */
+class TimerWheel
+{
+public:
+	TimerWheel(SharedObjects* bl);
+
+	/**
+	 * Destructor. Stops the timer thread. Pending timers are not executed.
+	 */
+	virtual ~TimerWheel();
+
+	/**
+	 * Adds a timer. The timer thread is started on first use.
+	 *
+	 * @param delay The time in milliseconds until the callback is executed.
+	 * @param callback The function to execute. It is executed on the timer thread.
+	 * @param interval When not "0" the timer is repeated every "interval" milliseconds until it is removed.
+	 * @return Returns the id of the timer needed to remove it. The id is never "0".
+	 */
+	uint64_t add(uint32_t delay, std::function<void()> callback, uint32_t interval = 0);
+
+	/**
+	 * Removes a timer. If the callback of the timer is executing on another thread, the method waits until it has returned. When called
+	 * from within a callback, it returns immediately.
+	 *
+	 * @param id The id returned by "add". "0" (returned by "add" on failure) is ignored.
+	 * @return Returns true when the timer was pending. Returns false for unknown ids and expired non repeating timers.
+	 */
+	bool remove(uint64_t id);
+
+	/**
+	 * Removes all timers and stops the timer thread.
+	 */
+	void stop();
+private:
+	struct Timer
+	{
+		uint64_t id = 0;
+		uint64_t expires = 0;
+		uint32_t interval = 0;
+		std::function<void()> callback;
+	};
+	typedef std::shared_ptr<Timer> PTimer;
+
+	static const uint32_t _levelBits = 6;
+	static const uint32_t _slotCount = 1 << _levelBits;
+	static const uint32_t _slotMask = _slotCount - 1;
+	static const uint32_t _levelCount = 4;
+
+	SharedObjects* _bl = nullptr;
+	std::chrono::steady_clock::time_point _startTime;
+	std::mutex _timersMutex;
+	std::condition_variable _timersConditionVariable;
+	std::condition_variable _callbackConditionVariable;
+	bool _stop = false;
+	std::thread _thread;
+	uint64_t _currentTick = 0;
+	uint64_t _currentId = 0;
+	uint64_t _runningId = 0;
+	std::unordered_map<uint64_t, PTimer> _timers;
+	std::vector<PTimer> _wheel[_levelCount][_slotCount];
+
+	uint64_t getTick();
+	void insert(PTimer& timer);
+	void cascade(uint32_t level);
+	uint64_t getNextTick();
+	void collect(uint64_t now, std::vector<PTimer>& expiredTimers);
+	void timerThread();
+};
+}
+#endif
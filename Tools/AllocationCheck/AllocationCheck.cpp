@@ -0,0 +1,244 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+/*
+ * Counts the heap allocations per operation on the hot paths of the library (decoding, encoding, event dispatch and invoke) and compares
+ * them with ceilings. Most of the cost per event is heap traffic, so the tool is meant to run after every change: it exits with code 1,
+ * when an operation allocates more than its ceiling. When a change reduces the allocations of an operation, lower its baseline in the
+ * table below, so they can't creep back up unnoticed.
+ *
+ * The baselines are the counts measured with GCC and libstdc++ on x86-64 Linux. Other standard libraries allocate differently (e.g. for
+ * short strings or the nodes of std::map), so the ceiling of an operation is its baseline plus a tolerance (10 % by default, rounded up).
+ * Operations with a baseline of "0" get no tolerance: they only reuse buffers, which doesn't depend on the standard library. Use
+ * "--tolerance 0" with the reference toolchain to notice every additional allocation.
+ *
+ * Only the allocations of the thread executing the operation are counted, the threads of the library and of the Homegear stand-in are
+ * ignored.
+ *
+ * Usage: homegear-addon-allocation-check [OPTIONS]
+ *   -f, --filter TEXT          Only check operations whose name contains TEXT.
+ *   -n, --iterations COUNT     The number of times each operation is executed (default 1000).
+ *   -t, --tolerance PERCENT    The allocations an operation may exceed its baseline by (default 10).
+ */
+
+#include "Host.h"
+#include "Base.h"
+#include "Encoding/RPCDecoder.h"
+#include "Encoding/RPCEncoder.h"
+#include "Tools/Common/AllocationCounter.h"
+#include "Tools/Common/HomegearStandIn.h"
+
+#include <iostream>
+#include <iomanip>
+#include <functional>
+#include <cstdlib>
+#include <cmath>
+#include <getopt.h>
+
+using namespace HgAddonLib;
+
+namespace
+{
+struct Check
+{
+	std::string name;
+
+	/**
+	 * The number of allocations per operation with the reference toolchain.
+	 */
+	double baseline;
+
+	std::function<void()> operation;
+};
+
+class CheckAddon : public Base
+{
+public:
+	CheckAddon(std::shared_ptr<AddonHost> host) : Base(host, 1) {}
+	virtual ~CheckAddon() {}
+
+	uint64_t getEvents() { return _events; }
+
+	virtual void event(uint64_t peerId, int32_t channel, std::string parameter, PVariable value)
+	{
+		_events++;
+	}
+private:
+	std::atomic<uint64_t> _events{0};
+};
+
+//Written by the operations, so the compiler can't remove them.
+volatile int64_t sink = 0;
+
+PRPCList createEventParameters(int32_t peerId)
+{
+	return PRPCList(new RPCList{ PVariable(new Variable("HomegearAddon")), PVariable(new Variable(peerId)), PVariable(new Variable(1)), PVariable(new Variable("LEVEL")), PVariable(new Variable(0.5)) });
+}
+
+PRPCList createMulticallParameters(uint32_t eventCount)
+{
+	PVariable calls(new Variable(VariableType::rpcArray));
+	for(uint32_t i = 0; i < eventCount; i++)
+	{
+		PVariable call(new Variable(VariableType::rpcStruct));
+		call->structValue->insert(RPCStructElement("methodName", PVariable(new Variable("event"))));
+		PRPCList eventParameters = createEventParameters(1);
+		call->structValue->insert(RPCStructElement("params", PVariable(new Variable(PRPCArray(new RPCArray(eventParameters->begin(), eventParameters->end()))))));
+		calls->arrayValue->push_back(call);
+	}
+	return PRPCList(new RPCList{ calls });
+}
+
+PVariable createParamset(uint32_t size)
+{
+	PVariable paramset(new Variable(VariableType::rpcStruct));
+	for(uint32_t i = 0; i < size; i++) paramset->structValue->insert(RPCStructElement("PARAMETER_" + std::to_string(i), PVariable(new Variable(i * 0.5))));
+	return paramset;
+}
+
+void printUsage()
+{
+	std::cout << "Usage: homegear-addon-allocation-check [OPTIONS]" << std::endl;
+	std::cout << "  -f, --filter TEXT          Only check operations whose name contains TEXT." << std::endl;
+	std::cout << "  -n, --iterations COUNT     The number of times each operation is executed (default 1000)." << std::endl;
+	std::cout << "  -t, --tolerance PERCENT    The allocations an operation may exceed its baseline by (default 10)." << std::endl;
+}
+}
+
+int main(int argc, char** argv)
+{
+	std::string filter;
+	uint32_t iterations = 1000;
+	uint32_t tolerance = 10;
+
+	const option options[] =
+	{
+		{ "filter", required_argument, nullptr, 'f' },
+		{ "iterations", required_argument, nullptr, 'n' },
+		{ "tolerance", required_argument, nullptr, 't' },
+		{ "help", no_argument, nullptr, 'h' },
+		{ nullptr, 0, nullptr, 0 }
+	};
+	int32_t optionCharacter;
+	while((optionCharacter = getopt_long(argc, argv, "f:n:t:h", options, nullptr)) != -1)
+	{
+		switch(optionCharacter)
+		{
+		case 'f':
+			filter = optarg;
+			break;
+		case 'n':
+			iterations = std::max(1, std::atoi(optarg));
+			break;
+		case 't':
+			tolerance = std::max(0, std::atoi(optarg));
+			break;
+		default:
+			printUsage();
+			return optionCharacter == 'h' ? 0 : 1;
+		}
+	}
+	if(optind != argc)
+	{
+		printUsage();
+		return 1;
+	}
+
+	HomegearStandIn homegear(false);
+	if(!homegear.start()) return 1;
+	std::shared_ptr<AddonHost> host = std::make_shared<AddonHost>(homegear.getPort(), 2);
+	std::unique_ptr<CheckAddon> addon(new CheckAddon(host));
+
+	SharedObjects codecs;
+	codecs.debugLevel = 2;
+	RPCEncoder encoder(&codecs);
+	RPCDecoder decoder(&codecs);
+	std::vector<char> buffer;
+	buffer.reserve(65536);
+	std::vector<char> response;
+	response.reserve(65536);
+
+	PRPCList eventParameters = createEventParameters(1);
+	std::vector<char> eventRequest;
+	encoder.encodeRequest("event", eventParameters, eventRequest);
+	PRPCList multicallParameters = createMulticallParameters(10);
+	std::vector<char> multicallRequest;
+	encoder.encodeRequest("system.multicall", multicallParameters, multicallRequest);
+	PVariable voidResponse(new Variable());
+	PVariable paramset = createParamset(20);
+	std::vector<char> paramsetResponse;
+	encoder.encodeResponse(paramset, paramsetResponse);
+	PRPCList getValueParameters(new RPCList{ PVariable(new Variable(1)), PVariable(new Variable(1)), PVariable(new Variable("LEVEL")) });
+	PRPCList setValueParameters(new RPCList{ PVariable(new Variable(1)), PVariable(new Variable(1)), PVariable(new Variable("LEVEL")), PVariable(new Variable(0.5)) });
+
+	//The baselines are the counts with the reference toolchain (see above). Lower them when an operation gets cheaper.
+	std::vector<Check> checks
+	{
+		{ "rpc.decodeRequest.event", 36, [&]() { uint32_t offset = 0; uint32_t size = 0; sink = decoder.decodeRequest(eventRequest, offset, size)->size(); } },
+		{ "rpc.decodeRequest.multicall10", 596, [&]() { uint32_t offset = 0; uint32_t size = 0; sink = decoder.decodeRequest(multicallRequest, offset, size)->size(); } },
+		{ "rpc.decodeRequestStrict.event", 33, [&]() { uint32_t offset = 0; uint32_t size = 0; PRPCArray parameters; sink = (int64_t)decoder.decodeRequest(eventRequest.data(), eventRequest.size(), offset, size, parameters) + parameters->size(); } },
+		{ "rpc.decodeRequestStrict.multicall10", 520, [&]() { uint32_t offset = 0; uint32_t size = 0; PRPCArray parameters; sink = (int64_t)decoder.decodeRequest(multicallRequest.data(), multicallRequest.size(), offset, size, parameters) + parameters->size(); } },
+		{ "rpc.encodeRequest.event", 0, [&]() { encoder.encodeRequest("event", eventParameters, buffer); sink = buffer.size(); } },
+		{ "rpc.encodeResponse.void", 6, [&]() { encoder.encodeResponse(voidResponse, buffer); sink = buffer.size(); } },
+		{ "rpc.encodeResponse.paramset20", 0, [&]() { encoder.encodeResponse(paramset, buffer); sink = buffer.size(); } },
+		{ "rpc.decodeResponse.paramset20", 148, [&]() { sink = decoder.decodeResponse(paramsetResponse)->structValue->size(); } },
+		{ "rpc.decodeResponseStrict.paramset20", 146, [&]() { PVariable value; sink = (int64_t)decoder.decodeResponse(paramsetResponse.data(), paramsetResponse.size(), value) + value->structValue->size(); } },
+		{ "server.dispatch.event", 46, [&]() { buffer = eventRequest; host->processPacket(buffer, response); sink = response.size(); } },
+		{ "server.dispatch.multicall10", 673, [&]() { buffer = multicallRequest; host->processPacket(buffer, response); sink = response.size(); } },
+		{ "client.invoke.getValue", 6, [&]() { sink = addon->invoke("getValue", getValueParameters)->errorStruct; } },
+		{ "client.invoke.setValue", 6, [&]() { sink = addon->invoke("setValue", setValueParameters)->errorStruct; } },
+	};
+
+	bool passed = true;
+	std::cout << std::left << std::setw(36) << "Operation" << std::right << std::setw(12) << "allocs/op" << std::setw(12) << "bytes/op" << std::setw(12) << "baseline" << std::setw(12) << "ceiling" << std::endl;
+	for(const Check& check : checks)
+	{
+		if(!filter.empty() && check.name.find(filter) == std::string::npos) continue;
+		//Buffers and caches of the library are filled by the warm up.
+		for(uint32_t i = 0; i < 100; i++) check.operation();
+		AllocationCounter::start();
+		for(uint32_t i = 0; i < iterations; i++) check.operation();
+		AllocationCounter::stop();
+		double allocations = (double)AllocationCounter::getThreadAllocations() / iterations;
+		double allocatedBytes = (double)AllocationCounter::getThreadAllocatedBytes() / iterations;
+		double ceiling = std::ceil(check.baseline * (100 + tolerance) / 100);
+		bool exceeded = allocations > ceiling;
+		if(exceeded) passed = false;
+		std::cout << std::left << std::setw(36) << check.name << std::right << std::fixed << std::setprecision(2) << std::setw(12) << allocations << std::setw(12) << std::setprecision(1) << allocatedBytes << std::setw(12) << std::setprecision(2) << check.baseline << std::setw(12) << ceiling << (exceeded ? "  EXCEEDED" : "") << std::endl;
+	}
+	if(addon->getEvents() == 0 && filter.empty())
+	{
+		std::cout << "FAILED: No event was dispatched to the addon." << std::endl;
+		passed = false;
+	}
+	addon.reset();
+	host.reset();
+	if(!passed) std::cout << "FAILED: Operations allocate more than their ceiling." << std::endl;
+	return passed ? 0 : 1;
+}
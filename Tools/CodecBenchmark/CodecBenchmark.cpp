@@ -0,0 +1,486 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+/*
+ * Measures the binary RPC codec (RPCEncoder/RPCDecoder, the BinaryEncoder/BinaryDecoder primitives and the FloatCodec batch kernels) and
+ * the XML-RPC codec (XMLRPCEncoder/XMLRPCDecoder) over a corpus of payloads modeled after real Homegear traffic. For every benchmark the
+ * time per operation, the throughput in encoded bytes and the heap allocations per operation are reported. The CSV output is meant to be
+ * stored and compared across commits.
+ *
+ * Usage: homegear-addon-codec-benchmark [OPTIONS]
+ *   -f, --filter TEXT          Only run benchmarks whose name contains TEXT.
+ *   -t, --time MILLISECONDS    The minimum measuring time per benchmark (default 500).
+ *   -c, --csv                  Print the results as CSV.
+ *   -l, --list                 Print the names of the benchmarks and exit.
+ */
+
+#include "SharedObjects.h"
+#include "Encoding/RPCDecoder.h"
+#include "Encoding/RPCEncoder.h"
+#include "Encoding/XMLRPCDecoder.h"
+#include "Encoding/XMLRPCEncoder.h"
+#include "Encoding/BinaryDecoder.h"
+#include "Encoding/BinaryEncoder.h"
+#include "Encoding/FloatCodec.h"
+#include "Tools/Common/AllocationCounter.h"
+
+#include <iostream>
+#include <iomanip>
+#include <functional>
+#include <chrono>
+#include <cstdlib>
+#include <getopt.h>
+
+using namespace HgAddonLib;
+
+namespace
+{
+struct Benchmark
+{
+	std::string name;
+
+	/**
+	 * The number of encoded bytes processed per operation. Used to calculate the throughput.
+	 */
+	uint64_t bytesPerOperation;
+
+	std::function<void()> operation;
+};
+
+struct Result
+{
+	uint64_t operations = 0;
+	int64_t duration = 0;
+	uint64_t allocations = 0;
+	uint64_t allocatedBytes = 0;
+};
+
+//Written by the benchmarks, so the compiler can't remove the measured code.
+volatile int64_t sink = 0;
+
+PVariable createEventParameter(const std::string& id, int32_t peerId, const std::string& parameter, PVariable value)
+{
+	PVariable call(new Variable(VariableType::rpcStruct));
+	call->structValue->insert(RPCStructElement("methodName", PVariable(new Variable("event"))));
+	PVariable parameters(new Variable(VariableType::rpcArray));
+	parameters->arrayValue->push_back(PVariable(new Variable(id)));
+	parameters->arrayValue->push_back(PVariable(new Variable(peerId)));
+	parameters->arrayValue->push_back(PVariable(new Variable(1)));
+	parameters->arrayValue->push_back(PVariable(new Variable(parameter)));
+	parameters->arrayValue->push_back(value);
+	call->structValue->insert(RPCStructElement("params", parameters));
+	return call;
+}
+
+/**
+ * A "system.multicall" as Homegear sends it for a burst of events.
+ */
+PRPCList createMulticall(uint32_t eventCount)
+{
+	PVariable calls(new Variable(VariableType::rpcArray));
+	for(uint32_t i = 0; i < eventCount; i++)
+	{
+		PVariable value = (i % 3 == 0) ? PVariable(new Variable((bool)(i % 2))) : ((i % 3 == 1) ? PVariable(new Variable(0.25 * i)) : PVariable(new Variable((int32_t)i)));
+		calls->arrayValue->push_back(createEventParameter("HomegearAddon-1234", 100 + i % 40, (i % 3 == 0) ? "STATE" : ((i % 3 == 1) ? "LEVEL" : "WORKING"), value));
+	}
+	return PRPCList(new RPCList{ calls });
+}
+
+/**
+ * The response to "listDevices": one description per device and per channel.
+ */
+PVariable createListDevicesResponse(uint32_t deviceCount, uint32_t channelCount)
+{
+	PVariable devices(new Variable(VariableType::rpcArray));
+	for(uint32_t i = 0; i < deviceCount; i++)
+	{
+		std::string address = "MEQ" + std::to_string(1000000 + i);
+		for(int32_t channel = -1; channel < (int32_t)channelCount; channel++)
+		{
+			PVariable description(new Variable(VariableType::rpcStruct));
+			RPCStruct& fields = *description->structValue;
+			fields["ID"] = PVariable(new Variable((int32_t)(100 + i)));
+			fields["ADDRESS"] = PVariable(new Variable(channel == -1 ? address : address + ":" + std::to_string(channel)));
+			fields["TYPE"] = PVariable(new Variable(channel == -1 ? "HM-LC-Sw4-DR" : "SWITCH"));
+			fields["TYPE_ID"] = PVariable(new Variable((int32_t)0xC4));
+			fields["FAMILY"] = PVariable(new Variable(0));
+			fields["VERSION"] = PVariable(new Variable(13));
+			fields["FLAGS"] = PVariable(new Variable(1));
+			PVariable paramsets(new Variable(VariableType::rpcArray));
+			paramsets->arrayValue->push_back(PVariable(new Variable("MASTER")));
+			if(channel != -1) paramsets->arrayValue->push_back(PVariable(new Variable("VALUES")));
+			fields["PARAMSETS"] = paramsets;
+			if(channel == -1)
+			{
+				fields["FIRMWARE"] = PVariable(new Variable("2.8"));
+				fields["INTERFACE"] = PVariable(new Variable("HM-CFG-LAN-1"));
+				fields["RX_MODE"] = PVariable(new Variable(3));
+				fields["ROAMING"] = PVariable(new Variable(false));
+				PVariable children(new Variable(VariableType::rpcArray));
+				for(uint32_t j = 0; j < channelCount; j++) children->arrayValue->push_back(PVariable(new Variable(address + ":" + std::to_string(j))));
+				fields["CHILDREN"] = children;
+			}
+			else
+			{
+				fields["CHANNEL"] = PVariable(new Variable(channel));
+				fields["PARENT"] = PVariable(new Variable(address));
+				fields["PARENT_TYPE"] = PVariable(new Variable("HM-LC-Sw4-DR"));
+				fields["DIRECTION"] = PVariable(new Variable(2));
+				fields["LINK_SOURCE_ROLES"] = PVariable(new Variable(""));
+				fields["LINK_TARGET_ROLES"] = PVariable(new Variable("SWITCH"));
+			}
+			devices->arrayValue->push_back(description);
+		}
+	}
+	return devices;
+}
+
+/**
+ * The response to "getParamsetDescription" for a channel with many parameters.
+ */
+PVariable createParamsetDescriptionResponse(uint32_t parameterCount)
+{
+	PVariable paramset(new Variable(VariableType::rpcStruct));
+	for(uint32_t i = 0; i < parameterCount; i++)
+	{
+		PVariable parameter(new Variable(VariableType::rpcStruct));
+		RPCStruct& fields = *parameter->structValue;
+		std::string id = "PARAMETER_" + std::to_string(i);
+		fields["ID"] = PVariable(new Variable(id));
+		fields["TAB_ORDER"] = PVariable(new Variable((int32_t)i));
+		fields["OPERATIONS"] = PVariable(new Variable(7));
+		fields["FLAGS"] = PVariable(new Variable(1));
+		fields["UNIT"] = PVariable(new Variable(i % 2 ? "%" : "s"));
+		if(i % 3 == 0)
+		{
+			fields["TYPE"] = PVariable(new Variable("FLOAT"));
+			fields["MIN"] = PVariable(new Variable(0.0));
+			fields["MAX"] = PVariable(new Variable(1.01));
+			fields["DEFAULT"] = PVariable(new Variable(0.5));
+			PVariable special(new Variable(VariableType::rpcArray));
+			PVariable specialValue(new Variable(VariableType::rpcStruct));
+			specialValue->structValue->insert(RPCStructElement("ID", PVariable(new Variable("NOT_USED"))));
+			specialValue->structValue->insert(RPCStructElement("VALUE", PVariable(new Variable(1.01))));
+			special->arrayValue->push_back(specialValue);
+			fields["SPECIAL"] = special;
+		}
+		else if(i % 3 == 1)
+		{
+			fields["TYPE"] = PVariable(new Variable("ENUM"));
+			fields["MIN"] = PVariable(new Variable(0));
+			fields["MAX"] = PVariable(new Variable(3));
+			fields["DEFAULT"] = PVariable(new Variable(0));
+			PVariable valueList(new Variable(VariableType::rpcArray));
+			valueList->arrayValue->push_back(PVariable(new Variable("NONE")));
+			valueList->arrayValue->push_back(PVariable(new Variable("UP")));
+			valueList->arrayValue->push_back(PVariable(new Variable("DOWN")));
+			valueList->arrayValue->push_back(PVariable(new Variable("UNDEFINED")));
+			fields["VALUE_LIST"] = valueList;
+		}
+		else
+		{
+			fields["TYPE"] = PVariable(new Variable("BOOL"));
+			fields["MIN"] = PVariable(new Variable(false));
+			fields["MAX"] = PVariable(new Variable(true));
+			fields["DEFAULT"] = PVariable(new Variable(false));
+		}
+		paramset->structValue->insert(RPCStructElement(id, parameter));
+	}
+	return paramset;
+}
+
+/**
+ * Structs nested "depth" levels deep, each with a few scalar members and an array.
+ */
+PVariable createDeepStruct(uint32_t depth)
+{
+	PVariable child;
+	for(uint32_t i = 0; i < depth; i++)
+	{
+		PVariable level(new Variable(VariableType::rpcStruct));
+		level->structValue->insert(RPCStructElement("LEVEL", PVariable(new Variable((int32_t)i))));
+		level->structValue->insert(RPCStructElement("NAME", PVariable(new Variable("Level " + std::to_string(i)))));
+		level->structValue->insert(RPCStructElement("VALUE", PVariable(new Variable(i * 0.5))));
+		PVariable values(new Variable(VariableType::rpcArray));
+		for(int32_t j = 0; j < 4; j++) values->arrayValue->push_back(PVariable(new Variable(j)));
+		level->structValue->insert(RPCStructElement("VALUES", values));
+		if(child) level->structValue->insert(RPCStructElement("CHILD", child));
+		child = level;
+	}
+	return child;
+}
+
+Result run(const Benchmark& benchmark, int64_t minimumDuration)
+{
+	//Warm up and find the number of operations, which takes at least 10 ms.
+	uint64_t operations = 1;
+	while(true)
+	{
+		std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+		for(uint64_t i = 0; i < operations; i++) benchmark.operation();
+		int64_t duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+		if(duration >= 10000000)
+		{
+			operations = std::max((uint64_t)1, (uint64_t)((double)operations * minimumDuration / duration));
+			break;
+		}
+		operations *= 2;
+	}
+
+	Result result;
+	result.operations = operations;
+	AllocationCounter::start();
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	for(uint64_t i = 0; i < operations; i++) benchmark.operation();
+	result.duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+	AllocationCounter::stop();
+	result.allocations = AllocationCounter::getAllocations();
+	result.allocatedBytes = AllocationCounter::getAllocatedBytes();
+	return result;
+}
+
+void printUsage()
+{
+	std::cout << "Usage: homegear-addon-codec-benchmark [OPTIONS]" << std::endl;
+	std::cout << "  -f, --filter TEXT          Only run benchmarks whose name contains TEXT." << std::endl;
+	std::cout << "  -t, --time MILLISECONDS    The minimum measuring time per benchmark (default 500)." << std::endl;
+	std::cout << "  -c, --csv                  Print the results as CSV." << std::endl;
+	std::cout << "  -l, --list                 Print the names of the benchmarks and exit." << std::endl;
+}
+}
+
+int main(int argc, char** argv)
+{
+	std::string filter;
+	int64_t minimumDuration = 500;
+	bool csv = false;
+	bool list = false;
+
+	const option options[] =
+	{
+		{ "filter", required_argument, nullptr, 'f' },
+		{ "time", required_argument, nullptr, 't' },
+		{ "csv", no_argument, nullptr, 'c' },
+		{ "list", no_argument, nullptr, 'l' },
+		{ "help", no_argument, nullptr, 'h' },
+		{ nullptr, 0, nullptr, 0 }
+	};
+	int32_t optionCharacter;
+	while((optionCharacter = getopt_long(argc, argv, "f:t:clh", options, nullptr)) != -1)
+	{
+		switch(optionCharacter)
+		{
+		case 'f':
+			filter = optarg;
+			break;
+		case 't':
+			minimumDuration = std::max(1, std::atoi(optarg));
+			break;
+		case 'c':
+			csv = true;
+			break;
+		case 'l':
+			list = true;
+			break;
+		default:
+			printUsage();
+			return optionCharacter == 'h' ? 0 : 1;
+		}
+	}
+	if(optind != argc)
+	{
+		printUsage();
+		return 1;
+	}
+	minimumDuration *= 1000000;
+
+	SharedObjects bl;
+	bl.debugLevel = 2;
+	RPCEncoder rpcEncoder(&bl);
+	RPCDecoder rpcDecoder(&bl);
+	XMLRPCEncoder xmlRpcEncoder(&bl);
+	XMLRPCDecoder xmlRpcDecoder(&bl);
+	BinaryEncoder binaryEncoder(&bl);
+	BinaryDecoder binaryDecoder(&bl);
+	std::vector<Benchmark> benchmarks;
+
+	//Requests are encoded by the client and decoded by the server, responses the other way round. Both directions are measured for
+	//every payload, as both happen in an addon.
+	struct Request
+	{
+		std::string name;
+		std::string methodName;
+		PRPCList parameters;
+	};
+	std::vector<Request> requests
+	{
+		{ "event", "event", PRPCList(new RPCList{ PVariable(new Variable("HomegearAddon-1234")), PVariable(new Variable(123)), PVariable(new Variable(1)), PVariable(new Variable("STATE")), PVariable(new Variable(true)) }) },
+		{ "multicall100", "system.multicall", createMulticall(100) },
+	};
+	for(const Request& request : requests)
+	{
+		std::shared_ptr<std::vector<char>> encoded(new std::vector<char>());
+		rpcEncoder.encodeRequest(request.methodName, request.parameters, *encoded);
+		std::shared_ptr<std::vector<char>> buffer(new std::vector<char>());
+		benchmarks.push_back(Benchmark{ "rpc.encodeRequest." + request.name, encoded->size(), [&rpcEncoder, request, buffer]() { rpcEncoder.encodeRequest(request.methodName, request.parameters, *buffer); sink = buffer->size(); } });
+		benchmarks.push_back(Benchmark{ "rpc.decodeRequest." + request.name, encoded->size(), [&rpcDecoder, encoded]()
+		{
+			uint32_t methodNameOffset = 0;
+			uint32_t methodNameSize = 0;
+			sink = rpcDecoder.decodeRequest(*encoded, methodNameOffset, methodNameSize)->size();
+		} });
+		benchmarks.push_back(Benchmark{ "rpc.decodeRequestStrict." + request.name, encoded->size(), [&rpcDecoder, encoded]()
+		{
+			uint32_t methodNameOffset = 0;
+			uint32_t methodNameSize = 0;
+			PRPCArray parameters;
+			sink = (int64_t)rpcDecoder.decodeRequest(encoded->data(), encoded->size(), methodNameOffset, methodNameSize, parameters) + parameters->size();
+		} });
+
+		//The XML-RPC decoder parses in place, so every operation includes copying the packet into the receive buffer.
+		std::shared_ptr<std::vector<char>> xmlEncoded(new std::vector<char>());
+		xmlRpcEncoder.encodeRequest(request.methodName, request.parameters, *xmlEncoded);
+		benchmarks.push_back(Benchmark{ "xml.encodeRequest." + request.name, xmlEncoded->size(), [&xmlRpcEncoder, request, buffer]() { xmlRpcEncoder.encodeRequest(request.methodName, request.parameters, *buffer); sink = buffer->size(); } });
+		benchmarks.push_back(Benchmark{ "xml.decodeRequest." + request.name, xmlEncoded->size(), [&xmlRpcDecoder, xmlEncoded, buffer]()
+		{
+			buffer->assign(xmlEncoded->begin(), xmlEncoded->end());
+			std::string methodName;
+			PRPCArray parameters;
+			sink = (int64_t)xmlRpcDecoder.decodeRequest(*buffer, methodName, parameters) + parameters->size();
+		} });
+	}
+	//A request cut off in the middle, e. g. by a broken connection.
+	{
+		std::shared_ptr<std::vector<char>> truncated(new std::vector<char>());
+		rpcEncoder.encodeRequest("system.multicall", createMulticall(100), *truncated);
+		truncated->resize(truncated->size() / 2);
+		benchmarks.push_back(Benchmark{ "rpc.decodeRequest.truncatedMulticall100", truncated->size(), [&rpcDecoder, truncated]()
+		{
+			uint32_t methodNameOffset = 0;
+			uint32_t methodNameSize = 0;
+			PRPCArray parameters = rpcDecoder.decodeRequest(*truncated, methodNameOffset, methodNameSize);
+			sink = parameters ? parameters->size() : 0;
+		} });
+		benchmarks.push_back(Benchmark{ "rpc.decodeRequestStrict.truncatedMulticall100", truncated->size(), [&rpcDecoder, truncated]()
+		{
+			uint32_t methodNameOffset = 0;
+			uint32_t methodNameSize = 0;
+			PRPCArray parameters;
+			sink = (int64_t)rpcDecoder.decodeRequest(truncated->data(), truncated->size(), methodNameOffset, methodNameSize, parameters);
+		} });
+	}
+
+	struct Response
+	{
+		std::string name;
+		PVariable value;
+	};
+	std::vector<Response> responses
+	{
+		{ "void", PVariable(new Variable(VariableType::rpcVoid)) },
+		{ "listDevices", createListDevicesResponse(50, 4) },
+		{ "paramsetDescription", createParamsetDescriptionResponse(60) },
+		{ "deepStruct", createDeepStruct(64) },
+	};
+	for(const Response& response : responses)
+	{
+		std::shared_ptr<std::vector<char>> encoded(new std::vector<char>());
+		rpcEncoder.encodeResponse(response.value, *encoded);
+		std::shared_ptr<std::vector<char>> buffer(new std::vector<char>());
+		benchmarks.push_back(Benchmark{ "rpc.encodeResponse." + response.name, encoded->size(), [&rpcEncoder, response, buffer]() { rpcEncoder.encodeResponse(response.value, *buffer); sink = buffer->size(); } });
+		benchmarks.push_back(Benchmark{ "rpc.decodeResponse." + response.name, encoded->size(), [&rpcDecoder, encoded]() { sink = rpcDecoder.decodeResponse(*encoded)->arrayValue->size(); } });
+		benchmarks.push_back(Benchmark{ "rpc.decodeResponseStrict." + response.name, encoded->size(), [&rpcDecoder, encoded]() { PVariable value; sink = (int64_t)rpcDecoder.decodeResponse(encoded->data(), encoded->size(), value) + value->arrayValue->size(); } });
+
+		std::shared_ptr<std::vector<char>> xmlEncoded(new std::vector<char>());
+		xmlRpcEncoder.encodeResponse(response.value, *xmlEncoded);
+		benchmarks.push_back(Benchmark{ "xml.encodeResponse." + response.name, xmlEncoded->size(), [&xmlRpcEncoder, response, buffer]() { xmlRpcEncoder.encodeResponse(response.value, *buffer); sink = buffer->size(); } });
+		benchmarks.push_back(Benchmark{ "xml.decodeResponse." + response.name, xmlEncoded->size(), [&xmlRpcDecoder, xmlEncoded, buffer]()
+		{
+			buffer->assign(xmlEncoded->begin(), xmlEncoded->end());
+			PVariable value;
+			sink = (int64_t)xmlRpcDecoder.decodeResponse(*buffer, value) + value->arrayValue->size();
+		} });
+	}
+
+	//The primitives are measured in batches of 1000 values, one operation is one value.
+	const uint32_t batchSize = 1000;
+	std::shared_ptr<std::vector<char>> integers(new std::vector<char>());
+	std::shared_ptr<std::vector<char>> floats(new std::vector<char>());
+	std::shared_ptr<std::vector<char>> strings(new std::vector<char>());
+	std::string text("LOWBAT_REPORTING");
+	for(uint32_t i = 0; i < batchSize; i++)
+	{
+		binaryEncoder.encodeInteger(*integers, i * 7919);
+		binaryEncoder.encodeFloat(*floats, i * 0.37 - 100.0);
+		binaryEncoder.encodeString(*strings, text);
+	}
+	std::shared_ptr<std::vector<char>> buffer(new std::vector<char>());
+	buffer->reserve(strings->size());
+	benchmarks.push_back(Benchmark{ "binary.encodeInteger", integers->size(), [&binaryEncoder, buffer]() { buffer->clear(); for(uint32_t i = 0; i < batchSize; i++) binaryEncoder.encodeInteger(*buffer, i * 7919); sink = buffer->size(); } });
+	benchmarks.push_back(Benchmark{ "binary.decodeInteger", integers->size(), [&binaryDecoder, integers]() { uint32_t position = 0; int64_t sum = 0; for(uint32_t i = 0; i < batchSize; i++) sum += binaryDecoder.decodeInteger(*integers, position); sink = sum; } });
+	benchmarks.push_back(Benchmark{ "binary.encodeFloat", floats->size(), [&binaryEncoder, buffer]() { buffer->clear(); for(uint32_t i = 0; i < batchSize; i++) binaryEncoder.encodeFloat(*buffer, i * 0.37 - 100.0); sink = buffer->size(); } });
+	benchmarks.push_back(Benchmark{ "binary.decodeFloat", floats->size(), [&binaryDecoder, floats]() { uint32_t position = 0; double sum = 0; for(uint32_t i = 0; i < batchSize; i++) sum += binaryDecoder.decodeFloat(*floats, position); sink = (int64_t)sum; } });
+	std::shared_ptr<std::vector<double>> floatValues(new std::vector<double>());
+	for(uint32_t i = 0; i < batchSize; i++) floatValues->push_back(i * 0.37 - 100.0);
+	std::shared_ptr<std::vector<double>> decodedFloats(new std::vector<double>(batchSize));
+	benchmarks.push_back(Benchmark{ "binary.encodeFloatBatch", floats->size(), [floatValues, buffer]() { buffer->resize(batchSize * FloatCodec::encodedSize); FloatCodec::encode(floatValues->data(), batchSize, buffer->data()); sink = buffer->size(); } });
+	benchmarks.push_back(Benchmark{ "binary.decodeFloatBatch", floats->size(), [floats, decodedFloats]() { FloatCodec::decode(floats->data(), batchSize, decodedFloats->data()); sink = (int64_t)decodedFloats->back(); } });
+	benchmarks.push_back(Benchmark{ "binary.encodeString", strings->size(), [&binaryEncoder, buffer, text]() mutable { buffer->clear(); for(uint32_t i = 0; i < batchSize; i++) binaryEncoder.encodeString(*buffer, text); sink = buffer->size(); } });
+	benchmarks.push_back(Benchmark{ "binary.decodeString", strings->size(), [&binaryDecoder, strings]() { uint32_t position = 0; int64_t size = 0; for(uint32_t i = 0; i < batchSize; i++) size += binaryDecoder.decodeString(*strings, position).size(); sink = size; } });
+
+	if(list)
+	{
+		for(const Benchmark& benchmark : benchmarks) std::cout << benchmark.name << std::endl;
+		return 0;
+	}
+
+	if(csv) std::cout << "name,operations,nsPerOperation,bytesPerSecond,allocationsPerOperation,allocatedBytesPerOperation" << std::endl;
+	else std::cout << std::left << std::setw(48) << "Benchmark" << std::right << std::setw(14) << "ns/op" << std::setw(12) << "MB/s" << std::setw(14) << "allocs/op" << std::setw(14) << "bytes/op" << std::endl;
+	for(const Benchmark& benchmark : benchmarks)
+	{
+		if(!filter.empty() && benchmark.name.find(filter) == std::string::npos) continue;
+		Result result = run(benchmark, minimumDuration);
+		//The primitive benchmarks process one batch per call.
+		uint64_t valuesPerOperation = benchmark.name.compare(0, 7, "binary.") == 0 ? batchSize : 1;
+		double operations = (double)result.operations * valuesPerOperation;
+		double nanosecondsPerOperation = result.duration / operations;
+		double bytesPerSecond = (double)benchmark.bytesPerOperation * result.operations * 1000000000.0 / result.duration;
+		double allocationsPerOperation = result.allocations / operations;
+		double allocatedBytesPerOperation = result.allocatedBytes / operations;
+		if(csv)
+		{
+			std::cout << benchmark.name << "," << (uint64_t)operations << "," << std::fixed << std::setprecision(2) << nanosecondsPerOperation << "," << std::setprecision(0) << bytesPerSecond << "," << std::setprecision(3) << allocationsPerOperation << "," << std::setprecision(1) << allocatedBytesPerOperation << std::endl;
+		}
+		else
+		{
+			std::cout << std::left << std::setw(48) << benchmark.name << std::right << std::fixed << std::setprecision(1) << std::setw(14) << nanosecondsPerOperation << std::setw(12) << bytesPerSecond / 1000000.0 << std::setw(14) << std::setprecision(2) << allocationsPerOperation << std::setw(14) << std::setprecision(1) << allocatedBytesPerOperation << std::endl;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,101 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+std::atomic_bool countAllocations(false);
+std::atomic<uint64_t> allocations(0);
+std::atomic<uint64_t> allocatedBytes(0);
+thread_local uint64_t threadAllocations = 0;
+thread_local uint64_t threadAllocatedBytes = 0;
+}
+
+//The operators are defined in their own translation unit, so the compiler doesn't inline the replaced delete into its callers.
+void* operator new(size_t size)
+{
+	if(countAllocations.load(std::memory_order_relaxed))
+	{
+		allocations.fetch_add(1, std::memory_order_relaxed);
+		allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+		threadAllocations++;
+		threadAllocatedBytes += size;
+	}
+	void* memory = std::malloc(size ? size : 1);
+	if(!memory) throw std::bad_alloc();
+	return memory;
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+namespace HgAddonLib
+{
+void AllocationCounter::start()
+{
+	allocations = 0;
+	allocatedBytes = 0;
+	threadAllocations = 0;
+	threadAllocatedBytes = 0;
+	countAllocations = true;
+}
+
+void AllocationCounter::stop()
+{
+	countAllocations = false;
+}
+
+uint64_t AllocationCounter::getAllocations()
+{
+	return allocations;
+}
+
+uint64_t AllocationCounter::getAllocatedBytes()
+{
+	return allocatedBytes;
+}
+
+uint64_t AllocationCounter::getThreadAllocations()
+{
+	return threadAllocations;
+}
+
+uint64_t AllocationCounter::getThreadAllocatedBytes()
+{
+	return threadAllocatedBytes;
+}
+
+}
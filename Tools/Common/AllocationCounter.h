@@ -0,0 +1,77 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef ALLOCATIONCOUNTER_H_
+#define ALLOCATIONCOUNTER_H_
+
+#include <cstdint>
+
+namespace HgAddonLib
+{
+/**
+ * Counts the heap allocations of the whole process, including the ones of the library, by replacing the global operator new. Counting is
+ * off until "start" is called. Linking this file into a tool is enough to replace the operators.
+ */
+class AllocationCounter
+{
+public:
+	/**
+	 * Resets the counters and starts counting.
+	 */
+	static void start();
+
+	/**
+	 * Stops counting. The counters keep their values.
+	 */
+	static void stop();
+
+	/**
+	 * Returns the number of allocations since "start".
+	 */
+	static uint64_t getAllocations();
+
+	/**
+	 * Returns the number of bytes allocated since "start".
+	 */
+	static uint64_t getAllocatedBytes();
+
+	/**
+	 * Returns the number of allocations of the calling thread since it called "start". Excludes the allocations of background threads,
+	 * e. g. of the library's timer and server threads.
+	 */
+	static uint64_t getThreadAllocations();
+
+	/**
+	 * Returns the number of bytes allocated by the calling thread since it called "start".
+	 */
+	static uint64_t getThreadAllocatedBytes();
+};
+
+}
+#endif
@@ -0,0 +1,242 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "HomegearStandIn.h"
+
+#include <iostream>
+#include <cstring>
+#include <unistd.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+namespace HgAddonLib
+{
+bool readAll(int32_t fileDescriptor, char* buffer, uint32_t size)
+{
+	while(size > 0)
+	{
+		ssize_t bytesRead = read(fileDescriptor, buffer, size);
+		if(bytesRead <= 0) return false;
+		buffer += bytesRead;
+		size -= bytesRead;
+	}
+	return true;
+}
+
+bool writeAll(int32_t fileDescriptor, const char* buffer, uint32_t size)
+{
+	while(size > 0)
+	{
+		ssize_t bytesWritten = send(fileDescriptor, buffer, size, MSG_NOSIGNAL);
+		if(bytesWritten <= 0) return false;
+		buffer += bytesWritten;
+		size -= bytesWritten;
+	}
+	return true;
+}
+
+namespace
+{
+uint32_t readBigEndian(const char* data)
+{
+	return ((uint32_t)(uint8_t)data[0] << 24) | ((uint32_t)(uint8_t)data[1] << 16) | ((uint32_t)(uint8_t)data[2] << 8) | (uint8_t)data[3];
+}
+}
+
+bool readFrame(int32_t fileDescriptor, std::vector<char>& frame)
+{
+	frame.resize(8);
+	if(!readAll(fileDescriptor, frame.data(), 8) || std::strncmp(frame.data(), "Bin", 3) != 0) return false;
+	uint32_t dataSize = readBigEndian(frame.data() + 4);
+	//Only requests carry a header. The type byte of error responses is 0xFF, which has the header bit set as well.
+	if((uint8_t)frame[3] != 0xFF && (frame[3] & 0x40))
+	{
+		//"dataSize" is the header size, the data size follows the header.
+		if(dataSize > 1024) return false;
+		frame.resize(8 + dataSize + 4);
+		if(!readAll(fileDescriptor, frame.data() + 8, dataSize + 4)) return false;
+		dataSize = readBigEndian(frame.data() + frame.size() - 4);
+	}
+	if(dataSize > 10485760) return false;
+	uint32_t offset = frame.size();
+	frame.resize(offset + dataSize);
+	return readAll(fileDescriptor, frame.data() + offset, dataSize);
+}
+
+int32_t connectTo(const std::string& host, const std::string& port)
+{
+	addrinfo hints;
+	std::memset(&hints, 0, sizeof(addrinfo));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	addrinfo* addresses = nullptr;
+	if(getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0) return -1;
+	int32_t fileDescriptor = -1;
+	for(addrinfo* address = addresses; address; address = address->ai_next)
+	{
+		fileDescriptor = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+		if(fileDescriptor == -1) continue;
+		if(connect(fileDescriptor, address->ai_addr, address->ai_addrlen) == 0) break;
+		close(fileDescriptor);
+		fileDescriptor = -1;
+	}
+	freeaddrinfo(addresses);
+	if(fileDescriptor != -1)
+	{
+		int32_t flag = 1;
+		setsockopt(fileDescriptor, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(int32_t));
+	}
+	return fileDescriptor;
+}
+
+HomegearStandIn::HomegearStandIn(bool connectBack) : _codecs(), _decoder(&_codecs), _encoder(&_codecs), _stop(false)
+{
+	_connectBack = connectBack;
+}
+
+HomegearStandIn::~HomegearStandIn()
+{
+	stop();
+}
+
+bool HomegearStandIn::start()
+{
+	_serverSocket = socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in address;
+	std::memset(&address, 0, sizeof(sockaddr_in));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t addressSize = sizeof(sockaddr_in);
+	if(_serverSocket == -1 || bind(_serverSocket, (sockaddr*)&address, addressSize) == -1 || listen(_serverSocket, 5) == -1 || getsockname(_serverSocket, (sockaddr*)&address, &addressSize) == -1)
+	{
+		std::cerr << "Error: Could not start listening: " << strerror(errno) << std::endl;
+		return false;
+	}
+	_port = ntohs(address.sin_port);
+	_acceptThread = std::thread(&HomegearStandIn::acceptConnections, this);
+	return true;
+}
+
+void HomegearStandIn::stop()
+{
+	_stop = true;
+	if(_serverSocket != -1) shutdown(_serverSocket, SHUT_RDWR);
+	if(_acceptThread.joinable()) _acceptThread.join();
+	if(_serverSocket != -1) close(_serverSocket);
+	_serverSocket = -1;
+	{
+		std::lock_guard<std::mutex> connectionsGuard(_connectionsMutex);
+		for(std::pair<const int32_t, std::thread>& connection : _connections)
+		{
+			shutdown(connection.first, SHUT_RDWR);
+			connection.second.join();
+			close(connection.first);
+		}
+		_connections.clear();
+	}
+	std::lock_guard<std::mutex> callbackGuard(_callbackMutex);
+	if(_callbackSocket != -1) close(_callbackSocket);
+	_callbackSocket = -1;
+}
+
+int32_t HomegearStandIn::waitForCallbackSocket(uint32_t timeout)
+{
+	std::unique_lock<std::mutex> callbackGuard(_callbackMutex);
+	_callbackConditionVariable.wait_for(callbackGuard, std::chrono::milliseconds(timeout), [&]{ return _callbackSocket != -1; });
+	return _callbackSocket;
+}
+
+void HomegearStandIn::acceptConnections()
+{
+	while(!_stop)
+	{
+		int32_t clientSocket = accept(_serverSocket, nullptr, nullptr);
+		if(clientSocket == -1) break;
+		int32_t flag = 1;
+		setsockopt(clientSocket, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(int32_t));
+		std::lock_guard<std::mutex> connectionsGuard(_connectionsMutex);
+		_connections[clientSocket] = std::thread(&HomegearStandIn::readClient, this, clientSocket);
+	}
+}
+
+void HomegearStandIn::readClient(int32_t clientSocket)
+{
+	std::vector<char> request;
+	std::vector<char> response;
+	while(!_stop && readFrame(clientSocket, request))
+	{
+		getResponse(request, response);
+		if(!writeAll(clientSocket, response.data(), response.size())) break;
+	}
+}
+
+void HomegearStandIn::getResponse(std::vector<char>& request, std::vector<char>& response)
+{
+	std::string methodName;
+	PRPCArray parameters = _decoder.decodeRequest(request, methodName);
+	PVariable result = parameters ? callMethod(methodName, parameters) : Variable::createError(-32700, "Could not decode request.");
+	_encoder.encodeResponse(result, response);
+}
+
+PVariable HomegearStandIn::callMethod(const std::string& methodName, PRPCArray parameters)
+{
+	if(methodName == "system.multicall" && !parameters->empty())
+	{
+		PVariable result(new Variable(VariableType::rpcArray));
+		for(PVariable& call : *parameters->at(0)->arrayValue)
+		{
+			PVariable callParameters = call->structValue->count("params") ? call->structValue->at("params") : PVariable(new Variable(VariableType::rpcArray));
+			std::string callMethodName = call->structValue->count("methodName") ? call->structValue->at("methodName")->stringValue : "";
+			result->arrayValue->push_back(callMethod(callMethodName, callParameters->arrayValue));
+		}
+		return result;
+	}
+	if(methodName == "init") init(parameters);
+	return PVariable(new Variable());
+}
+
+void HomegearStandIn::init(PRPCArray parameters)
+{
+	if(!_connectBack || parameters->size() < 2 || parameters->at(1)->stringValue.empty()) return;
+	//The URL looks like "binary://127.0.0.1:2003".
+	std::string url = parameters->at(0)->stringValue;
+	std::string::size_type hostStart = url.find("://");
+	hostStart = (hostStart == std::string::npos) ? 0 : hostStart + 3;
+	std::string::size_type portStart = url.rfind(':');
+	if(portStart == std::string::npos || portStart < hostStart) return;
+	std::lock_guard<std::mutex> callbackGuard(_callbackMutex);
+	if(_callbackSocket != -1) return;
+	_callbackSocket = connectTo(url.substr(hostStart, portStart - hostStart), url.substr(portStart + 1));
+	_callbackConditionVariable.notify_all();
+}
+
+}
@@ -0,0 +1,143 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef HOMEGEARSTANDIN_H_
+#define HOMEGEARSTANDIN_H_
+
+#include "SharedObjects.h"
+#include "Encoding/RPCDecoder.h"
+#include "Encoding/RPCEncoder.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+namespace HgAddonLib
+{
+/**
+ * Reads exactly "size" bytes. Returns false when the connection was closed.
+ */
+bool readAll(int32_t fileDescriptor, char* buffer, uint32_t size);
+
+/**
+ * Writes all "size" bytes. Returns false when the connection was closed.
+ */
+bool writeAll(int32_t fileDescriptor, const char* buffer, uint32_t size);
+
+/**
+ * Reads one binary RPC frame including its header.
+ */
+bool readFrame(int32_t fileDescriptor, std::vector<char>& frame);
+
+/**
+ * Opens a TCP connection with TCP_NODELAY set. Returns the socket or "-1".
+ */
+int32_t connectTo(const std::string& host, const std::string& port);
+
+/**
+ * Plays Homegear's side of the connection on localhost, so the tools can run the library without Homegear. Every connection of the addon
+ * is served by its own thread. On "init" (also within "system.multicall") it connects to the addon's RPC server, the tool can then send
+ * requests to the addon through "getCallbackSocket". Requests of the addon are answered by "callMethod".
+ */
+class HomegearStandIn
+{
+public:
+	/**
+	 * @param connectBack When false, "init" is answered, but no connection to the addon is opened.
+	 */
+	HomegearStandIn(bool connectBack);
+
+	/**
+	 * Destructor. Derived classes must call "stop" in their destructor, as the connection threads call virtual methods.
+	 */
+	virtual ~HomegearStandIn();
+
+	/**
+	 * Starts listening on a free port on localhost.
+	 *
+	 * @return Returns true on success.
+	 */
+	bool start();
+
+	/**
+	 * Closes all connections and waits for their threads.
+	 */
+	void stop();
+
+	/**
+	 * Returns the port to pass to the addon.
+	 */
+	int32_t getPort() { return _port; }
+
+	/**
+	 * Waits until the connection to the addon's RPC server is established and returns its socket or "-1" on timeout.
+	 */
+	int32_t waitForCallbackSocket(uint32_t timeout);
+protected:
+	SharedObjects _codecs;
+	RPCDecoder _decoder;
+	RPCEncoder _encoder;
+
+	/**
+	 * Creates the encoded response to a request of the addon. The default implementation decodes the request, calls "callMethod" and
+	 * encodes its result. Called concurrently by the connection threads.
+	 */
+	virtual void getResponse(std::vector<char>& request, std::vector<char>& response);
+
+	/**
+	 * Executes a request of the addon. The default implementation handles "init" and "system.multicall" and returns void for all other
+	 * methods. Called concurrently by the connection threads.
+	 */
+	virtual PVariable callMethod(const std::string& methodName, PRPCArray parameters);
+private:
+	bool _connectBack = false;
+	std::atomic_bool _stop;
+	int32_t _serverSocket = -1;
+	int32_t _port = 0;
+	std::thread _acceptThread;
+	std::mutex _connectionsMutex;
+	std::map<int32_t, std::thread> _connections;
+	std::mutex _callbackMutex;
+	std::condition_variable _callbackConditionVariable;
+	int32_t _callbackSocket = -1;
+
+	void acceptConnections();
+	void readClient(int32_t clientSocket);
+	void init(PRPCArray parameters);
+
+	HomegearStandIn(const HomegearStandIn&);
+	HomegearStandIn& operator=(const HomegearStandIn&);
+};
+
+}
+#endif
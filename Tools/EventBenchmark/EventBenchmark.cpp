@@ -0,0 +1,319 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+/*
+ * Measures the event throughput of the library end to end without Homegear. The tool plays Homegear on localhost (see HomegearStandIn):
+ * it accepts the "init" of a Base instance, connects back to its RPC server and sends "event" requests or "system.multicall" requests
+ * with events at a fixed rate or as fast as possible, one request at a time like Homegear. It reports the sustained events per second,
+ * the latency from the (scheduled) send time to the response and the CPU time the library and the addon need per event.
+ *
+ * With a fixed rate, latencies are measured from the time a request was due, so a stalled server shows up as latency instead of a lower
+ * send rate.
+ *
+ * Usage: homegear-addon-event-benchmark [OPTIONS]
+ *   -r, --rate EVENTS            The events per second to send. "0" sends as fast as possible (default 0).
+ *   -t, --time SECONDS           The measuring time (default 10).
+ *   -w, --warmup SECONDS         The time events are sent before measuring (default 1).
+ *   -p, --peers COUNT            The number of peers the events are spread over (default 100).
+ *   -b, --batch SIZE             Send "system.multicall" requests with SIZE events. "1" sends single "event" requests (default 1).
+ *   -d, --debug LEVEL            The debug level of the library (default 2).
+ *       --min-throughput EVENTS  Exit with code 2, when fewer events per second were processed.
+ *       --max-p99 MICROSECONDS   Exit with code 2, when the 99th percentile of the latency is higher.
+ */
+
+#include "Base.h"
+#include "Metrics.h"
+#include "Tools/Common/HomegearStandIn.h"
+
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <getopt.h>
+
+using namespace HgAddonLib;
+
+namespace
+{
+class BenchmarkAddon : public Base
+{
+public:
+	//The addon is peer 1, the other peers are added with "addPeers".
+	BenchmarkAddon(int32_t homegearPort, int32_t debugLevel) : Base(homegearPort, 1, debugLevel) {}
+	virtual ~BenchmarkAddon() {}
+
+	uint64_t getEvents() { return _events.load(std::memory_order_relaxed); }
+
+	virtual void event(uint64_t peerId, int32_t channel, std::string parameter, PVariable value)
+	{
+		_events.fetch_add(1, std::memory_order_relaxed);
+	}
+private:
+	std::atomic<uint64_t> _events{0};
+};
+
+int64_t getCpuTime(clockid_t clock)
+{
+	timespec time;
+	clock_gettime(clock, &time);
+	return (int64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+/**
+ * Encodes "count" different requests, which are sent round robin. Encoding while sending would add the encoding time to the latencies.
+ */
+std::vector<std::vector<char>> createRequests(uint32_t count, uint32_t batchSize, uint32_t peerCount)
+{
+	SharedObjects codecs;
+	RPCEncoder encoder(&codecs);
+	std::vector<std::vector<char>> requests(count);
+	uint32_t eventIndex = 0;
+	auto createEvent = [&](PRPCArray parameters)
+	{
+		uint32_t peerId = 1 + eventIndex % peerCount;
+		parameters->push_back(PVariable(new Variable("HomegearAddon")));
+		parameters->push_back(PVariable(new Variable(peerId)));
+		parameters->push_back(PVariable(new Variable(1 + (int32_t)(eventIndex % 4))));
+		if(eventIndex % 2 == 0)
+		{
+			parameters->push_back(PVariable(new Variable("STATE")));
+			parameters->push_back(PVariable(new Variable((bool)(eventIndex % 4 == 0))));
+		}
+		else
+		{
+			parameters->push_back(PVariable(new Variable("LEVEL")));
+			parameters->push_back(PVariable(new Variable((eventIndex % 101) / 100.0)));
+		}
+		eventIndex++;
+	};
+	for(std::vector<char>& request : requests)
+	{
+		if(batchSize == 1)
+		{
+			PRPCArray parameters(new RPCArray());
+			createEvent(parameters);
+			encoder.encodeRequest("event", PRPCList(new RPCList(parameters->begin(), parameters->end())), request);
+			continue;
+		}
+		PVariable calls(new Variable(VariableType::rpcArray));
+		for(uint32_t i = 0; i < batchSize; i++)
+		{
+			PVariable call(new Variable(VariableType::rpcStruct));
+			call->structValue->insert(RPCStructElement("methodName", PVariable(new Variable("event"))));
+			PVariable parameters(new Variable(VariableType::rpcArray));
+			createEvent(parameters->arrayValue);
+			call->structValue->insert(RPCStructElement("params", parameters));
+			calls->arrayValue->push_back(call);
+		}
+		encoder.encodeRequest("system.multicall", PRPCList(new RPCList{ calls }), request);
+	}
+	return requests;
+}
+
+void printUsage()
+{
+	std::cout << "Usage: homegear-addon-event-benchmark [OPTIONS]" << std::endl;
+	std::cout << "  -r, --rate EVENTS            The events per second to send. \"0\" sends as fast as possible (default 0)." << std::endl;
+	std::cout << "  -t, --time SECONDS           The measuring time (default 10)." << std::endl;
+	std::cout << "  -w, --warmup SECONDS         The time events are sent before measuring (default 1)." << std::endl;
+	std::cout << "  -p, --peers COUNT            The number of peers the events are spread over (default 100)." << std::endl;
+	std::cout << "  -b, --batch SIZE             Send \"system.multicall\" requests with SIZE events. \"1\" sends single \"event\" requests (default 1)." << std::endl;
+	std::cout << "  -d, --debug LEVEL            The debug level of the library (default 2)." << std::endl;
+	std::cout << "      --min-throughput EVENTS  Exit with code 2, when fewer events per second were processed." << std::endl;
+	std::cout << "      --max-p99 MICROSECONDS   Exit with code 2, when the 99th percentile of the latency is higher." << std::endl;
+}
+}
+
+int main(int argc, char** argv)
+{
+	double rate = 0;
+	double measuringTime = 10;
+	double warmupTime = 1;
+	uint32_t peerCount = 100;
+	uint32_t batchSize = 1;
+	int32_t debugLevel = 2;
+	double minThroughput = 0;
+	double maxP99 = 0;
+
+	enum LongOption { minThroughputOption = 1000, maxP99Option };
+	const option options[] =
+	{
+		{ "rate", required_argument, nullptr, 'r' },
+		{ "time", required_argument, nullptr, 't' },
+		{ "warmup", required_argument, nullptr, 'w' },
+		{ "peers", required_argument, nullptr, 'p' },
+		{ "batch", required_argument, nullptr, 'b' },
+		{ "debug", required_argument, nullptr, 'd' },
+		{ "min-throughput", required_argument, nullptr, minThroughputOption },
+		{ "max-p99", required_argument, nullptr, maxP99Option },
+		{ "help", no_argument, nullptr, 'h' },
+		{ nullptr, 0, nullptr, 0 }
+	};
+	int32_t optionCharacter;
+	while((optionCharacter = getopt_long(argc, argv, "r:t:w:p:b:d:h", options, nullptr)) != -1)
+	{
+		switch(optionCharacter)
+		{
+		case 'r':
+			rate = std::max(0.0, std::atof(optarg));
+			break;
+		case 't':
+			measuringTime = std::max(0.1, std::atof(optarg));
+			break;
+		case 'w':
+			warmupTime = std::max(0.0, std::atof(optarg));
+			break;
+		case 'p':
+			peerCount = std::max(1, std::atoi(optarg));
+			break;
+		case 'b':
+			batchSize = std::max(1, std::atoi(optarg));
+			break;
+		case 'd':
+			debugLevel = std::atoi(optarg);
+			break;
+		case minThroughputOption:
+			minThroughput = std::atof(optarg);
+			break;
+		case maxP99Option:
+			maxP99 = std::atof(optarg);
+			break;
+		default:
+			printUsage();
+			return optionCharacter == 'h' ? 0 : 1;
+		}
+	}
+	if(optind != argc)
+	{
+		printUsage();
+		return 1;
+	}
+
+	std::vector<std::vector<char>> requests = createRequests(1024, batchSize, peerCount);
+	HomegearStandIn homegear(true);
+	if(!homegear.start()) return 1;
+	std::unique_ptr<BenchmarkAddon> addon(new BenchmarkAddon(homegear.getPort(), debugLevel));
+	std::vector<uint64_t> peerIds;
+	for(uint32_t i = 2; i <= peerCount; i++) peerIds.push_back(i);
+	if(!peerIds.empty()) addon->addPeers(peerIds);
+	int32_t callbackSocket = homegear.waitForCallbackSocket(30000);
+	if(callbackSocket == -1)
+	{
+		std::cerr << "Error: The addon did not initialize the connection." << std::endl;
+		return 1;
+	}
+
+	MetricHistogram latencies;
+	std::vector<char> response;
+	response.reserve(1024);
+	uint64_t requestIndex = 0;
+	uint64_t measuredRequests = 0;
+	uint64_t failedRequests = 0;
+	//One request is due every "interval" nanoseconds, when a rate is set.
+	int64_t interval = rate > 0 ? (int64_t)(1000000000.0 * batchSize / rate) : 0;
+	int64_t startTime = MetricHistogram::now();
+	int64_t measuringStartTime = startTime + (int64_t)(warmupTime * 1000000000);
+	int64_t endTime = measuringStartTime + (int64_t)(measuringTime * 1000000000);
+	uint64_t eventsAtStart = 0;
+	int64_t processCpuTimeAtStart = 0;
+	int64_t threadCpuTimeAtStart = 0;
+	bool measuring = false;
+	while(true)
+	{
+		int64_t dueTime = interval > 0 ? startTime + requestIndex * interval : MetricHistogram::now();
+		if(dueTime >= endTime) break;
+		if(!measuring && dueTime >= measuringStartTime)
+		{
+			measuring = true;
+			eventsAtStart = addon->getEvents();
+			processCpuTimeAtStart = getCpuTime(CLOCK_PROCESS_CPUTIME_ID);
+			threadCpuTimeAtStart = getCpuTime(CLOCK_THREAD_CPUTIME_ID);
+		}
+		if(interval > 0)
+		{
+			//Sleeping wakes up late by up to some 100 µs, which would be counted as latency. So the last part is spent spinning.
+			int64_t now = MetricHistogram::now();
+			if(dueTime - now > 200000) std::this_thread::sleep_for(std::chrono::nanoseconds(dueTime - now - 200000));
+			while(MetricHistogram::now() < dueTime);
+		}
+		const std::vector<char>& request = requests[requestIndex % requests.size()];
+		if(!writeAll(callbackSocket, request.data(), request.size()) || !readFrame(callbackSocket, response))
+		{
+			std::cerr << "Error: The connection to the addon was closed." << std::endl;
+			return 1;
+		}
+		//Errors are sent with the packet type 0xFF.
+		if(response.size() > 3 && (uint8_t)response[3] == 0xFF) failedRequests++;
+		if(measuring)
+		{
+			latencies.recordSince(dueTime);
+			measuredRequests++;
+		}
+		requestIndex++;
+	}
+	int64_t duration = MetricHistogram::now() - measuringStartTime;
+	//CPU time of the load generator (this thread) is not part of the result.
+	int64_t cpuTime = (getCpuTime(CLOCK_PROCESS_CPUTIME_ID) - processCpuTimeAtStart) - (getCpuTime(CLOCK_THREAD_CPUTIME_ID) - threadCpuTimeAtStart);
+	uint64_t events = addon->getEvents() - eventsAtStart;
+	addon.reset();
+
+	if(measuredRequests == 0 || events == 0)
+	{
+		std::cerr << "Error: No events were processed while measuring." << std::endl;
+		return 1;
+	}
+	double seconds = duration / 1000000000.0;
+	double throughput = events / seconds;
+	double p99 = latencies.getPercentile(99) / 1000.0;
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Sent " << measuredRequests << " requests with " << measuredRequests * batchSize << " events in " << std::setprecision(3) << seconds << " s";
+	if(rate > 0) std::cout << " (target " << std::setprecision(0) << rate << " events/s)";
+	if(failedRequests > 0) std::cout << ", " << failedRequests << " requests failed";
+	std::cout << "." << std::endl;
+	std::cout << std::setprecision(1);
+	std::cout << "Throughput:    " << throughput << " events/s" << std::endl;
+	std::cout << "Latency (µs):  p50 " << latencies.getPercentile(50) / 1000.0 << ", p99 " << p99 << ", p99.9 " << latencies.getPercentile(99.9) / 1000.0 << ", max " << latencies.getMax() / 1000.0 << " (per request)" << std::endl;
+	std::cout << "CPU per event: " << std::setprecision(2) << cpuTime / 1000.0 / events << " µs" << std::endl;
+
+	bool passed = true;
+	if(minThroughput > 0 && throughput < minThroughput)
+	{
+		std::cout << "FAILED: The throughput is below " << std::setprecision(0) << minThroughput << " events/s." << std::endl;
+		passed = false;
+	}
+	if(maxP99 > 0 && p99 > maxP99)
+	{
+		std::cout << "FAILED: The 99th percentile of the latency is above " << std::setprecision(0) << maxP99 << " µs." << std::endl;
+		passed = false;
+	}
+	return passed ? 0 : 2;
+}
@@ -0,0 +1,393 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+/*
+ * Verifies that the float kernels of FloatCodec are bit-exact with the original implementation of BinaryEncoder::encodeFloat and
+ * BinaryDecoder::decodeFloat, which is kept below as reference. Encoding is checked with random bit patterns covering every binary
+ * exponent, with the values around each power of ten and with special values. Decoding is checked for every exponent from -1100 to 1100
+ * with random and boundary mantissas. Optionally all 2^32 mantissas are decoded with the exponents of typical sensor values. Finally the
+ * speed of the reference and of the kernels is compared. The tool exits with code 1 on the first mismatch.
+ *
+ * The original "uint8_t" decoder computed 2^exponent with "1 << exponent", which is undefined for exponents outside of [-30, 30]. Within
+ * that range it equals the "char" decoder, outside of it the kernels follow the "char" decoder.
+ *
+ * Usage: homegear-addon-float-check [OPTIONS]
+ *   -n, --samples COUNT        The number of random values per check (default 10000000).
+ *   -s, --seed SEED            The seed of the random number generator (default 1).
+ *   -e, --exhaustive           Additionally decode all 2^32 mantissas with the exponents -10 to 10. Takes several minutes.
+ */
+
+#include "Encoding/FloatCodec.h"
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <vector>
+#include <chrono>
+#include <limits>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <getopt.h>
+
+using namespace HgAddonLib;
+
+namespace
+{
+//Written by the benchmarks, so the compiler can't remove them.
+volatile double sink = 0;
+
+uint32_t mismatches = 0;
+
+void referenceEncode(double floatValue, int32_t& mantissa, int32_t& exponent)
+{
+	double temp = std::abs(floatValue);
+	exponent = 0;
+	if(temp != 0 && temp < 0.5)
+	{
+		while(temp < 0.5)
+		{
+			temp *= 2;
+			exponent--;
+		}
+	}
+	else while(temp >= 1)
+	{
+		temp /= 2;
+		exponent++;
+	}
+	if(floatValue < 0) temp *= -1;
+	mantissa = std::lround(temp * 0x40000000);
+}
+
+double referenceDecode(int32_t mantissa, int32_t exponent)
+{
+	double floatValue = (double)mantissa / 0x40000000;
+	floatValue *= std::pow(2, exponent);
+	if(floatValue != 0)
+	{
+		int32_t digits = std::lround(std::floor(std::log10(floatValue) + 1));
+		double factor = std::pow(10, 9 - digits);
+		floatValue = std::floor(floatValue * factor + 0.5) / factor;
+	}
+	return floatValue;
+}
+
+//The decoder of the "uint8_t" overload, only defined for exponents from -30 to 30.
+double referenceShiftDecode(int32_t mantissa, int32_t exponent)
+{
+	double floatValue = (double)mantissa / 0x40000000;
+	if(exponent >= 0) floatValue *= (1 << exponent);
+	else floatValue /= (1 << (exponent * -1));
+	if(floatValue != 0)
+	{
+		int32_t digits = std::lround(std::floor(std::log10(floatValue) + 1));
+		double factor = std::pow(10, 9 - digits);
+		floatValue = std::floor(floatValue * factor + 0.5) / factor;
+	}
+	return floatValue;
+}
+
+bool sameBits(double value1, double value2)
+{
+	return std::memcmp(&value1, &value2, sizeof(double)) == 0;
+}
+
+bool checkEncode(double value)
+{
+	int32_t expectedMantissa = 0;
+	int32_t expectedExponent = 0;
+	referenceEncode(value, expectedMantissa, expectedExponent);
+	int32_t mantissa = 0;
+	int32_t exponent = 0;
+	FloatCodec::encode(value, mantissa, exponent);
+	if(mantissa == expectedMantissa && exponent == expectedExponent) return true;
+	if(mismatches++ < 10) std::cout << "Encode mismatch for " << std::setprecision(17) << value << ": expected " << expectedMantissa << " * 2^" << expectedExponent << ", got " << mantissa << " * 2^" << exponent << std::endl;
+	return false;
+}
+
+bool checkDecode(int32_t mantissa, int32_t exponent)
+{
+	double expected = referenceDecode(mantissa, exponent);
+	double value = FloatCodec::decode(mantissa, exponent);
+	bool equal = sameBits(value, expected);
+	if(equal && exponent >= -30 && exponent <= 30) equal = sameBits(value, referenceShiftDecode(mantissa, exponent));
+	if(equal) return true;
+	if(mismatches++ < 10) std::cout << "Decode mismatch for " << mantissa << " * 2^" << exponent << ": expected " << std::setprecision(17) << expected << ", got " << value << std::endl;
+	return false;
+}
+
+bool checkPowers()
+{
+	std::cout << "Powers of two and digit counts... " << std::flush;
+	for(int32_t exponent = -1200; exponent <= 1200; exponent++)
+	{
+		if(!sameBits(FloatCodec::powerOfTwo(exponent), std::pow(2, exponent)))
+		{
+			std::cout << "FAILED: 2^" << exponent << std::endl;
+			return false;
+		}
+	}
+	//Every power of ten and its neighbours, where the result depends on the rounding of std::log10.
+	for(int32_t exponent = -323; exponent <= 308; exponent++)
+	{
+		double value = std::pow(10, exponent);
+		double below = value;
+		double above = value;
+		for(int32_t i = 0; i < 1000; i++)
+		{
+			for(double candidate : { below, above })
+			{
+				if(candidate <= 0 || candidate > std::numeric_limits<double>::max()) continue;
+				if(FloatCodec::countDigits(candidate) != std::lround(std::floor(std::log10(candidate) + 1)))
+				{
+					std::cout << "FAILED: Digits of " << std::setprecision(17) << candidate << std::endl;
+					return false;
+				}
+			}
+			below = std::nextafter(below, 0.0);
+			above = std::nextafter(above, std::numeric_limits<double>::infinity());
+		}
+	}
+	std::cout << "OK" << std::endl;
+	return true;
+}
+
+bool checkEncoding(std::mt19937_64& random, uint64_t samples)
+{
+	std::cout << "Encoding... " << std::flush;
+	const double specialValues[] = { 0.0, -0.0, 0.5, -0.5, 1.0, -1.0, 0.1, 1e-9, 1e9, std::numeric_limits<double>::max(), -std::numeric_limits<double>::max(), std::numeric_limits<double>::min(), std::numeric_limits<double>::denorm_min(), -std::numeric_limits<double>::denorm_min(), std::numeric_limits<double>::quiet_NaN() };
+	for(double value : specialValues)
+	{
+		if(!checkEncode(value)) return false;
+	}
+	//Values rounding up to 2^30 and values exactly between two mantissas.
+	for(int32_t exponent = -1074; exponent <= 1023; exponent++)
+	{
+		for(double fraction : { 0.99999999999999989, 0.99999999953433871, 0.5 + 0.5 / 0x40000000, 0.75 + 0.5 / 0x40000000 })
+		{
+			double value = std::ldexp(fraction, exponent);
+			if(!checkEncode(value) || !checkEncode(-value)) return false;
+		}
+	}
+	//Random bit patterns cover all binary exponents uniformly, the scaled integers resemble sensor readings.
+	for(uint64_t i = 0; i < samples; i++)
+	{
+		uint64_t bits = random();
+		double value;
+		std::memcpy(&value, &bits, sizeof(double));
+		if(std::isinf(value) || std::isnan(value)) continue;
+		if(!checkEncode(value)) return false;
+		if(!checkEncode((double)(int32_t)bits / 1000)) return false;
+	}
+	//The reference doesn't terminate for infinity, so the kernel only has to decode it to infinity again.
+	for(double value : { std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity() })
+	{
+		int32_t mantissa = 0;
+		int32_t exponent = 0;
+		FloatCodec::encode(value, mantissa, exponent);
+		if(FloatCodec::decode(mantissa, exponent) != value)
+		{
+			std::cout << "FAILED: " << value << " doesn't decode to itself." << std::endl;
+			return false;
+		}
+	}
+	std::cout << "OK" << std::endl;
+	return true;
+}
+
+bool checkDecoding(std::mt19937_64& random, uint64_t samples)
+{
+	std::cout << "Decoding... " << std::flush;
+	const int32_t boundaryMantissas[] = { 0, 1, -1, 2, 0x20000000, -0x20000000, 0x3FFFFFFF, -0x3FFFFFFF, 0x40000000, -0x40000000, std::numeric_limits<int32_t>::max(), std::numeric_limits<int32_t>::min() };
+	uint64_t samplesPerExponent = std::max((uint64_t)1, samples / 2201);
+	for(int32_t exponent = -1100; exponent <= 1100; exponent++)
+	{
+		for(int32_t mantissa : boundaryMantissas)
+		{
+			if(!checkDecode(mantissa, exponent)) return false;
+		}
+		for(uint64_t i = 0; i < samplesPerExponent; i++)
+		{
+			if(!checkDecode((int32_t)random(), exponent)) return false;
+		}
+	}
+	//Exponents outside of the range of a double and random exponents.
+	for(int32_t exponent : { std::numeric_limits<int32_t>::min(), -100000, 100000, std::numeric_limits<int32_t>::max() })
+	{
+		for(int32_t mantissa : boundaryMantissas)
+		{
+			if(!checkDecode(mantissa, exponent)) return false;
+		}
+	}
+	for(uint64_t i = 0; i < samples; i++)
+	{
+		uint64_t bits = random();
+		if(!checkDecode((int32_t)bits, (int32_t)(bits >> 32) % 1200)) return false;
+	}
+	std::cout << "OK" << std::endl;
+	return true;
+}
+
+bool checkRoundTrip(std::mt19937_64& random, uint64_t samples)
+{
+	std::cout << "Round trip and batch API... " << std::flush;
+	std::vector<double> values;
+	values.reserve(1000);
+	std::vector<char> encodedData(1000 * FloatCodec::encodedSize);
+	std::vector<double> decodedValues(1000);
+	for(uint64_t i = 0; i < samples; i += values.size())
+	{
+		values.clear();
+		for(uint32_t j = 0; j < 1000; j++) values.push_back((double)(int32_t)random() / 100);
+		FloatCodec::encode(values.data(), values.size(), encodedData.data());
+		FloatCodec::decode(encodedData.data(), values.size(), decodedValues.data());
+		for(uint32_t j = 0; j < values.size(); j++)
+		{
+			int32_t mantissa = 0;
+			int32_t exponent = 0;
+			referenceEncode(values[j], mantissa, exponent);
+			if(!sameBits(decodedValues[j], referenceDecode(mantissa, exponent)) || !sameBits(decodedValues[j], FloatCodec::decode(encodedData.data() + j * FloatCodec::encodedSize)))
+			{
+				std::cout << "FAILED: " << std::setprecision(17) << values[j] << std::endl;
+				return false;
+			}
+		}
+	}
+	std::cout << "OK" << std::endl;
+	return true;
+}
+
+bool checkExhaustive()
+{
+	for(int32_t exponent = -10; exponent <= 10; exponent++)
+	{
+		std::cout << "All mantissas with exponent " << exponent << "... " << std::flush;
+		int64_t mantissa = std::numeric_limits<int32_t>::min();
+		for(; mantissa <= std::numeric_limits<int32_t>::max(); mantissa++)
+		{
+			if(!checkDecode((int32_t)mantissa, exponent)) return false;
+		}
+		std::cout << "OK" << std::endl;
+	}
+	return true;
+}
+
+template<typename Function> double measure(uint32_t count, Function function)
+{
+	std::chrono::time_point<std::chrono::steady_clock> start = std::chrono::steady_clock::now();
+	uint32_t rounds = 0;
+	do
+	{
+		function();
+		rounds++;
+	} while(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500));
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() / ((double)rounds * count);
+}
+
+void benchmark(std::mt19937_64& random)
+{
+	//Readings of typical sensors and energy meters.
+	const uint32_t count = 10000;
+	std::vector<double> values;
+	for(uint32_t i = 0; i < count; i++) values.push_back((double)(random() % 1000000) / 100 - 1000);
+	std::vector<int32_t> mantissas(count);
+	std::vector<int32_t> exponents(count);
+	for(uint32_t i = 0; i < count; i++) FloatCodec::encode(values[i], mantissas[i], exponents[i]);
+	std::vector<char> encodedData(count * FloatCodec::encodedSize);
+	std::vector<double> decodedValues(count);
+
+	std::cout << std::endl << std::left << std::setw(24) << "Operation" << std::right << std::setw(16) << "reference ns" << std::setw(16) << "kernel ns" << std::setw(20) << "batch wire ns" << std::endl;
+	double referenceEncodeTime = measure(count, [&]() { int32_t mantissa = 0; int32_t exponent = 0; int64_t sum = 0; for(double value : values) { referenceEncode(value, mantissa, exponent); sum += mantissa + exponent; } sink = sum; });
+	double encodeTime = measure(count, [&]() { int32_t mantissa = 0; int32_t exponent = 0; int64_t sum = 0; for(double value : values) { FloatCodec::encode(value, mantissa, exponent); sum += mantissa + exponent; } sink = sum; });
+	double batchEncodeTime = measure(count, [&]() { FloatCodec::encode(values.data(), count, encodedData.data()); sink = encodedData[7]; });
+	std::cout << std::left << std::setw(24) << "encode" << std::right << std::fixed << std::setprecision(2) << std::setw(16) << referenceEncodeTime << std::setw(16) << encodeTime << std::setw(20) << batchEncodeTime << std::endl;
+	double referenceDecodeTime = measure(count, [&]() { double sum = 0; for(uint32_t i = 0; i < count; i++) sum += referenceDecode(mantissas[i], exponents[i]); sink = sum; });
+	double decodeTime = measure(count, [&]() { double sum = 0; for(uint32_t i = 0; i < count; i++) sum += FloatCodec::decode(mantissas[i], exponents[i]); sink = sum; });
+	double batchDecodeTime = measure(count, [&]() { FloatCodec::decode(encodedData.data(), count, decodedValues.data()); sink = decodedValues[0]; });
+	std::cout << std::left << std::setw(24) << "decode" << std::right << std::setw(16) << referenceDecodeTime << std::setw(16) << decodeTime << std::setw(20) << batchDecodeTime << std::endl;
+}
+
+void printUsage()
+{
+	std::cout << "Usage: homegear-addon-float-check [OPTIONS]" << std::endl;
+	std::cout << "  -n, --samples COUNT        The number of random values per check (default 10000000)." << std::endl;
+	std::cout << "  -s, --seed SEED            The seed of the random number generator (default 1)." << std::endl;
+	std::cout << "  -e, --exhaustive           Additionally decode all 2^32 mantissas with the exponents -10 to 10. Takes several minutes." << std::endl;
+}
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t samples = 10000000;
+	uint64_t seed = 1;
+	bool exhaustive = false;
+
+	const option options[] =
+	{
+		{ "samples", required_argument, nullptr, 'n' },
+		{ "seed", required_argument, nullptr, 's' },
+		{ "exhaustive", no_argument, nullptr, 'e' },
+		{ "help", no_argument, nullptr, 'h' },
+		{ nullptr, 0, nullptr, 0 }
+	};
+	int32_t optionCharacter;
+	while((optionCharacter = getopt_long(argc, argv, "n:s:eh", options, nullptr)) != -1)
+	{
+		switch(optionCharacter)
+		{
+		case 'n':
+			samples = std::strtoull(optarg, nullptr, 10);
+			break;
+		case 's':
+			seed = std::strtoull(optarg, nullptr, 10);
+			break;
+		case 'e':
+			exhaustive = true;
+			break;
+		default:
+			printUsage();
+			return optionCharacter == 'h' ? 0 : 1;
+		}
+	}
+	if(optind != argc)
+	{
+		printUsage();
+		return 1;
+	}
+
+	std::mt19937_64 random(seed);
+	if(!checkPowers() || !checkEncoding(random, samples) || !checkDecoding(random, samples) || !checkRoundTrip(random, samples) || (exhaustive && !checkExhaustive()))
+	{
+		std::cout << "FAILED: The kernels differ from the reference implementation." << std::endl;
+		return 1;
+	}
+	benchmark(random);
+	return 0;
+}
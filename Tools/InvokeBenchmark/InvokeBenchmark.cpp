@@ -0,0 +1,278 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+/*
+ * Measures "invoke" of the RPC client under concurrency. The tool plays Homegear on localhost (see HomegearStandIn) and answers "getValue",
+ * "setValue" and "getParamset" after a configurable service time, while several threads of a Base instance call "invoke" in a loop. It
+ * reports the throughput, the latency distribution of "invoke" and the time the calls waited for the client's connection, which is shared
+ * by all threads ("client.lockWaitTime" in the metrics). Calls returning a fault are counted separately and are not part of the throughput
+ * and latency. The tool exits with code 1 when the addon doesn't initialize its connection or no call succeeds.
+ *
+ * Usage: homegear-addon-invoke-benchmark [OPTIONS]
+ *   -c, --clients COUNT        The number of threads calling "invoke" (default 4).
+ *   -t, --time SECONDS         The measuring time (default 10).
+ *   -w, --warmup SECONDS       The time "invoke" is called before measuring (default 1).
+ *   -l, --latency MICROSECONDS The time the stand-in needs to answer a request (default 0).
+ *   -m, --methods LIST         The methods to call round robin, separated by commas (default "getValue,setValue,getParamset").
+ *   -d, --debug LEVEL          The debug level of the library (default 2).
+ */
+
+#include "Base.h"
+#include "Metrics.h"
+#include "Tools/Common/HomegearStandIn.h"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstdlib>
+#include <getopt.h>
+
+using namespace HgAddonLib;
+
+namespace
+{
+/**
+ * Answers the device methods with plausible results after "latency" microseconds.
+ */
+class ServiceHomegear : public HomegearStandIn
+{
+public:
+	ServiceHomegear(uint32_t latency) : HomegearStandIn(false)
+	{
+		_latency = latency;
+		_paramset.reset(new Variable(VariableType::rpcStruct));
+		for(int32_t i = 0; i < 20; i++) _paramset->structValue->insert(RPCStructElement("PARAMETER_" + std::to_string(i), PVariable(new Variable(i * 0.5))));
+	}
+
+	virtual ~ServiceHomegear()
+	{
+		stop();
+	}
+protected:
+	virtual PVariable callMethod(const std::string& methodName, PRPCArray parameters)
+	{
+		if(methodName != "getValue" && methodName != "setValue" && methodName != "getParamset") return HomegearStandIn::callMethod(methodName, parameters);
+		if(_latency > 0) std::this_thread::sleep_for(std::chrono::microseconds(_latency));
+		if(methodName == "getValue") return PVariable(new Variable(0.5));
+		if(methodName == "getParamset") return _paramset;
+		return PVariable(new Variable());
+	}
+private:
+	uint32_t _latency = 0;
+	PVariable _paramset;
+};
+
+class BenchmarkAddon : public Base
+{
+public:
+	BenchmarkAddon(int32_t homegearPort, int32_t debugLevel) : Base(homegearPort, 1, debugLevel) {}
+	virtual ~BenchmarkAddon() {}
+};
+
+PRPCList createParameters(const std::string& methodName, uint32_t peerId)
+{
+	PRPCList parameters(new RPCList{ PVariable(new Variable(peerId)), PVariable(new Variable(1)) });
+	if(methodName == "getParamset") parameters->push_back(PVariable(new Variable("VALUES")));
+	else if(methodName == "getValue") parameters->push_back(PVariable(new Variable("LEVEL")));
+	else if(methodName == "setValue")
+	{
+		parameters->push_back(PVariable(new Variable("LEVEL")));
+		parameters->push_back(PVariable(new Variable(0.5)));
+	}
+	return parameters;
+}
+
+/**
+ * The statistics of a histogram in microseconds.
+ */
+struct Latencies
+{
+	double p50;
+	double p99;
+	double p999;
+	double max;
+	double mean;
+};
+
+Latencies getLatencies(const MetricHistogram& histogram)
+{
+	return Latencies{ histogram.getPercentile(50) / 1000.0, histogram.getPercentile(99) / 1000.0, histogram.getPercentile(99.9) / 1000.0, histogram.getMax() / 1000.0, histogram.getMean() / 1000.0 };
+}
+
+void printLatencies(const std::string& title, const Latencies& latencies)
+{
+	std::cout << title << "p50 " << latencies.p50 << ", p99 " << latencies.p99 << ", p99.9 " << latencies.p999 << ", max " << latencies.max << ", mean " << latencies.mean << std::endl;
+}
+
+void printUsage()
+{
+	std::cout << "Usage: homegear-addon-invoke-benchmark [OPTIONS]" << std::endl;
+	std::cout << "  -c, --clients COUNT        The number of threads calling \"invoke\" (default 4)." << std::endl;
+	std::cout << "  -t, --time SECONDS         The measuring time (default 10)." << std::endl;
+	std::cout << "  -w, --warmup SECONDS       The time \"invoke\" is called before measuring (default 1)." << std::endl;
+	std::cout << "  -l, --latency MICROSECONDS The time the stand-in needs to answer a request (default 0)." << std::endl;
+	std::cout << "  -m, --methods LIST         The methods to call round robin, separated by commas (default \"getValue,setValue,getParamset\")." << std::endl;
+	std::cout << "  -d, --debug LEVEL          The debug level of the library (default 2)." << std::endl;
+}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t clientCount = 4;
+	double measuringTime = 10;
+	double warmupTime = 1;
+	uint32_t latency = 0;
+	std::vector<std::string> methods{ "getValue", "setValue", "getParamset" };
+	int32_t debugLevel = 2;
+
+	const option options[] =
+	{
+		{ "clients", required_argument, nullptr, 'c' },
+		{ "time", required_argument, nullptr, 't' },
+		{ "warmup", required_argument, nullptr, 'w' },
+		{ "latency", required_argument, nullptr, 'l' },
+		{ "methods", required_argument, nullptr, 'm' },
+		{ "debug", required_argument, nullptr, 'd' },
+		{ "help", no_argument, nullptr, 'h' },
+		{ nullptr, 0, nullptr, 0 }
+	};
+	int32_t optionCharacter;
+	while((optionCharacter = getopt_long(argc, argv, "c:t:w:l:m:d:h", options, nullptr)) != -1)
+	{
+		switch(optionCharacter)
+		{
+		case 'c':
+			clientCount = std::max(1, std::atoi(optarg));
+			break;
+		case 't':
+			measuringTime = std::max(0.1, std::atof(optarg));
+			break;
+		case 'w':
+			warmupTime = std::max(0.0, std::atof(optarg));
+			break;
+		case 'l':
+			latency = std::max(0, std::atoi(optarg));
+			break;
+		case 'm':
+		{
+			methods.clear();
+			std::istringstream list(optarg);
+			std::string method;
+			while(std::getline(list, method, ',')) if(!method.empty()) methods.push_back(method);
+			if(methods.empty()) { printUsage(); return 1; }
+			break;
+		}
+		case 'd':
+			debugLevel = std::atoi(optarg);
+			break;
+		default:
+			printUsage();
+			return optionCharacter == 'h' ? 0 : 1;
+		}
+	}
+	if(optind != argc)
+	{
+		printUsage();
+		return 1;
+	}
+
+	ServiceHomegear homegear(latency);
+	if(!homegear.start()) return 1;
+	std::unique_ptr<BenchmarkAddon> addon(new BenchmarkAddon(homegear.getPort(), debugLevel));
+	if(!addon->waitForConnection(30000))
+	{
+		std::cerr << "Error: The addon did not initialize the connection." << std::endl;
+		return 1;
+	}
+	std::shared_ptr<MetricHistogram> lockWaitTimes = addon->getMetricsRegistry().getHistogram("client.lockWaitTime");
+
+	MetricHistogram latencies;
+	std::atomic_bool measuring(false);
+	std::atomic_bool stop(false);
+	std::atomic<uint64_t> invokes(0);
+	std::atomic<uint64_t> faults(0);
+	std::vector<std::thread> clients;
+	for(uint32_t i = 0; i < clientCount; i++)
+	{
+		clients.emplace_back([&, i]()
+		{
+			std::vector<PRPCList> parameters;
+			for(const std::string& method : methods) parameters.push_back(createParameters(method, 1 + i));
+			for(uint64_t j = 0; !stop; j++)
+			{
+				uint32_t index = j % methods.size();
+				int64_t startTime = MetricHistogram::now();
+				PVariable result = addon->invoke(methods[index], parameters[index]);
+				if(!measuring) continue;
+				if(result->errorStruct)
+				{
+					faults.fetch_add(1, std::memory_order_relaxed);
+					continue;
+				}
+				latencies.recordSince(startTime);
+				invokes.fetch_add(1, std::memory_order_relaxed);
+			}
+		});
+	}
+	std::this_thread::sleep_for(std::chrono::microseconds((int64_t)(warmupTime * 1000000)));
+	lockWaitTimes->reset();
+	measuring = true;
+	int64_t startTime = MetricHistogram::now();
+	std::this_thread::sleep_for(std::chrono::microseconds((int64_t)(measuringTime * 1000000)));
+	measuring = false;
+	int64_t duration = MetricHistogram::now() - startTime;
+	uint64_t measuredInvokes = invokes;
+	uint64_t measuredFaults = faults;
+	//Read before stopping, the lock wait times of later calls would be included otherwise.
+	Latencies lockWaitLatencies = getLatencies(*lockWaitTimes);
+	stop = true;
+	for(std::thread& client : clients) client.join();
+	addon.reset();
+
+	if(measuredInvokes == 0)
+	{
+		std::cerr << "Error: No invoke succeeded while measuring, " << measuredFaults << " returned a fault." << std::endl;
+		return 1;
+	}
+	double seconds = duration / 1000000000.0;
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << clientCount << " threads called successfully " << measuredInvokes << " times in " << std::setprecision(3) << seconds << " s with a service time of " << latency << " µs";
+	if(measuredFaults > 0) std::cout << ", " << measuredFaults << " further calls returned a fault";
+	std::cout << "." << std::endl;
+	std::cout << std::setprecision(1);
+	std::cout << "Throughput:         " << measuredInvokes / seconds << " invokes/s" << std::endl;
+	Latencies invokeLatencies = getLatencies(latencies);
+	printLatencies("Latency (µs):       ", invokeLatencies);
+	printLatencies("Lock wait (µs):     ", lockWaitLatencies);
+	std::cout << "Lock wait share:    " << (invokeLatencies.mean > 0 ? 100.0 * lockWaitLatencies.mean / invokeLatencies.mean : 0) << " % of the invoke time" << std::endl;
+	return 0;
+}
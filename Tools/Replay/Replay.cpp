@@ -0,0 +1,337 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+/*
+ * Replays RPC traffic captured with the flight recorder (see FlightRecorder.h) against the library. The requests Homegear sent to the addon
+ * are passed to the RPC server, either through a local socket or directly in memory. The tool plays Homegear's side of the connection,
+ * answers the addon's own requests with the recorded responses and reports throughput, latency percentiles and heap allocations.
+ *
+ * Usage: homegear-addon-replay [OPTIONS] CAPTURE_FILE
+ *   -m, --mode socket|memory   Pass the requests through a local socket (default) or call the RPC server directly.
+ *   -t, --timing fast|original Send the requests as fast as possible (default) or with the recorded intervals.
+ *   -r, --repeat COUNT         Replay the capture COUNT times (default 1).
+ *   -p, --peer ID              The peer id of the replaying addon instance (default 0, receives all events).
+ *   -d, --debug LEVEL          The debug level of the library (default 2).
+ */
+
+#include "Host.h"
+#include "Base.h"
+#include "FlightRecorder.h"
+#include "SharedObjects.h"
+#include "Encoding/RPCDecoder.h"
+#include "Tools/Common/AllocationCounter.h"
+#include "Tools/Common/HomegearStandIn.h"
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <map>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+
+using namespace HgAddonLib;
+
+namespace
+{
+struct Frame
+{
+	FlightRecorder::Direction direction = FlightRecorder::Direction::clientRequest;
+	int64_t time = 0;
+	bool truncated = false;
+	std::vector<char> data;
+};
+
+bool readCapture(const std::string& filename, std::vector<Frame>& frames)
+{
+	std::ifstream file(filename, std::ios::binary);
+	std::vector<char> content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if(!file.is_open())
+	{
+		std::cerr << "Error: Could not read " << filename << "." << std::endl;
+		return false;
+	}
+	FlightRecorder::FileHeader header;
+	if(content.size() >= sizeof(FlightRecorder::FileHeader)) std::memcpy(&header, content.data(), sizeof(FlightRecorder::FileHeader));
+	if(content.size() < sizeof(FlightRecorder::FileHeader) || std::strncmp(header.magic, "HGFR", 4) != 0 || header.version != FlightRecorder::version || content.size() < sizeof(FlightRecorder::FileHeader) + header.capacity || header.head - header.tail > header.capacity)
+	{
+		std::cerr << "Error: " << filename << " is no flight recorder capture." << std::endl;
+		return false;
+	}
+	const char* ring = content.data() + sizeof(FlightRecorder::FileHeader);
+	auto copyOut = [&](uint64_t offset, char* data, uint64_t size)
+	{
+		for(uint64_t i = 0; i < size; i++) data[i] = ring[(offset + i) % header.capacity];
+	};
+	for(uint64_t offset = header.tail; offset + sizeof(FlightRecorder::FrameHeader) <= header.head;)
+	{
+		FlightRecorder::FrameHeader frameHeader;
+		copyOut(offset, (char*)&frameHeader, sizeof(FlightRecorder::FrameHeader));
+		offset += sizeof(FlightRecorder::FrameHeader);
+		if(offset + frameHeader.size > header.head)
+		{
+			std::cerr << "Error: " << filename << " is corrupted." << std::endl;
+			return false;
+		}
+		Frame frame;
+		frame.direction = frameHeader.direction;
+		frame.time = frameHeader.time;
+		frame.truncated = frameHeader.size < frameHeader.originalSize;
+		frame.data.resize(frameHeader.size);
+		copyOut(offset, frame.data.data(), frameHeader.size);
+		offset += frameHeader.size;
+		frames.push_back(std::move(frame));
+	}
+	if(header.overwrittenFrames > 0) std::cout << "Note: " << header.overwrittenFrames << " older frames were overwritten during the capture." << std::endl;
+	return true;
+}
+
+/**
+ * Answers the requests of the addon with the response recorded for the same request. Requests without a recorded response are handled
+ * by HomegearStandIn.
+ */
+class FakeHomegear : public HomegearStandIn
+{
+public:
+	FakeHomegear(const std::vector<Frame>& frames, bool connectBack) : HomegearStandIn(connectBack)
+	{
+		for(uint32_t i = 0; i + 1 < frames.size(); i++)
+		{
+			if(frames[i].direction != FlightRecorder::Direction::clientRequest) continue;
+			//The client sends one request at a time, so the next client frame is the response.
+			for(uint32_t j = i + 1; j < frames.size(); j++)
+			{
+				if(frames[j].direction == FlightRecorder::Direction::clientRequest) break;
+				if(frames[j].direction != FlightRecorder::Direction::clientResponse) continue;
+				_responses[std::string(frames[i].data.begin(), frames[i].data.end())].push_back(frames[j].data);
+				break;
+			}
+		}
+	}
+
+	virtual ~FakeHomegear()
+	{
+		stop();
+	}
+
+	uint32_t getMatchedRequests() { return _matchedRequests; }
+	uint32_t getUnmatchedRequests() { return _unmatchedRequests; }
+protected:
+	virtual void getResponse(std::vector<char>& request, std::vector<char>& response)
+	{
+		{
+			std::lock_guard<std::mutex> responsesGuard(_responsesMutex);
+			std::string key(request.begin(), request.end());
+			std::map<std::string, std::vector<std::vector<char>>>::iterator responses = _responses.find(key);
+			if(responses != _responses.end())
+			{
+				//Requests sent multiple times get their recorded responses in order.
+				uint32_t& index = _responseIndex[key];
+				response = responses->second.at(index++ % responses->second.size());
+				_matchedRequests++;
+				return;
+			}
+		}
+		_unmatchedRequests++;
+		HomegearStandIn::getResponse(request, response);
+	}
+private:
+	std::mutex _responsesMutex;
+	std::map<std::string, std::vector<std::vector<char>>> _responses;
+	std::map<std::string, uint32_t> _responseIndex;
+	std::atomic<uint32_t> _matchedRequests{0};
+	std::atomic<uint32_t> _unmatchedRequests{0};
+};
+
+//The server answers requests it can't decode with fault -32700. Only error responses are decoded, so successful requests don't add
+//allocations to the measurement.
+bool isDecodeError(RPCDecoder& decoder, const std::vector<char>& response)
+{
+	if(response.size() < 4 || (uint8_t)response[3] != 0xFF) return false;
+	PVariable fault;
+	if(decoder.decodeResponse(response.data(), response.size(), fault) != DecodeStatus::ok || !fault->errorStruct) return false;
+	RPCStruct::iterator faultCode = fault->structValue->find("faultCode");
+	return faultCode != fault->structValue->end() && faultCode->second->integerValue == -32700;
+}
+
+class ReplayAddon : public Base
+{
+public:
+	ReplayAddon(std::shared_ptr<AddonHost> host, uint64_t peerId) : Base(host, peerId) {}
+	virtual ~ReplayAddon() {}
+};
+
+void printUsage()
+{
+	std::cout << "Usage: homegear-addon-replay [OPTIONS] CAPTURE_FILE" << std::endl;
+	std::cout << "  -m, --mode socket|memory   Pass the requests through a local socket (default) or call the RPC server directly." << std::endl;
+	std::cout << "  -t, --timing fast|original Send the requests as fast as possible (default) or with the recorded intervals." << std::endl;
+	std::cout << "  -r, --repeat COUNT         Replay the capture COUNT times (default 1)." << std::endl;
+	std::cout << "  -p, --peer ID              The peer id of the replaying addon instance (default 0, receives all events)." << std::endl;
+	std::cout << "  -d, --debug LEVEL          The debug level of the library (default 2)." << std::endl;
+}
+}
+
+int main(int argc, char** argv)
+{
+	bool inMemory = false;
+	bool originalTiming = false;
+	uint32_t repeat = 1;
+	uint64_t peerId = 0;
+	int32_t debugLevel = 2;
+
+	const option options[] =
+	{
+		{ "mode", required_argument, nullptr, 'm' },
+		{ "timing", required_argument, nullptr, 't' },
+		{ "repeat", required_argument, nullptr, 'r' },
+		{ "peer", required_argument, nullptr, 'p' },
+		{ "debug", required_argument, nullptr, 'd' },
+		{ "help", no_argument, nullptr, 'h' },
+		{ nullptr, 0, nullptr, 0 }
+	};
+	int32_t optionCharacter;
+	while((optionCharacter = getopt_long(argc, argv, "m:t:r:p:d:h", options, nullptr)) != -1)
+	{
+		switch(optionCharacter)
+		{
+		case 'm':
+			if(std::string(optarg) != "socket" && std::string(optarg) != "memory") { printUsage(); return 1; }
+			inMemory = std::string(optarg) == "memory";
+			break;
+		case 't':
+			if(std::string(optarg) != "fast" && std::string(optarg) != "original") { printUsage(); return 1; }
+			originalTiming = std::string(optarg) == "original";
+			break;
+		case 'r':
+			repeat = std::max(1, std::atoi(optarg));
+			break;
+		case 'p':
+			peerId = std::strtoull(optarg, nullptr, 10);
+			break;
+		case 'd':
+			debugLevel = std::atoi(optarg);
+			break;
+		default:
+			printUsage();
+			return optionCharacter == 'h' ? 0 : 1;
+		}
+	}
+	if(optind != argc - 1)
+	{
+		printUsage();
+		return 1;
+	}
+
+	std::vector<Frame> frames;
+	if(!readCapture(argv[optind], frames)) return 1;
+	std::vector<const Frame*> requests;
+	uint32_t truncatedRequests = 0;
+	for(const Frame& frame : frames)
+	{
+		if(frame.direction != FlightRecorder::Direction::serverRequest) continue;
+		//Truncated frames can't be decoded.
+		if(frame.truncated) truncatedRequests++;
+		else requests.push_back(&frame);
+	}
+	std::cout << "Capture: " << frames.size() << " frames, " << requests.size() << " requests to replay";
+	if(truncatedRequests > 0) std::cout << " (" << truncatedRequests << " truncated requests skipped)";
+	std::cout << "." << std::endl;
+	if(requests.empty()) return 0;
+
+	FakeHomegear homegear(frames, !inMemory);
+	if(!homegear.start()) return 1;
+	std::shared_ptr<AddonHost> host = std::make_shared<AddonHost>(homegear.getPort(), debugLevel);
+	std::unique_ptr<ReplayAddon> addon(new ReplayAddon(host, peerId));
+	int32_t callbackSocket = -1;
+	if(!inMemory)
+	{
+		callbackSocket = homegear.waitForCallbackSocket(30000);
+		if(callbackSocket == -1)
+		{
+			std::cerr << "Error: The addon did not initialize the connection." << std::endl;
+			return 1;
+		}
+	}
+
+	std::vector<int64_t> latencies;
+	latencies.reserve(requests.size() * repeat);
+	std::vector<char> packet;
+	std::vector<char> response;
+	packet.reserve(65536);
+	response.reserve(65536);
+	uint64_t bytes = 0;
+	uint32_t failedRequests = 0;
+	SharedObjects codecs;
+	RPCDecoder decoder(&codecs);
+	AllocationCounter::start();
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	for(uint32_t i = 0; i < repeat; i++)
+	{
+		std::chrono::steady_clock::time_point repetitionStartTime = std::chrono::steady_clock::now();
+		for(const Frame* request : requests)
+		{
+			if(originalTiming) std::this_thread::sleep_until(repetitionStartTime + std::chrono::nanoseconds(request->time - requests.front()->time));
+			packet.assign(request->data.begin(), request->data.end());
+			std::chrono::steady_clock::time_point requestTime = std::chrono::steady_clock::now();
+			if(inMemory) host->processPacket(packet, response);
+			else if(!writeAll(callbackSocket, packet.data(), packet.size()) || !readFrame(callbackSocket, response))
+			{
+				AllocationCounter::stop();
+				std::cerr << "Error: The connection to the addon was closed." << std::endl;
+				return 1;
+			}
+			latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - requestTime).count());
+			if(isDecodeError(decoder, response)) failedRequests++;
+			bytes += packet.size();
+		}
+	}
+	int64_t duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+	AllocationCounter::stop();
+
+	std::sort(latencies.begin(), latencies.end());
+	auto percentile = [&](double p) { return latencies.at(std::min((size_t)(p * latencies.size()), latencies.size() - 1)) / 1000.0; };
+	double seconds = duration / 1000000000.0;
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Replayed " << latencies.size() << " requests in " << std::setprecision(3) << seconds << " s";
+	if(failedRequests > 0) std::cout << " (" << failedRequests << " could not be decoded)";
+	std::cout << "." << std::endl << std::setprecision(1);
+	std::cout << "Throughput: " << latencies.size() / seconds << " requests/s, " << bytes / seconds / 1048576 << " MiB/s" << std::endl;
+	std::cout << "Latency (us): p50 " << percentile(0.5) << ", p90 " << percentile(0.9) << ", p99 " << percentile(0.99) << ", p99.9 " << percentile(0.999) << ", max " << latencies.back() / 1000.0 << std::endl;
+	std::cout << "Allocations: " << AllocationCounter::getAllocations() << " (" << (double)AllocationCounter::getAllocations() / latencies.size() << " per request), " << AllocationCounter::getAllocatedBytes() << " bytes" << std::endl;
+	std::cout << "Addon requests answered from the capture: " << homegear.getMatchedRequests() << ", not recorded: " << homegear.getUnmatchedRequests() << std::endl;
+
+	addon.reset();
+	host.reset();
+	return 0;
+}
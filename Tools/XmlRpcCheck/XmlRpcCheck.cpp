@@ -0,0 +1,459 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+/*
+ * Verifies the XML-RPC codec (XMLRPCEncoder/XMLRPCDecoder). Random Variable trees are encoded as request, response and fault and have to
+ * decode to the same tree again. Text split into CDATA sections has to decode completely. Values XML-RPC can't represent have to be
+ * rejected by the encoder. Documents nested deeper than the limits of the decoder have to be rejected without being parsed, also when the
+ * closing tags are hidden in comments, CDATA sections, processing instructions or a DOCTYPE. Finally mutated and truncated packets are
+ * decoded, which must not crash. The tool exits with code 1 on the first failure.
+ *
+ * Usage: homegear-addon-xmlrpc-check [OPTIONS]
+ *   -n, --samples COUNT        The number of random trees and mutated packets (default 100000).
+ *   -s, --seed SEED            The seed of the random number generator (default 1).
+ */
+
+#include "SharedObjects.h"
+#include "Encoding/XMLRPCDecoder.h"
+#include "Encoding/XMLRPCEncoder.h"
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <cstdlib>
+#include <getopt.h>
+
+using namespace HgAddonLib;
+
+namespace
+{
+const uint32_t maxNestingDepth = 512;
+
+std::string randomString(std::mt19937_64& random)
+{
+	//Printable characters, whitespace, the characters XML needs to escape and multi byte UTF-8 characters.
+	static const std::vector<std::string> characters{ "a", "Z", "0", " ", "\t", "\n", "\r", "\r\n", "<", ">", "&", "\"", "'", ";", "#", "]]>", "\xC3\xA4", "\xE2\x82\xAC", "\xF0\x9F\x98\x80" };
+	std::string result;
+	uint32_t length = random() % 20;
+	for(uint32_t i = 0; i < length; i++) result.append(characters.at(random() % characters.size()));
+	return result;
+}
+
+double randomDouble(std::mt19937_64& random)
+{
+	if(random() % 2) return (double)(int32_t)random() / 100;
+	double value = 0;
+	do
+	{
+		uint64_t bits = random();
+		std::memcpy(&value, &bits, sizeof(double));
+	} while(std::isnan(value) || std::isinf(value));
+	return value;
+}
+
+PVariable randomVariable(std::mt19937_64& random, uint32_t depth)
+{
+	switch(random() % (depth < 4 ? 7 : 5))
+	{
+	case 0:
+		return PVariable(new Variable((int32_t)random()));
+	case 1:
+		return PVariable(new Variable(random() % 2 == 1));
+	case 2:
+		return PVariable(new Variable(randomString(random)));
+	case 3:
+		return PVariable(new Variable(randomDouble(random)));
+	case 4:
+	{
+		PVariable variable(new Variable(VariableType::rpcBase64));
+		variable->stringValue = "SG9tZWdlYXI=";
+		return variable;
+	}
+	case 5:
+	{
+		PVariable variable(new Variable(VariableType::rpcArray));
+		uint32_t size = random() % 5;
+		for(uint32_t i = 0; i < size; i++) variable->arrayValue->push_back(randomVariable(random, depth + 1));
+		return variable;
+	}
+	default:
+	{
+		PVariable variable(new Variable(VariableType::rpcStruct));
+		uint32_t size = random() % 5;
+		for(uint32_t i = 0; i < size; i++) variable->structValue->insert(RPCStructElement(randomString(random), randomVariable(random, depth + 1)));
+		return variable;
+	}
+	}
+}
+
+//Variable::operator== doesn't compare the elements of arrays and structs and compares floats by value.
+bool equal(const PVariable& value1, const PVariable& value2)
+{
+	if(!value1 || !value2 || value1->type != value2->type) return false;
+	switch(value1->type)
+	{
+	case VariableType::rpcInteger:
+		return value1->integerValue == value2->integerValue;
+	case VariableType::rpcBoolean:
+		return value1->booleanValue == value2->booleanValue;
+	case VariableType::rpcFloat:
+		return std::memcmp(&value1->floatValue, &value2->floatValue, sizeof(double)) == 0;
+	case VariableType::rpcString:
+	case VariableType::rpcBase64:
+		return value1->stringValue == value2->stringValue;
+	case VariableType::rpcArray:
+		if(value1->arrayValue->size() != value2->arrayValue->size()) return false;
+		for(uint32_t i = 0; i < value1->arrayValue->size(); i++)
+		{
+			if(!equal(value1->arrayValue->at(i), value2->arrayValue->at(i))) return false;
+		}
+		return true;
+	case VariableType::rpcStruct:
+		if(value1->structValue->size() != value2->structValue->size()) return false;
+		for(RPCStruct::iterator i = value1->structValue->begin(), j = value2->structValue->begin(); i != value1->structValue->end(); ++i, ++j)
+		{
+			if(i->first != j->first || !equal(i->second, j->second)) return false;
+		}
+		return true;
+	default:
+		return true;
+	}
+}
+
+PVariable nestedArray(uint32_t depth)
+{
+	PVariable variable(new Variable(1));
+	for(uint32_t i = 0; i < depth; i++)
+	{
+		PVariable array(new Variable(VariableType::rpcArray));
+		array->arrayValue->push_back(variable);
+		variable = array;
+	}
+	return variable;
+}
+
+std::vector<char> createRequest(const std::string& body)
+{
+	std::string packet = "POST /RPC2 HTTP/1.1\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+	return std::vector<char>(packet.begin(), packet.end());
+}
+
+std::string repeat(const std::string& text, uint32_t count)
+{
+	std::string result;
+	result.reserve(text.size() * count);
+	for(uint32_t i = 0; i < count; i++) result.append(text);
+	return result;
+}
+
+bool checkRoundTrip(XMLRPCEncoder& encoder, XMLRPCDecoder& decoder, std::mt19937_64& random, uint64_t samples)
+{
+	std::cout << "Round trip... " << std::flush;
+	std::vector<char> packet;
+	for(uint64_t i = 0; i < samples; i++)
+	{
+		PRPCList parameters(new RPCList());
+		uint32_t count = random() % 5;
+		for(uint32_t j = 0; j < count; j++) parameters->push_back(randomVariable(random, 0));
+		std::string methodName = randomString(random) + "m";
+		encoder.encodeRequest(methodName, parameters, packet);
+		std::string decodedMethodName;
+		PRPCArray decodedParameters;
+		DecodeStatus status = decoder.decodeRequest(packet, decodedMethodName, decodedParameters);
+		bool equalParameters = status == DecodeStatus::ok && decodedMethodName == methodName && decodedParameters->size() == parameters->size();
+		uint32_t index = 0;
+		for(RPCList::iterator j = parameters->begin(); equalParameters && j != parameters->end(); ++j, ++index)
+		{
+			equalParameters = equal(*j, decodedParameters->at(index));
+		}
+		if(!equalParameters)
+		{
+			std::cout << "FAILED: Request " << i << " doesn't decode to itself (" << RPCDecoder::getStatusString(status) << ")." << std::endl;
+			return false;
+		}
+
+		PVariable response = randomVariable(random, 0);
+		encoder.encodeResponse(response, packet);
+		PVariable decodedResponse;
+		status = decoder.decodeResponse(packet, decodedResponse);
+		if(status != DecodeStatus::ok || !equal(response, decodedResponse))
+		{
+			std::cout << "FAILED: Response " << i << " doesn't decode to itself (" << RPCDecoder::getStatusString(status) << ")." << std::endl;
+			return false;
+		}
+	}
+	//Void is sent as "<nil/>", faults are returned with "errorStruct" set.
+	PVariable decodedResponse;
+	encoder.encodeResponse(PVariable(new Variable(VariableType::rpcVoid)), packet);
+	if(decoder.decodeResponse(packet, decodedResponse) != DecodeStatus::ok || decodedResponse->type != VariableType::rpcVoid)
+	{
+		std::cout << "FAILED: Void response." << std::endl;
+		return false;
+	}
+	PVariable voidArray(new Variable(VariableType::rpcArray));
+	voidArray->arrayValue->push_back(PVariable(new Variable(VariableType::rpcVoid)));
+	std::string decodedMethodName;
+	PRPCArray decodedParameters;
+	encoder.encodeRequest("event", PRPCList(new RPCList{ PVariable(new Variable(VariableType::rpcVoid)), voidArray }), packet);
+	if(decoder.decodeRequest(packet, decodedMethodName, decodedParameters) != DecodeStatus::ok || decodedParameters->size() != 2 || decodedParameters->at(0)->type != VariableType::rpcVoid || !equal(voidArray, decodedParameters->at(1)))
+	{
+		std::cout << "FAILED: Void parameters." << std::endl;
+		return false;
+	}
+	PVariable fault = Variable::createError(-32601, "<Requested method not found.>");
+	encoder.encodeResponse(fault, packet);
+	if(decoder.decodeResponse(packet, decodedResponse) != DecodeStatus::ok || !decodedResponse->errorStruct || !equal(fault, decodedResponse))
+	{
+		std::cout << "FAILED: Fault response." << std::endl;
+		return false;
+	}
+	std::cout << "OK" << std::endl;
+	return true;
+}
+
+bool checkText(XMLRPCDecoder& decoder)
+{
+	std::cout << "Text and CDATA sections... " << std::flush;
+	const std::vector<std::pair<std::string, std::string>> values
+	{
+		{ "<string><![CDATA[a<b]]></string>", "a<b" },
+		{ "<string>a&amp;<![CDATA[<b>&amp;]]> c</string>", "a&<b>&amp; c" },
+		{ "<string> <![CDATA[x]]><![CDATA[y]]> </string>", " xy " },
+		{ "<string><![CDATA[]]></string>", "" },
+		{ "<![CDATA[ <i4>1</i4> ]]>", " <i4>1</i4> " },
+		{ "<string> \t </string>", " \t " },
+		{ "<string/>", "" },
+	};
+	std::vector<char> packet;
+	std::string methodName;
+	PRPCArray parameters;
+	for(const std::pair<std::string, std::string>& value : values)
+	{
+		packet = createRequest("<methodCall><methodName>event</methodName><params><param><value>" + value.first + "</value></param></params></methodCall>");
+		DecodeStatus status = decoder.decodeRequest(packet, methodName, parameters);
+		if(status != DecodeStatus::ok || parameters->size() != 1 || parameters->at(0)->type != VariableType::rpcString || parameters->at(0)->stringValue != value.second)
+		{
+			std::cout << "FAILED: \"" << value.first << "\" didn't decode to \"" << value.second << "\" (" << RPCDecoder::getStatusString(status) << ")." << std::endl;
+			return false;
+		}
+	}
+	std::cout << "OK" << std::endl;
+	return true;
+}
+
+bool checkUnrepresentable(XMLRPCEncoder& encoder, XMLRPCDecoder& decoder)
+{
+	std::cout << "Unrepresentable values... " << std::flush;
+	PVariable structWithControlCharacter(new Variable(VariableType::rpcStruct));
+	structWithControlCharacter->structValue->insert(RPCStructElement(std::string("KEY\x01"), PVariable(new Variable(1))));
+	PVariable arrayWithNaN(new Variable(VariableType::rpcArray));
+	arrayWithNaN->arrayValue->push_back(PVariable(new Variable(std::numeric_limits<double>::quiet_NaN())));
+	const std::vector<PVariable> values
+	{
+		PVariable(new Variable(std::string("a\x01b"))),
+		PVariable(new Variable(std::string("\x00", 1))),
+		PVariable(new Variable(std::string("\x1F"))),
+		PVariable(new Variable(std::numeric_limits<double>::infinity())),
+		PVariable(new Variable(-std::numeric_limits<double>::infinity())),
+		structWithControlCharacter,
+		arrayWithNaN,
+	};
+	std::vector<char> packet;
+	for(uint32_t i = 0; i < values.size(); i++)
+	{
+		if(encoder.encodeRequest("event", PRPCList(new RPCList{ values[i] }), packet) || !packet.empty())
+		{
+			std::cout << "FAILED: Request with value " << i << " was encoded." << std::endl;
+			return false;
+		}
+		encoder.encodeResponse(values[i], packet);
+		PVariable response;
+		if(decoder.decodeResponse(packet, response) != DecodeStatus::ok || !response->errorStruct || response->structValue->at("faultCode")->integerValue != -32603)
+		{
+			std::cout << "FAILED: Response with value " << i << " wasn't replaced by a fault." << std::endl;
+			return false;
+		}
+	}
+	if(encoder.encodeRequest("a\x02", PRPCList(new RPCList()), packet))
+	{
+		std::cout << "FAILED: Method name with control character was encoded." << std::endl;
+		return false;
+	}
+	std::cout << "OK" << std::endl;
+	return true;
+}
+
+bool checkNesting(XMLRPCEncoder& encoder, XMLRPCDecoder& decoder)
+{
+	std::cout << "Nesting limits... " << std::flush;
+	std::vector<char> packet;
+	std::string methodName;
+	PRPCArray parameters;
+	for(uint32_t depth : { maxNestingDepth, maxNestingDepth + 1 })
+	{
+		encoder.encodeRequest("deep", PRPCList(new RPCList{ nestedArray(depth) }), packet);
+		DecodeStatus expectedStatus = depth <= maxNestingDepth ? DecodeStatus::ok : DecodeStatus::nestingTooDeep;
+		DecodeStatus status = decoder.decodeRequest(packet, methodName, parameters);
+		if(status != expectedStatus)
+		{
+			std::cout << "FAILED: Array nested " << depth << " levels deep returned \"" << RPCDecoder::getStatusString(status) << "\"." << std::endl;
+			return false;
+		}
+	}
+
+	//Deep documents RapidXml would overflow the stack with. Every variant has to be rejected before parsing.
+	const uint32_t depth = 100000;
+	const std::vector<std::pair<std::string, std::string>> documents
+	{
+		{ "elements", "<methodCall>" + repeat("<a>", depth) + repeat("</a>", depth) + "</methodCall>" },
+		{ "comments", "<methodCall>" + repeat("<a><!-- </a> -->", depth) + "</methodCall>" },
+		{ "CDATA sections", "<methodCall>" + repeat("<a><![CDATA[ </a> ]]>", depth) + "</methodCall>" },
+		{ "processing instructions", "<methodCall>" + repeat("<a><?x </a> ?>", depth) + "</methodCall>" },
+		{ "DOCTYPEs", "<methodCall>" + repeat("<a><!DOCTYPE x [ > </a> ]>", depth) + "</methodCall>" },
+		{ "attributes", "<methodCall>" + repeat("<a x=\"/>\">", depth) + "</methodCall>" },
+	};
+	for(const std::pair<std::string, std::string>& document : documents)
+	{
+		packet = createRequest(document.second);
+		DecodeStatus status = decoder.decodeRequest(packet, methodName, parameters);
+		if(status == DecodeStatus::ok)
+		{
+			std::cout << "FAILED: Deep document with " << document.first << " was accepted." << std::endl;
+			return false;
+		}
+		std::string body = "<methodResponse>" + document.second + "</methodResponse>";
+		std::string response = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+		packet.assign(response.begin(), response.end());
+		PVariable decodedResponse;
+		status = decoder.decodeResponse(packet, decodedResponse);
+		if(status == DecodeStatus::ok)
+		{
+			std::cout << "FAILED: Deep response with " << document.first << " was accepted." << std::endl;
+			return false;
+		}
+	}
+	std::cout << "OK" << std::endl;
+	return true;
+}
+
+bool checkMalformed(XMLRPCEncoder& encoder, XMLRPCDecoder& decoder, std::mt19937_64& random, uint64_t samples)
+{
+	std::cout << "Mutated and truncated packets... " << std::flush;
+	std::vector<char> original;
+	std::vector<char> packet;
+	std::string methodName;
+	PRPCArray parameters;
+	PVariable response;
+	static const char replacements[] = { '<', '>', '/', '!', '?', '[', ']', '-', '"', '&', ';', '#', 0 };
+	for(uint64_t i = 0; i < samples; i++)
+	{
+		PVariable value = randomVariable(random, 0);
+		if(i % 2) encoder.encodeRequest("event", PRPCList(new RPCList{ value }), original);
+		else encoder.encodeResponse(value, original);
+		packet = original;
+		uint32_t headerSize = 0;
+		uint32_t contentLength = 0;
+		XMLRPCDecoder::getMessageSize(packet.data(), packet.size(), headerSize, contentLength);
+		if(random() % 4 == 0) packet.resize(random() % packet.size());
+		else
+		{
+			uint32_t mutations = 1 + random() % 4;
+			for(uint32_t j = 0; j < mutations && packet.size() > headerSize; j++)
+			{
+				char& character = packet.at(headerSize + random() % (packet.size() - headerSize));
+				character = random() % 2 ? replacements[random() % sizeof(replacements)] : (char)random();
+			}
+		}
+		if(i % 2) decoder.decodeRequest(packet, methodName, parameters);
+		else decoder.decodeResponse(packet, response);
+	}
+	std::cout << "OK" << std::endl;
+	return true;
+}
+
+void printUsage()
+{
+	std::cout << "Usage: homegear-addon-xmlrpc-check [OPTIONS]" << std::endl;
+	std::cout << "  -n, --samples COUNT        The number of random trees and mutated packets (default 100000)." << std::endl;
+	std::cout << "  -s, --seed SEED            The seed of the random number generator (default 1)." << std::endl;
+}
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t samples = 100000;
+	uint64_t seed = 1;
+
+	const option options[] =
+	{
+		{ "samples", required_argument, nullptr, 'n' },
+		{ "seed", required_argument, nullptr, 's' },
+		{ "help", no_argument, nullptr, 'h' },
+		{ nullptr, 0, nullptr, 0 }
+	};
+	int32_t optionCharacter;
+	while((optionCharacter = getopt_long(argc, argv, "n:s:h", options, nullptr)) != -1)
+	{
+		switch(optionCharacter)
+		{
+		case 'n':
+			samples = std::strtoull(optarg, nullptr, 10);
+			break;
+		case 's':
+			seed = std::strtoull(optarg, nullptr, 10);
+			break;
+		default:
+			printUsage();
+			return optionCharacter == 'h' ? 0 : 1;
+		}
+	}
+	if(optind != argc)
+	{
+		printUsage();
+		return 1;
+	}
+
+	SharedObjects bl;
+	//Rejecting unrepresentable values is logged as error, which is expected here.
+	bl.debugLevel = 1;
+	XMLRPCEncoder encoder(&bl);
+	XMLRPCDecoder decoder(&bl);
+	std::mt19937_64 random(seed);
+	if(!checkRoundTrip(encoder, decoder, random, samples) || !checkText(decoder) || !checkUnrepresentable(encoder, decoder) || !checkNesting(encoder, decoder) || !checkMalformed(encoder, decoder, random, samples))
+	{
+		std::cout << "FAILED: The XML-RPC codec is broken." << std::endl;
+		return 1;
+	}
+	return 0;
+}
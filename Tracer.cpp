@@ -0,0 +1,232 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "Tracer.h"
+#include "SharedObjects.h"
+
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+namespace HgAddonLib
+{
+namespace
+{
+	std::atomic<uint64_t> nextTracerId(1);
+
+	//The last buffer used by the thread. The tracer id instead of a pointer identifies the tracer, because a new tracer can get the
+	//address of a destroyed one.
+	struct CachedThreadBuffer
+	{
+		uint64_t tracerId = 0;
+		void* buffer = nullptr;
+	};
+	thread_local CachedThreadBuffer cachedThreadBuffer;
+
+	void appendJsonString(std::string& json, const char* value, uint32_t size)
+	{
+		json.push_back('"');
+		for(uint32_t i = 0; i < size; i++)
+		{
+			char c = value[i];
+			if(c == '"' || c == '\\')
+			{
+				json.push_back('\\');
+				json.push_back(c);
+			}
+			else if((unsigned char)c < 0x20)
+			{
+				char escaped[7];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)c);
+				json.append(escaped);
+			}
+			else json.push_back(c);
+		}
+		json.push_back('"');
+	}
+
+	void appendMicroseconds(std::string& json, int64_t nanoseconds)
+	{
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%.3f", (double)nanoseconds / 1000.0);
+		json.append(buffer);
+	}
+}
+
+Tracer::Tracer(SharedObjects* bl) : _id(nextTracerId.fetch_add(1)), _enabled(false), _eventsPerThread(16384)
+{
+	_bl = bl;
+}
+
+void Tracer::start(uint32_t eventsPerThread)
+{
+	if(eventsPerThread < 16) eventsPerThread = 16;
+	_enabled = false;
+	{
+		std::lock_guard<std::mutex> buffersGuard(_buffersMutex);
+		_eventsPerThread = eventsPerThread;
+		//Memory of threads, which don't record anymore, is released. The other threads allocate their buffer again on the next span.
+		for(std::vector<std::unique_ptr<ThreadBuffer>>::iterator i = _buffers.begin(); i != _buffers.end(); ++i)
+		{
+			std::lock_guard<std::mutex> bufferGuard((*i)->mutex);
+			std::vector<Event>().swap((*i)->events);
+			(*i)->written = 0;
+		}
+	}
+	if(!HGADDON_TRACING) HGADDON_PRINT_INFO(_bl->out, "Info: The library was built without HGADDON_TRACING. Only spans of the addon are recorded.");
+	_enabled = true;
+}
+
+void Tracer::stop()
+{
+	_enabled = false;
+}
+
+Tracer::ThreadBuffer* Tracer::getThreadBuffer()
+{
+	if(cachedThreadBuffer.tracerId == _id) return (ThreadBuffer*)cachedThreadBuffer.buffer;
+	int32_t threadId = syscall(SYS_gettid);
+	ThreadBuffer* buffer = nullptr;
+	{
+		std::lock_guard<std::mutex> buffersGuard(_buffersMutex);
+		for(std::vector<std::unique_ptr<ThreadBuffer>>::iterator i = _buffers.begin(); i != _buffers.end(); ++i)
+		{
+			if((*i)->threadId == threadId)
+			{
+				buffer = i->get();
+				break;
+			}
+		}
+		if(!buffer)
+		{
+			_buffers.push_back(std::unique_ptr<ThreadBuffer>(new ThreadBuffer()));
+			buffer = _buffers.back().get();
+			buffer->threadId = threadId;
+			char threadName[16];
+			if(pthread_getname_np(pthread_self(), threadName, sizeof(threadName)) == 0) buffer->threadName = threadName;
+		}
+	}
+	cachedThreadBuffer.tracerId = _id;
+	cachedThreadBuffer.buffer = buffer;
+	return buffer;
+}
+
+void Tracer::record(const char* name, int64_t start, int64_t duration, const char* detail, uint32_t detailSize)
+{
+	if(!enabled()) return;
+	ThreadBuffer* buffer = getThreadBuffer();
+	//Only contended while the spans are exported.
+	std::lock_guard<std::mutex> bufferGuard(buffer->mutex);
+	if(buffer->events.empty()) buffer->events.resize(_eventsPerThread.load(std::memory_order_relaxed));
+	Event& event = buffer->events[buffer->written % buffer->events.size()];
+	event.start = start;
+	event.duration = duration;
+	event.name = name;
+	if(detailSize > sizeof(event.detail)) detailSize = sizeof(event.detail);
+	event.detailSize = detailSize;
+	if(detailSize > 0) memcpy(event.detail, detail, detailSize);
+	buffer->written++;
+}
+
+std::string Tracer::getChromeTrace()
+{
+	int64_t startTime = std::chrono::duration_cast<std::chrono::nanoseconds>(_bl->startTime.time_since_epoch()).count();
+	std::string processId = std::to_string(getpid());
+	std::string json;
+	json.reserve(1048576);
+	json.append("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	json.append("{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":" + processId + ",\"args\":{\"name\":\"homegear-addon\"}}");
+	std::lock_guard<std::mutex> buffersGuard(_buffersMutex);
+	for(std::vector<std::unique_ptr<ThreadBuffer>>::iterator i = _buffers.begin(); i != _buffers.end(); ++i)
+	{
+		std::lock_guard<std::mutex> bufferGuard((*i)->mutex);
+		if((*i)->written == 0) continue;
+		std::string threadId = std::to_string((*i)->threadId);
+		std::string threadName = (*i)->threadName.empty() ? "Thread " + threadId : (*i)->threadName;
+		json.append(",{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" + processId + ",\"tid\":" + threadId + ",\"args\":{\"name\":");
+		appendJsonString(json, threadName.data(), threadName.size());
+		json.append("}}");
+		uint64_t size = (*i)->events.size();
+		uint64_t first = (*i)->written > size ? (*i)->written - size : 0;
+		for(uint64_t j = first; j < (*i)->written; j++)
+		{
+			const Event& event = (*i)->events[j % size];
+			json.append(",{\"ph\":\"X\",\"cat\":\"hgaddon\",\"name\":");
+			appendJsonString(json, event.name, strlen(event.name));
+			json.append(",\"pid\":" + processId + ",\"tid\":" + threadId + ",\"ts\":");
+			appendMicroseconds(json, event.start - startTime);
+			json.append(",\"dur\":");
+			appendMicroseconds(json, event.duration);
+			if(event.detailSize > 0)
+			{
+				json.append(",\"args\":{\"detail\":");
+				appendJsonString(json, event.detail, event.detailSize);
+				json.push_back('}');
+			}
+			json.push_back('}');
+		}
+	}
+	json.append("]}\n");
+	return json;
+}
+
+bool Tracer::exportChromeTrace(std::string filename)
+{
+	try
+	{
+		std::string json = getChromeTrace();
+		std::ofstream file(filename, std::ios::out | std::ios::trunc | std::ios::binary);
+		if(!file.is_open())
+		{
+			_bl->out.printError("Error: Could not open trace file " + filename + ".");
+			return false;
+		}
+		file.write(json.data(), json.size());
+		file.close();
+		return file.good();
+	}
+	catch(const std::exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(Exception& ex)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    catch(...)
+    {
+    	_bl->out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+    return false;
+}
+
+}
@@ -0,0 +1,207 @@
+/* Copyright 2013-2015 Sathya Laufer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef TRACER_H_
+#define TRACER_H_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * Set to 1 to compile the tracing spans of the library into the code paths of the RPC client and server, e. g. with "premake4 --tracing
+ * gmake". When 0, the HGADDON_TRACE macros expand to nothing, so the spans cost nothing at all. The setting applies per translation
+ * unit: an addon using the macros has to define HGADDON_TRACING=1 itself. Tracer and TraceSpan are always available, so the addon can
+ * record spans with them directly, no matter how the library was built.
+ */
+#ifndef HGADDON_TRACING
+#define HGADDON_TRACING 0
+#endif
+
+#define HGADDON_TRACE_CONCAT_IMPL(a, b) a##b
+#define HGADDON_TRACE_CONCAT(a, b) HGADDON_TRACE_CONCAT_IMPL(a, b)
+
+/**
+ * Macros to record spans. HGADDON_TRACE_SPAN records the time until the end of the enclosing scope, e. g.:
+ * HGADDON_TRACE_SPAN(_bl->tracer, "decodeRequest"); The name must be a string literal. HGADDON_TRACE_SPAN_DETAIL additionally stores up to
+ * 39 characters of a detail text like a method name. HGADDON_TRACE_NOW and HGADDON_TRACE_COMPLETE record spans, which don't match a scope.
+ */
+#if HGADDON_TRACING
+#define HGADDON_TRACE_SPAN(tracer, name) HgAddonLib::TraceSpan HGADDON_TRACE_CONCAT(hgaddonTraceSpan, __LINE__)(tracer, name)
+#define HGADDON_TRACE_SPAN_DETAIL(tracer, name, detail, detailSize) HgAddonLib::TraceSpan HGADDON_TRACE_CONCAT(hgaddonTraceSpan, __LINE__)(tracer, name, detail, detailSize)
+#define HGADDON_TRACE_NOW() HgAddonLib::Tracer::now()
+#define HGADDON_TRACE_COMPLETE(tracer, name, startTime) do { if((tracer).enabled()) (tracer).record(name, startTime, HgAddonLib::Tracer::now() - (startTime)); } while(0)
+#else
+#define HGADDON_TRACE_SPAN(tracer, name)
+#define HGADDON_TRACE_SPAN_DETAIL(tracer, name, detail, detailSize)
+#define HGADDON_TRACE_NOW() 0
+#define HGADDON_TRACE_COMPLETE(tracer, name, startTime) ((void)(startTime))
+#endif
+
+namespace HgAddonLib
+{
+class SharedObjects;
+
+/**
+ * Records timed spans into per thread ring buffers and exports them in the trace event format of Chrome, which can be opened with
+ * Perfetto (https://ui.perfetto.dev) or chrome://tracing. Every thread writes to its own buffer, so threads never wait for each other.
+ * When a buffer is full, the oldest spans of the thread are overwritten.
+ */
+class Tracer
+{
+public:
+	/**
+	 * One recorded span. 64 bytes, so one span is one cache line.
+	 */
+	struct Event
+	{
+		/**
+		 * The start time as returned by "now".
+		 */
+		int64_t start;
+		int64_t duration;
+		const char* name;
+		uint8_t detailSize;
+		char detail[39];
+	};
+
+	Tracer(SharedObjects* bl);
+	virtual ~Tracer() {}
+
+	/**
+	 * Returns the current time of a monotonic clock in nanoseconds.
+	 */
+	static int64_t now() { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+	/**
+	 * Returns true when spans are recorded. Only one relaxed atomic load, so it can be checked for every span.
+	 */
+	bool enabled() const { return _enabled.load(std::memory_order_relaxed); }
+
+	/**
+	 * Starts recording. Spans recorded before are discarded.
+	 *
+	 * @param eventsPerThread The number of spans kept per thread. Each span needs 64 bytes. The buffer of a thread is allocated when it
+	 * records its first span.
+	 */
+	void start(uint32_t eventsPerThread = 16384);
+
+	/**
+	 * Stops recording. The recorded spans are kept until the next start, so they can still be exported.
+	 */
+	void stop();
+
+	/**
+	 * Records one span. Does nothing when the tracer is not enabled.
+	 *
+	 * @param name The name of the span. Only the pointer is stored, so it must be a string literal.
+	 * @param start The start time as returned by "now".
+	 * @param duration The duration in nanoseconds.
+	 * @param detail An optional detail text. Up to 39 characters are copied.
+	 * @param detailSize The length of "detail".
+	 */
+	void record(const char* name, int64_t start, int64_t duration, const char* detail = nullptr, uint32_t detailSize = 0);
+
+	/**
+	 * Returns the recorded spans of all threads as Chrome trace event JSON.
+	 */
+	std::string getChromeTrace();
+
+	/**
+	 * Writes the recorded spans of all threads as Chrome trace event JSON to a file.
+	 *
+	 * @param filename The file to write. It is overwritten.
+	 * @return Returns true on success.
+	 */
+	bool exportChromeTrace(std::string filename);
+private:
+	struct ThreadBuffer
+	{
+		std::mutex mutex;
+		int32_t threadId = 0;
+		std::string threadName;
+		std::vector<Event> events;
+		uint64_t written = 0;
+	};
+
+	SharedObjects* _bl = nullptr;
+	const uint64_t _id;
+	std::atomic_bool _enabled;
+	std::atomic<uint32_t> _eventsPerThread;
+
+	//Buffers are only released with the tracer, because threads keep a pointer to their buffer.
+	std::mutex _buffersMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> _buffers;
+
+	ThreadBuffer* getThreadBuffer();
+
+	Tracer(const Tracer&);
+	Tracer& operator=(const Tracer&);
+};
+
+/**
+ * Records the time from its construction to its destruction as one span. Use it through the HGADDON_TRACE_SPAN macros.
+ */
+class TraceSpan
+{
+public:
+	TraceSpan(Tracer& tracer, const char* name) : _tracer(tracer.enabled() ? &tracer : nullptr), _name(name)
+	{
+		if(_tracer) _start = Tracer::now();
+	}
+
+	/**
+	 * @param detail A detail text, e. g. a method name. It must be valid until the span is destroyed.
+	 */
+	TraceSpan(Tracer& tracer, const char* name, const char* detail, uint32_t detailSize) : _tracer(tracer.enabled() ? &tracer : nullptr), _name(name), _detail(detail), _detailSize(detailSize)
+	{
+		if(_tracer) _start = Tracer::now();
+	}
+
+	~TraceSpan()
+	{
+		if(_tracer) _tracer->record(_name, _start, Tracer::now() - _start, _detail, _detailSize);
+	}
+private:
+	Tracer* _tracer = nullptr;
+	const char* _name = nullptr;
+	const char* _detail = nullptr;
+	uint32_t _detailSize = 0;
+	int64_t _start = 0;
+
+	TraceSpan(const TraceSpan&);
+	TraceSpan& operator=(const TraceSpan&);
+};
+
+}
+#endif
@@ -28,7 +28,8 @@
  */
 
 #include "Variable.h"
-#include "GD.h"
+#include "HelperFunctions/HelperFunctions.h"
+#include "HelperFunctions/Math.h"
 
 namespace HgAddonLib
 {
@@ -1,5 +1,11 @@
 -- create Makefile with "./premake4 gmake"
 
+newoption
+{
+   trigger = "tracing",
+   description = "Compile the tracing spans into the library (see Tracer.h)"
+}
+
 solution "homegear-addon"
    configurations { "Release", "Debug", "Profiling" }
 
@@ -8,15 +14,20 @@ solution "homegear-addon"
       {
          "FORTIFY_SOURCE=2",
       }
-      linkoptions { "-Wl,-rpath=/lib/homegear", "-Wl,-rpath=/usr/lib/homegear", "-Wl,-soname,libhomegear-addon.so.0" }
+      linkoptions { "-Wl,-rpath=/lib/homegear", "-Wl,-rpath=/usr/lib/homegear" }
    
    project "homegear-addon"
       kind "SharedLib"
       language "C++"
       files { "*.h", "*.cpp" }
       files { "./*.h", "./*.cpp", "./HelperFunctions/*.h", "./HelperFunctions/*.cpp", "./Encoding/*.h", "./Encoding/*.cpp" }
-      linkoptions { "-l pthread" }
+      linkoptions { "-Wl,-soname,libhomegear-addon.so.0", "-l pthread" }
       buildoptions { "-Wall", "-std=c++11", "-fPIC" }
+      -- Executables linked against the library look for its soname, so it has to exist next to the library in the build directory.
+      postbuildcommands { "ln -sf libhomegear-addon.so $(TARGETDIR)/libhomegear-addon.so.0" }
+      if _OPTIONS["tracing"] then
+         defines { "HGADDON_TRACING=1" }
+      end
  
       configuration "Debug"
          defines { "DEBUG" }
@@ -37,3 +48,45 @@ solution "homegear-addon"
          targetdir "bin/Profiling"
          buildoptions { "-pg" }
          linkoptions { "-pg" }
+
+   -- Command line tools linked against the library. Every directory in "Tools" except "Common" is one executable. The files in "Common"
+   -- are shared by all tools.
+   function tool(name, directory)
+      project(name)
+         kind "ConsoleApp"
+         language "C++"
+         files { "./Tools/Common/*.h", "./Tools/Common/*.cpp", "./Tools/" .. directory .. "/*.h", "./Tools/" .. directory .. "/*.cpp" }
+         includedirs { "." }
+         links { "homegear-addon" }
+         -- Finds the library next to the executable, so the tools can be run from the build directory.
+         linkoptions { "-Wl,-rpath='$$ORIGIN'", "-l pthread" }
+         buildoptions { "-Wall", "-std=c++11" }
+
+         configuration "Debug"
+            defines { "DEBUG" }
+            flags { "Symbols" }
+            targetdir "bin/Debug"
+            objdir ("obj/Debug/" .. name)
+
+         configuration "Release"
+            defines { "NDEBUG" }
+            flags { "Optimize" }
+            targetdir "bin/Release"
+            objdir ("obj/Release/" .. name)
+
+         configuration "Profiling"
+            defines { "NDEBUG" }
+            flags { "Optimize", "Symbols" }
+            targetdir "bin/Profiling"
+            objdir ("obj/Profiling/" .. name)
+            buildoptions { "-pg" }
+            linkoptions { "-pg" }
+   end
+
+   tool("homegear-addon-replay", "Replay")
+   tool("homegear-addon-codec-benchmark", "CodecBenchmark")
+   tool("homegear-addon-event-benchmark", "EventBenchmark")
+   tool("homegear-addon-invoke-benchmark", "InvokeBenchmark")
+   tool("homegear-addon-allocation-check", "AllocationCheck")
+   tool("homegear-addon-float-check", "FloatCheck")
+   tool("homegear-addon-xmlrpc-check", "XmlRpcCheck")